@@ -0,0 +1,101 @@
+# This file is generated by gyp; do not edit.
+
+TOOLSET := target
+TARGET := can
+DEFS_Debug := '-DCANDOR_ARCH_x64' \
+	'-DCANDOR_PLATFORM_LINUX'
+
+# Flags passed to all source files.
+CFLAGS_Debug := -Wall \
+	-Wextra \
+	-Wno-unused-parameter \
+	-fPIC \
+	-fno-strict-aliasing \
+	-fno-exceptions \
+	-pedantic \
+	-g \
+	-O0
+
+# Flags passed to only C files.
+CFLAGS_C_Debug := 
+
+# Flags passed to only C++ files.
+CFLAGS_CC_Debug := 
+
+INCS_Debug := -I$(srcdir)/include \
+	-I$(srcdir)/src
+
+DEFS_Release := '-DCANDOR_ARCH_x64' \
+	'-DCANDOR_PLATFORM_LINUX' \
+	'-DNDEBUG'
+
+# Flags passed to all source files.
+CFLAGS_Release := -Wall \
+	-Wextra \
+	-Wno-unused-parameter \
+	-fPIC \
+	-fno-strict-aliasing \
+	-fno-exceptions \
+	-pedantic \
+	-O3
+
+# Flags passed to only C files.
+CFLAGS_C_Release := 
+
+# Flags passed to only C++ files.
+CFLAGS_CC_Release := 
+
+INCS_Release := -I$(srcdir)/include \
+	-I$(srcdir)/src
+
+OBJS := $(obj).target/$(TARGET)/src/can.o
+
+# Add to the list of files we specially track dependencies for.
+all_deps += $(OBJS)
+
+# Make sure our dependencies are built before any of us.
+$(OBJS): | $(obj).target/libcandor.a
+
+# CFLAGS et al overrides must be target-local.
+# See "Target-specific Variable Values" in the GNU Make manual.
+$(OBJS): TOOLSET := $(TOOLSET)
+$(OBJS): GYP_CFLAGS := $(DEFS_$(BUILDTYPE)) $(INCS_$(BUILDTYPE))  $(CFLAGS_$(BUILDTYPE)) $(CFLAGS_C_$(BUILDTYPE))
+$(OBJS): GYP_CXXFLAGS := $(DEFS_$(BUILDTYPE)) $(INCS_$(BUILDTYPE))  $(CFLAGS_$(BUILDTYPE)) $(CFLAGS_CC_$(BUILDTYPE))
+
+# Suffix rules, putting all outputs into $(obj).
+
+$(obj).$(TOOLSET)/$(TARGET)/%.o: $(srcdir)/%.cc FORCE_DO_CMD
+	@$(call do_cmd,cxx,1)
+
+# Try building from generated source, too.
+
+$(obj).$(TOOLSET)/$(TARGET)/%.o: $(obj).$(TOOLSET)/%.cc FORCE_DO_CMD
+	@$(call do_cmd,cxx,1)
+
+$(obj).$(TOOLSET)/$(TARGET)/%.o: $(obj)/%.cc FORCE_DO_CMD
+	@$(call do_cmd,cxx,1)
+
+# End of this set of suffix rules
+### Rules for final target.
+LDFLAGS_Debug := 
+
+LDFLAGS_Release := 
+
+LIBS := -lpthread
+
+$(builddir)/can: GYP_LDFLAGS := $(LDFLAGS_$(BUILDTYPE))
+$(builddir)/can: LIBS := $(LIBS)
+$(builddir)/can: LD_INPUTS := $(OBJS) $(obj).target/libcandor.a
+$(builddir)/can: TOOLSET := $(TOOLSET)
+$(builddir)/can: $(OBJS) $(obj).target/libcandor.a FORCE_DO_CMD
+	$(call do_cmd,link)
+
+all_deps += $(builddir)/can
+# Add target alias
+.PHONY: can
+can: $(builddir)/can
+
+# Add executable to "all" target.
+.PHONY: all
+all: $(builddir)/can
+
@@ -0,0 +1,118 @@
+# This file is generated by gyp; do not edit.
+
+TOOLSET := target
+TARGET := candor
+DEFS_Debug := '-DCANDOR_ARCH_x64' \
+	'-DCANDOR_PLATFORM_LINUX'
+
+# Flags passed to all source files.
+CFLAGS_Debug := -Wall \
+	-Wextra \
+	-Wno-unused-parameter \
+	-fPIC \
+	-fno-strict-aliasing \
+	-fno-exceptions \
+	-pedantic \
+	-g \
+	-O0
+
+# Flags passed to only C files.
+CFLAGS_C_Debug := 
+
+# Flags passed to only C++ files.
+CFLAGS_CC_Debug := 
+
+INCS_Debug := -I$(srcdir)/include \
+	-I$(srcdir)/src
+
+DEFS_Release := '-DCANDOR_ARCH_x64' \
+	'-DCANDOR_PLATFORM_LINUX' \
+	'-DNDEBUG'
+
+# Flags passed to all source files.
+CFLAGS_Release := -Wall \
+	-Wextra \
+	-Wno-unused-parameter \
+	-fPIC \
+	-fno-strict-aliasing \
+	-fno-exceptions \
+	-pedantic \
+	-O3
+
+# Flags passed to only C files.
+CFLAGS_C_Release := 
+
+# Flags passed to only C++ files.
+CFLAGS_CC_Release := 
+
+INCS_Release := -I$(srcdir)/include \
+	-I$(srcdir)/src
+
+OBJS := $(obj).target/$(TARGET)/src/api.o \
+	$(obj).target/$(TARGET)/src/code-space.o \
+	$(obj).target/$(TARGET)/src/cpu.o \
+	$(obj).target/$(TARGET)/src/gc.o \
+	$(obj).target/$(TARGET)/src/heap.o \
+	$(obj).target/$(TARGET)/src/hir.o \
+	$(obj).target/$(TARGET)/src/ic.o \
+	$(obj).target/$(TARGET)/src/feedback.o \
+	$(obj).target/$(TARGET)/src/lexer.o \
+	$(obj).target/$(TARGET)/src/lir.o \
+	$(obj).target/$(TARGET)/src/optimizer.o \
+	$(obj).target/$(TARGET)/src/parser.o \
+	$(obj).target/$(TARGET)/src/runtime.o \
+	$(obj).target/$(TARGET)/src/scope.o \
+	$(obj).target/$(TARGET)/src/source-map.o \
+	$(obj).target/$(TARGET)/src/visitor.o \
+	$(obj).target/$(TARGET)/src/zone.o \
+	$(obj).target/$(TARGET)/src/x64/assembler-x64.o \
+	$(obj).target/$(TARGET)/src/x64/fullgen-x64.o \
+	$(obj).target/$(TARGET)/src/x64/lir-x64.o \
+	$(obj).target/$(TARGET)/src/x64/macroassembler-x64.o \
+	$(obj).target/$(TARGET)/src/x64/stubs-x64.o
+
+# Add to the list of files we specially track dependencies for.
+all_deps += $(OBJS)
+
+# CFLAGS et al overrides must be target-local.
+# See "Target-specific Variable Values" in the GNU Make manual.
+$(OBJS): TOOLSET := $(TOOLSET)
+$(OBJS): GYP_CFLAGS := $(DEFS_$(BUILDTYPE)) $(INCS_$(BUILDTYPE))  $(CFLAGS_$(BUILDTYPE)) $(CFLAGS_C_$(BUILDTYPE))
+$(OBJS): GYP_CXXFLAGS := $(DEFS_$(BUILDTYPE)) $(INCS_$(BUILDTYPE))  $(CFLAGS_$(BUILDTYPE)) $(CFLAGS_CC_$(BUILDTYPE))
+
+# Suffix rules, putting all outputs into $(obj).
+
+$(obj).$(TOOLSET)/$(TARGET)/%.o: $(srcdir)/%.cc FORCE_DO_CMD
+	@$(call do_cmd,cxx,1)
+
+# Try building from generated source, too.
+
+$(obj).$(TOOLSET)/$(TARGET)/%.o: $(obj).$(TOOLSET)/%.cc FORCE_DO_CMD
+	@$(call do_cmd,cxx,1)
+
+$(obj).$(TOOLSET)/$(TARGET)/%.o: $(obj)/%.cc FORCE_DO_CMD
+	@$(call do_cmd,cxx,1)
+
+# End of this set of suffix rules
+### Rules for final target.
+LDFLAGS_Debug := 
+
+LDFLAGS_Release := 
+
+LIBS := 
+
+$(obj).target/libcandor.a: GYP_LDFLAGS := $(LDFLAGS_$(BUILDTYPE))
+$(obj).target/libcandor.a: LIBS := $(LIBS)
+$(obj).target/libcandor.a: TOOLSET := $(TOOLSET)
+$(obj).target/libcandor.a: $(OBJS) FORCE_DO_CMD
+	$(call do_cmd,alink)
+
+all_deps += $(obj).target/libcandor.a
+# Add target alias
+.PHONY: candor
+candor: $(obj).target/libcandor.a
+
+# Add target alias to "all" target.
+.PHONY: all
+all: candor
+
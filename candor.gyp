@@ -11,6 +11,9 @@
     'cflags': ['-Wall', '-Wextra', '-Wno-unused-parameter',
                '-fPIC', '-fno-strict-aliasing', '-fno-exceptions',
                '-pedantic'],
+    'link_settings': {
+      'libraries': [ '-lpthread' ]
+    },
     'sources': [
       'src/api.cc',
       'src/api.h',
@@ -25,8 +28,18 @@
       'src/heap.cc',
       'src/heap.h',
       'src/heap-inl.h',
+      'src/hir.cc',
+      'src/hir.h',
+      'src/ic.cc',
+      'src/ic.h',
+      'src/feedback.cc',
+      'src/feedback.h',
       'src/lexer.cc',
       'src/lexer.h',
+      'src/lir.cc',
+      'src/lir.h',
+      'src/optimizer.cc',
+      'src/optimizer.h',
       'src/parser.cc',
       'src/parser.h',
       'src/runtime.cc',
@@ -50,6 +63,7 @@
           'src/x64/assembler-x64-inl.h',
           'src/x64/fullgen-x64.cc',
           'src/x64/fullgen-x64.h',
+          'src/x64/lir-x64.cc',
           'src/x64/macroassembler-x64.cc',
           'src/x64/macroassembler-x64.h',
           'src/x64/macroassembler-x64-inl.h',
@@ -6,6 +6,8 @@
           s/x86_64/x64/;s/amd64/x64/;s/arm.*/arm/;s/mips.*/mips/")',
       'osx_arch%': ''
     },
+    # Encode most doubles in values themselves instead of heap numbers
+    'flonums%': 'false',
     'conditions': [
       ['OS == "mac" and osx_arch != "ia32"', {
         'target_arch%': 'x64'
@@ -23,6 +25,9 @@
       }, {
         'defines': [ 'CANDOR_PLATFORM_LINUX' ]
       }],
+      ['flonums == "true" and target_arch == "x64"', {
+        'defines': [ 'CANDOR_FLONUMS' ]
+      }],
       ['OS == "mac" and target_arch == "x64"', {
         'xcode_settings': {
           'ARCHS': [ 'x86_64' ]
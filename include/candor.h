@@ -27,9 +27,40 @@ class Array;
 class CData;
 struct Error;
 
+// Heap sizing policy and GC tuning, sizes are in bytes
+struct HeapOptions {
+  HeapOptions();
+
+  // New space may take that much memory above the values that have survived
+  // previous GC. It's doubled (up to maximum) while many values are
+  // surviving and halved back when most of them are dying.
+  uint32_t new_space_size;
+  uint32_t max_new_space_size;
+
+  // Old space may grow to this percent of its size after full GC
+  uint32_t old_space_growth;
+
+  // Number of new space GCs that value should survive to get into old space
+  uint32_t tenure_age;
+
+  // Process is aborted if old values are taking more memory (0 - unlimited)
+  uint64_t max_heap_size;
+
+  // Allocate values of literals that usually survive GC in old space
+  bool pretenuring;
+
+  // Mark old space in time slices instead of copying it at once
+  bool incremental_gc;
+  uint32_t marking_slice_budget; // microseconds
+
+  // Compact old space when free chunks take more than this percent of it
+  uint32_t compaction_threshold;
+};
+
 class Isolate {
  public:
   Isolate();
+  Isolate(HeapOptions* options);
   ~Isolate();
 
   static Isolate* GetCurrent();
@@ -40,7 +71,28 @@ class Isolate {
 
   Array* StackTrace();
 
+  // Number of threads marking old space while script is waiting for GC
+  void SetGCThreads(uint32_t threads);
+
+  // Back heap pages with transparent huge pages (affects new pages only)
+  void SetHugePages(bool enabled);
+
+  // Number of free heap pages kept for reuse, others are unmapped
+  void SetMaxRetainedPages(uint32_t pages);
+
+  // Number of calls after which function is recompiled by optimizing
+  // compiler (0 - disable optimizations), affects only new code
+  void SetOptimizationThreshold(uint32_t calls);
+
+  // Print state and hit/miss counters of every inline cache to stderr
+  void PrintICStats();
+
+  // Print types of values seen by sites of non-optimized code (operands of
+  // binary operations, property receivers and keys, callees) to stderr
+  void PrintFeedback();
+
  protected:
+  void Init(HeapOptions* options);
 
   void SetError(Error* err);
 
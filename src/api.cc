@@ -2,6 +2,7 @@
 #include "heap.h"
 #include "heap-inl.h"
 #include "code-space.h"
+#include "optimizer.h"
 #include "runtime.h"
 #include "utils.h"
 
@@ -48,8 +49,42 @@ TYPES_LIST(METHODS_ENUM)
 
 static Isolate* current_isolate = NULL;
 
+HeapOptions::HeapOptions()
+    : new_space_size(Heap::kDefaultNewSpaceSize),
+      max_new_space_size(Heap::kDefaultMaxNewSpaceSize),
+      old_space_growth(Heap::kDefaultOldSpaceGrowth),
+      tenure_age(Heap::kDefaultTenureAge),
+      max_heap_size(0),
+      pretenuring(true),
+      incremental_gc(true),
+      marking_slice_budget(Heap::kDefaultMarkingSliceBudget),
+      compaction_threshold(Heap::kDefaultCompactionThreshold) {
+}
+
+
 Isolate::Isolate() {
+  HeapOptions options;
+  Init(&options);
+}
+
+
+Isolate::Isolate(HeapOptions* options) {
+  Init(options);
+}
+
+
+void Isolate::Init(HeapOptions* options) {
   heap = new Heap(2 * 1024 * 1024);
+  heap->new_space_size(options->new_space_size);
+  heap->max_new_space_size(options->max_new_space_size);
+  heap->old_space_growth(options->old_space_growth);
+  heap->tenure_age(options->tenure_age);
+  heap->max_heap_size(options->max_heap_size);
+  heap->pretenuring(options->pretenuring);
+  heap->incremental_gc(options->incremental_gc);
+  heap->marking_slice_budget(options->marking_slice_budget);
+  heap->compaction_threshold(options->compaction_threshold);
+
   space = new CodeSpace(heap);
   error = NULL;
 
@@ -104,6 +139,36 @@ Array* Isolate::StackTrace() {
 }
 
 
+void Isolate::SetGCThreads(uint32_t threads) {
+  heap->gc_threads(threads);
+}
+
+
+void Isolate::SetHugePages(bool enabled) {
+  heap->page_pool()->huge_pages(enabled);
+}
+
+
+void Isolate::SetMaxRetainedPages(uint32_t pages) {
+  heap->page_pool()->max_retained_pages(pages);
+}
+
+
+void Isolate::SetOptimizationThreshold(uint32_t calls) {
+  space->optimizer()->threshold(calls);
+}
+
+
+void Isolate::PrintICStats() {
+  heap->ics()->Print(stderr);
+}
+
+
+void Isolate::PrintFeedback() {
+  heap->feedback()->Print(stderr);
+}
+
+
 template <class T>
 Handle<T>::Handle() : value(NULL), ref_count(0), ref(NULL) {
   Ref();
@@ -336,9 +401,7 @@ Nil* Nil::New() {
 
 
 Boolean* Boolean::New(bool value) {
-  return Cast<Boolean>(HBoolean::New(ISOLATE->heap,
-                                     Heap::kTenureNew,
-                                     value));
+  return Cast<Boolean>(HBoolean::New(ISOLATE->heap, value));
 }
 
 
@@ -420,7 +483,9 @@ void Object::Set(Value* key, Value* value) {
                                         addr(),
                                         key->addr(),
                                         1);
+  ISOLATE->heap->WriteBarrier(*slot);
   *slot = value->addr();
+  ISOLATE->heap->RecordSlot(HObject::Map(addr()), slot);
 }
 
 
@@ -469,19 +534,17 @@ Array* Array::New() {
 
 
 void Array::Set(int64_t key, Value* value) {
-  char** slot = HObject::LookupProperty(ISOLATE->heap,
-                                        addr(),
-                                        HNumber::ToPointer(key),
-                                        1);
-  *slot = value->addr();
+  RuntimeStoreElement(ISOLATE->heap,
+                      addr(),
+                      HNumber::ToPointer(key),
+                      value->addr());
 }
 
 
 Value* Array::Get(int64_t key) {
-  return Value::New(*HObject::LookupProperty(ISOLATE->heap,
-                                             addr(),
-                                             HNumber::ToPointer(key),
-                                             1));
+  return Value::New(RuntimeLoadElement(ISOLATE->heap,
+                                       addr(),
+                                       HNumber::ToPointer(key)));
 }
 
 
@@ -2,14 +2,35 @@
 #include "utils.h" // candor::internal::List
 
 #include <stdio.h> // fprintf
-#include <stdlib.h> // abort
+#include <stdlib.h> // abort, atoi, exit
 #include <unistd.h> // open, lseek
 #include <fcntl.h> // O_RDONLY, ...
 #include <sys/types.h> // off_t
-#include <string.h> // memcpy
+#include <string.h> // memcpy, strncmp, strcmp
 
 typedef candor::internal::List<char*, candor::internal::EmptyClass> List;
 
+// Command line options, they are going before script's filename
+struct Options {
+  uint32_t gc_threads;
+  bool huge_pages;
+  bool print_ic_stats;
+  bool print_feedback;
+  int opt_threshold; // -1 - isolate's default
+  candor::HeapOptions heap;
+};
+
+// Heap sizes are given in megabytes
+static const uint32_t kMB = 1024 * 1024;
+
+void ConfigureIsolate(candor::Isolate* isolate, Options* options) {
+  isolate->SetGCThreads(options->gc_threads);
+  isolate->SetHugePages(options->huge_pages);
+  if (options->opt_threshold >= 0) {
+    isolate->SetOptimizationThreshold(options->opt_threshold);
+  }
+}
+
 const char* ReadContents(const char* filename, off_t* size) {
   int fd = open(filename, O_RDONLY, S_IRUSR | S_IRGRP);
   if (fd == -1) {
@@ -145,8 +166,9 @@ char* PrependGlobals(List* list) {
 }
 
 
-void StartRepl() {
-  candor::Isolate isolate;
+void StartRepl(Options* options) {
+  candor::Isolate isolate(&options->heap);
+  ConfigureIsolate(&isolate, options);
   candor::Object* global = CreateGlobal();
 
   List list;
@@ -204,17 +226,56 @@ void StartRepl() {
 
 
 int main(int argc, char** argv) {
-  if (argc < 2) {
+  Options options;
+  options.gc_threads = 1;
+  options.huge_pages = false;
+  options.print_ic_stats = false;
+  options.print_feedback = false;
+  options.opt_threshold = -1;
+
+  int i;
+  for (i = 1; i < argc && strncmp(argv[i], "--", 2) == 0; i++) {
+    if (strncmp(argv[i], "--gc-threads=", 13) == 0) {
+      options.gc_threads = atoi(argv[i] + 13);
+    } else if (strcmp(argv[i], "--huge-pages") == 0) {
+      options.huge_pages = true;
+    } else if (strncmp(argv[i], "--new-space-size=", 17) == 0) {
+      options.heap.new_space_size = atoi(argv[i] + 17) * kMB;
+    } else if (strncmp(argv[i], "--max-new-space-size=", 21) == 0) {
+      options.heap.max_new_space_size = atoi(argv[i] + 21) * kMB;
+    } else if (strncmp(argv[i], "--old-space-growth=", 19) == 0) {
+      options.heap.old_space_growth = atoi(argv[i] + 19);
+    } else if (strncmp(argv[i], "--tenure-age=", 13) == 0) {
+      options.heap.tenure_age = atoi(argv[i] + 13);
+    } else if (strncmp(argv[i], "--max-heap-size=", 16) == 0) {
+      options.heap.max_heap_size = static_cast<uint64_t>(atoi(argv[i] + 16)) *
+                                   kMB;
+    } else if (strcmp(argv[i], "--no-pretenuring") == 0) {
+      options.heap.pretenuring = false;
+    } else if (strncmp(argv[i], "--opt-threshold=", 16) == 0) {
+      options.opt_threshold = atoi(argv[i] + 16);
+    } else if (strcmp(argv[i], "--print-ic-stats") == 0) {
+      options.print_ic_stats = true;
+    } else if (strcmp(argv[i], "--print-feedback") == 0) {
+      options.print_feedback = true;
+    } else {
+      fprintf(stderr, "init: unknown option %s\n", argv[i]);
+      exit(1);
+    }
+  }
+
+  if (i >= argc) {
     // Start repl
-    StartRepl();
+    StartRepl(&options);
   } else {
-    candor::Isolate isolate;
+    candor::Isolate isolate(&options.heap);
+    ConfigureIsolate(&isolate, &options);
 
     // Load script and run
     off_t size = 0;
-    const char* script = ReadContents(argv[1], &size);
+    const char* script = ReadContents(argv[i], &size);
 
-    candor::Function* code = candor::Function::New(argv[1], script, size);
+    candor::Function* code = candor::Function::New(argv[i], script, size);
     delete script;
 
     if (isolate.HasError()) {
@@ -227,6 +288,10 @@ int main(int argc, char** argv) {
     candor::Value* args[0];
     int ret = code->Call(0, args)->ToNumber()->IntegralValue();
     fflush(stdout);
+
+    if (options.print_ic_stats) isolate.PrintICStats();
+    if (options.print_feedback) isolate.PrintFeedback();
+
     return ret;
   }
 }
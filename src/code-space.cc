@@ -6,6 +6,7 @@
 #include "scope.h" // Scope
 #include "fullgen.h" // Fullgen, Masm
 #include "stubs.h" // EntryStub
+#include "optimizer.h" // Optimizer
 #include "utils.h" // GetPageSize
 
 #include <sys/types.h> // off_t
@@ -19,12 +20,14 @@ namespace internal {
 CodeSpace::CodeSpace(Heap* heap) : heap_(heap) {
   pages_.allocated = true;
   stubs_ = new Stubs(this);
+  optimizer_ = new Optimizer(this);
   entry_ = stubs()->GetEntryStub();
 }
 
 
 CodeSpace::~CodeSpace() {
   delete stubs_;
+  delete optimizer_;
 }
 
 
@@ -87,7 +90,12 @@ char* CodeSpace::Compile(const char* filename,
   // Generate machine code
   f.Generate(ast);
 
+  // Inline caches are reporting position in source
+  heap()->ics()->Commit(filename, source);
+
   if (f.has_error()) {
+    heap()->feedback()->Commit(filename, source, NULL);
+    optimizer()->Commit(filename, source, length, NULL);
     *error = CreateError(filename,
                          source,
                          length,
@@ -105,6 +113,12 @@ char* CodeSpace::Compile(const char* filename,
   // Relocate source map
   heap()->source_map()->Commit(filename, source, length, addr);
 
+  // Feedback is reporting position in source and call targets by code
+  heap()->feedback()->Commit(filename, source, addr);
+
+  // Profiles of hot functions will need source to recompile them
+  optimizer()->Commit(filename, source, length, addr);
+
   return addr;
 }
 
@@ -17,6 +17,7 @@ namespace internal {
 class Heap;
 class Masm;
 class Stubs;
+class Optimizer;
 class CodePage;
 
 class CodeSpace {
@@ -44,10 +45,12 @@ class CodeSpace {
 
   inline Heap* heap() { return heap_; }
   inline Stubs* stubs() { return stubs_; }
+  inline Optimizer* optimizer() { return optimizer_; }
 
  private:
   Heap* heap_;
   Stubs* stubs_;
+  Optimizer* optimizer_;
   char* entry_;
   List<CodePage*, EmptyClass> pages_;
 };
@@ -0,0 +1,218 @@
+#include "feedback.h"
+#include "ic.h" // InlineCache
+#include "heap.h" // HFunction
+#include "heap-inl.h"
+#include "utils.h" // GetSourceLineByOffset
+
+#include <stdint.h> // uint32_t
+#include <stdlib.h> // NULL, realloc, free, abort
+#include <stdio.h> // fprintf
+#include <string.h> // memset
+
+namespace candor {
+namespace internal {
+
+static const char* kTypeNames[] = {
+  "int", "nil", "context", "boolean", "number", "string", "object", "array",
+  "function", "cdata"
+};
+
+// Indexed by BinOp::BinOpType
+static const char* kBinOpNames[] = {
+  "+", "-", "/", "*", "%", ">>>", "<<", ">>", "&", "|", "^", "==", "===",
+  "!=", "!==", "<", ">", "<=", ">=", "||", "&&"
+};
+
+FeedbackSlot::FeedbackSlot(Kind kind, uint32_t offset) : kind_(kind),
+                                                         op_(0),
+                                                         ic_(NULL),
+                                                         offset_(offset),
+                                                         filename_(NULL),
+                                                         line_(0) {
+  memset(types_, 0, sizeof(types_));
+}
+
+
+bool FeedbackSlot::IsEmpty() {
+  for (int i = 0; i < kTypeCount * kTypeCount; i++) {
+    if (types_[i] != 0) return false;
+  }
+
+  return true;
+}
+
+
+void FeedbackSlot::SetSource(const char* filename, const char* source) {
+  int pos;
+
+  filename_ = filename;
+  if (offset_ == InlineCache::kNoOffset) return;
+  line_ = GetSourceLineByOffset(source, offset_, &pos);
+}
+
+
+void FeedbackSlot::Print(FILE* out, FeedbackTable* table) {
+  static const char* kinds[] = { "binop", "property", "call" };
+  static const char* states[] = {
+    "uninitialized", "monomorphic", "polymorphic", "megamorphic"
+  };
+
+  fprintf(out,
+          "  %s:%d %s",
+          filename_ == NULL ? "???" : filename_,
+          line_,
+          kinds[kind_]);
+  if (kind_ == kBinOp) fprintf(out, " %s", kBinOpNames[op_]);
+
+  // Combinations of types
+  const char* delimiter = " ";
+  for (int i = 0; i < kTypeCount; i++) {
+    if (kind_ == kCall) {
+      if (!Seen(i)) continue;
+      fprintf(out, "%s%s", delimiter, kTypeNames[i]);
+      delimiter = ", ";
+      continue;
+    }
+
+    for (int j = 0; j < kTypeCount; j++) {
+      if (!Seen(i, j)) continue;
+      fprintf(out, "%s%s x %s", delimiter, kTypeNames[i], kTypeNames[j]);
+      delimiter = ", ";
+    }
+  }
+
+  if (ic_ == NULL) {
+    fprintf(out, "\n");
+    return;
+  }
+
+  // Shapes or targets
+  fprintf(out, "; %s", states[ic_->state()]);
+  if (kind_ == kProperty) {
+    if (ic_->length() != 0) {
+      fprintf(out,
+              " (%u shape%s)",
+              ic_->length(),
+              ic_->length() == 1 ? "" : "s");
+    }
+  } else {
+    for (uint32_t i = 0; i < ic_->length(); i++) {
+      FeedbackVector* target = table->Lookup(
+          HFunction::Code(ic_->entries()[i].key));
+
+      fprintf(out, "%s", i == 0 ? " -> " : ", ");
+      if (target == NULL) {
+        fprintf(out, "native");
+      } else {
+        fprintf(out,
+                "%s:%d",
+                target->filename() == NULL ? "???" : target->filename(),
+                target->line());
+      }
+    }
+  }
+  fprintf(out, "\n");
+}
+
+
+FeedbackVector::FeedbackVector(int32_t offset, uint32_t code_offset)
+    : offset_(offset),
+      code_offset_(code_offset),
+      code_(NULL),
+      filename_(NULL),
+      line_(0) {
+  slots_.allocated = true;
+}
+
+
+FeedbackSlot* FeedbackVector::New(FeedbackSlot::Kind kind, uint32_t offset) {
+  FeedbackSlot* slot = new FeedbackSlot(kind, offset);
+  slots_.Push(slot);
+
+  return slot;
+}
+
+
+void FeedbackVector::SetSource(const char* filename,
+                               const char* source,
+                               char* code) {
+  int pos;
+
+  filename_ = filename;
+  if (code != NULL) code_ = code + code_offset_;
+
+  SlotList::Item* item = slots_.head();
+  for (; item != NULL; item = item->next()) {
+    item->value()->SetSource(filename, source);
+  }
+
+  // Root function has no position
+  if (offset_ == -1) return;
+  line_ = GetSourceLineByOffset(source, offset_, &pos);
+}
+
+
+void FeedbackVector::Print(FILE* out, FeedbackTable* table) {
+  SlotList::Item* item = slots_.head();
+  bool header = false;
+  for (; item != NULL; item = item->next()) {
+    if (item->value()->IsEmpty()) continue;
+
+    if (!header) {
+      fprintf(out,
+              "%s:%d %s\n",
+              filename_ == NULL ? "???" : filename_,
+              line_,
+              offset_ == -1 ? "root" : "function");
+      header = true;
+    }
+    item->value()->Print(out, table);
+  }
+}
+
+
+FeedbackTable::~FeedbackTable() {
+  for (uint32_t i = 0; i < length_; i++) delete vectors_[i];
+  free(vectors_);
+}
+
+
+FeedbackVector* FeedbackTable::New(int32_t offset, uint32_t code_offset) {
+  if (length_ == size_) {
+    size_ = size_ == 0 ? 64 : size_ << 1;
+    vectors_ = reinterpret_cast<FeedbackVector**>(
+        realloc(vectors_, size_ * sizeof(*vectors_)));
+    if (vectors_ == NULL) abort();
+  }
+
+  FeedbackVector* vector = new FeedbackVector(offset, code_offset);
+  vectors_[length_++] = vector;
+
+  return vector;
+}
+
+
+void FeedbackTable::Commit(const char* filename,
+                           const char* source,
+                           char* code) {
+  for (; committed_ < length_; committed_++) {
+    vectors_[committed_]->SetSource(filename, source, code);
+  }
+}
+
+
+FeedbackVector* FeedbackTable::Lookup(char* code) {
+  for (uint32_t i = 0; i < length_; i++) {
+    if (vectors_[i]->code() == code) return vectors_[i];
+  }
+
+  return NULL;
+}
+
+
+void FeedbackTable::Print(FILE* out) {
+  for (uint32_t i = 0; i < length_; i++) vectors_[i]->Print(out, this);
+}
+
+} // namespace internal
+} // namespace candor
@@ -0,0 +1,134 @@
+#ifndef _SRC_FEEDBACK_H_
+#define _SRC_FEEDBACK_H_
+
+#include "utils.h" // List
+
+#include <stdint.h> // uint8_t, int32_t, uint32_t
+#include <stdio.h> // FILE
+
+namespace candor {
+namespace internal {
+
+// Forward declarations
+class InlineCache;
+class FeedbackTable;
+
+// Types of values that were seen by a site of non-optimized code:
+// operands of binary operation, receiver and key of property lookup or
+// callee. Generated code sets a flag for every combination it meets
+// (sites with inline caches are doing it only on misses - values that hit
+// were recorded before). Shapes of receivers and call targets are known
+// from site's inline cache.
+class FeedbackSlot {
+ public:
+  enum Kind {
+    kBinOp,
+    kProperty,
+    kCall
+  };
+
+  // Type index is a heap tag, 0 - unboxed integer (flonums are numbers)
+  static const int kTypeCount = 10;
+
+  // Flags are indexed by [lhs][rhs] (just [callee] for calls),
+  // generated code is setting them directly
+  static const int kTypesOffset = 0;
+
+  FeedbackSlot(Kind kind, uint32_t offset);
+
+  inline bool Seen(int type) { return types_[type] != 0; }
+  inline bool Seen(int lhs, int rhs) {
+    return types_[lhs * kTypeCount + rhs] != 0;
+  }
+  bool IsEmpty();
+
+  // Source position is known only after compilation
+  void SetSource(const char* filename, const char* source);
+
+  void Print(FILE* out, FeedbackTable* table);
+
+  inline Kind kind() { return kind_; }
+
+  // Type of binary operation (BinOp::BinOpType)
+  inline int op() { return op_; }
+  inline void op(int op) { op_ = op; }
+
+  // Cache of property or call site (NULL for lookups with dynamic keys)
+  inline InlineCache* ic() { return ic_; }
+  inline void ic(InlineCache* ic) { ic_ = ic; }
+
+ protected:
+  uint8_t types_[kTypeCount * kTypeCount];
+
+  Kind kind_;
+  int op_;
+  InlineCache* ic_;
+
+  uint32_t offset_;
+  const char* filename_;
+  int line_;
+};
+
+// Feedback slots of all sites in function's non-optimized code
+class FeedbackVector {
+ public:
+  typedef List<FeedbackSlot*, EmptyClass> SlotList;
+
+  FeedbackVector(int32_t offset, uint32_t code_offset);
+
+  FeedbackSlot* New(FeedbackSlot::Kind kind, uint32_t offset);
+
+  // Source position and code address are known only after compilation
+  // (code is NULL if compilation has failed)
+  void SetSource(const char* filename, const char* source, char* code);
+
+  void Print(FILE* out, FeedbackTable* table);
+
+  inline SlotList* slots() { return &slots_; }
+  inline char* code() { return code_; }
+  inline const char* filename() { return filename_; }
+  inline int line() { return line_; }
+
+ protected:
+  SlotList slots_;
+
+  int32_t offset_;
+  uint32_t code_offset_;
+  char* code_;
+  const char* filename_;
+  int line_;
+};
+
+class FeedbackTable {
+ public:
+  FeedbackTable() : vectors_(NULL), length_(0), size_(0), committed_(0) {
+  }
+  ~FeedbackTable();
+
+  // Vector of function which code is going to be generated at `code_offset`
+  FeedbackVector* New(int32_t offset, uint32_t code_offset);
+
+  // Set source positions and code addresses of vectors created since
+  // last commit
+  void Commit(const char* filename, const char* source, char* code);
+
+  // Find function by its code (NULL if it has no feedback)
+  FeedbackVector* Lookup(char* code);
+
+  // Print types seen by every site that was reached at least once
+  void Print(FILE* out);
+
+  inline FeedbackVector* Get(uint32_t index) { return vectors_[index]; }
+  inline uint32_t length() { return length_; }
+
+ protected:
+  FeedbackVector** vectors_;
+  uint32_t length_;
+  uint32_t size_;
+  uint32_t committed_;
+};
+
+} // namespace internal
+} // namespace candor
+
+#endif // _SRC_FEEDBACK_H_
@@ -76,11 +76,13 @@ class Fullgen : public Masm, public Visitor {
    public:
     CandorFunction(Fullgen* fullgen, FunctionLiteral* fn) : FFunction(fullgen),
                                                             fullgen_(fullgen),
-                                                            fn_(fn) {
+                                                            fn_(fn),
+                                                            feedback_(NULL) {
     }
 
     inline Fullgen* fullgen() { return fullgen_; }
     inline FunctionLiteral* fn() { return fn_; }
+    inline FeedbackVector* feedback() { return feedback_; }
 
     static inline CandorFunction* Cast(void* value) {
       return reinterpret_cast<CandorFunction*>(value);
@@ -91,6 +93,7 @@ class Fullgen : public Masm, public Visitor {
    protected:
     Fullgen* fullgen_;
     FunctionLiteral* fn_;
+    FeedbackVector* feedback_;
   };
 
   class LoopVisitor {
@@ -154,6 +157,10 @@ class Fullgen : public Masm, public Visitor {
   AstNode* VisitIf(AstNode* node);
   AstNode* VisitWhile(AstNode* node);
 
+  // Jump to `fail` if expression is falsy, comparisons of unboxed integers
+  // are jumping directly (without materializing boolean)
+  void VisitCondition(AstNode* expr, Label* fail);
+
   AstNode* VisitMember(AstNode* node);
   AstNode* VisitObjectLiteral(AstNode* node);
   AstNode* VisitArrayLiteral(AstNode* node);
@@ -173,6 +180,8 @@ class Fullgen : public Masm, public Visitor {
 
   AstNode* VisitFor(VisitorType type, AstNode* node);
 
+  char* GetBinOpStub(BinOp::BinOpType type);
+
   inline Label* loop_start() { return loop_start_; }
   inline void loop_start(Label* loop_start) { loop_start_ = loop_start; }
   inline Label* loop_end() { return loop_end_; }
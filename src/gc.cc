@@ -3,29 +3,145 @@
 #include "heap-inl.h"
 
 #include <sys/types.h> // off_t
-#include <stdlib.h> // NULL
+#include <stdlib.h> // NULL, malloc, realloc, free
+#include <string.h> // memcpy
+#include <stdint.h> // uint64_t
 #include <assert.h> // assert
+#include <pthread.h> // pthread_create, pthread_join, pthread_mutex_t
 
 namespace candor {
 namespace internal {
 
-void GC::GCValue::Relocate(char* address) {
-  if (slot_ != NULL) {
-    *slot_ = address;
+// Marking stack of the current parallel marking thread
+static __thread GC::ValueStack* thread_marking_stack = NULL;
+
+// Values shared by busy marking threads with idle ones
+class MarkingPool {
+ public:
+  MarkingPool(uint32_t threads, uint64_t deadline) : threads_(threads),
+                                                     deadline_(deadline),
+                                                     idle_(0),
+                                                     stopped_(false) {
+    pthread_mutex_init(&mutex_, NULL);
+    pthread_cond_init(&cond_, NULL);
+    segments_.allocated = true;
   }
-  if (!value()->IsGCMarked()) value()->SetGCMark(address);
+
+  ~MarkingPool() {
+    pthread_cond_destroy(&cond_);
+    pthread_mutex_destroy(&mutex_);
+  }
+
+  void Share(GC::ValueStack* stack);
+
+  // Wait until some values will be shared, returns false if all threads
+  // are idle (i.e. marking is finished) or if pool was stopped
+  bool Take(GC::ValueStack* stack);
+
+  // Wake up idle threads, called when slice's deadline has passed
+  void Stop();
+
+  // Move segments that weren't taken by anyone to the stack
+  void Flush(GC::ValueStack* stack);
+
+  inline bool has_idle() { return idle_ != 0; }
+  inline bool stopped() { return stopped_; }
+  inline uint64_t deadline() { return deadline_; }
+
+ private:
+  pthread_mutex_t mutex_;
+  pthread_cond_t cond_;
+
+  List<GC::ValueStack*, EmptyClass> segments_;
+  uint32_t threads_;
+  uint64_t deadline_;
+  volatile uint32_t idle_;
+  volatile bool stopped_;
+};
+
+class MarkingThread {
+ public:
+  MarkingThread() : gc(NULL), pool(NULL) {
+  }
+
+  static void* Loop(void* arg);
+
+  GC* gc;
+  MarkingPool* pool;
+  GC::ValueStack stack;
+  pthread_t thread;
+};
+
+GC::ValueStack::~ValueStack() {
+  free(values_);
+}
+
+
+void GC::ValueStack::Push(char* value) {
+  if (length_ == size_) {
+    size_ = size_ == 0 ? 1024 : size_ << 1;
+    values_ = reinterpret_cast<char**>(realloc(values_,
+                                               size_ * sizeof(*values_)));
+    if (values_ == NULL) abort();
+  }
+  values_[length_++] = value;
+}
+
+
+void GC::ValueStack::Split(ValueStack* to) {
+  uint32_t half = length_ >> 1;
+  for (uint32_t i = length_ - half; i < length_; i++) to->Push(values_[i]);
+  length_ -= half;
 }
 
 
 void GC::CollectGarbage(char* stack_top) {
-  assert(grey_items()->length() == 0);
-  assert(black_items()->length() == 0);
+  assert(promoted_values_.length() == 0);
+  assert(external_values_.length() == 0);
 
   // __$gc() isn't setting needs_gc() attribute
   if (heap()->needs_gc() == Heap::kGCNone) {
     heap()->needs_gc(Heap::kGCNewSpace);
   }
 
+  // Old space is marked incrementally and swept in place,
+  // copying is used only for compaction
+  if (heap()->incremental_gc()) {
+    switch (heap()->needs_gc()) {
+     case Heap::kGCIncrementalStep:
+      if (!heap()->incremental_marking() ||
+          !IncrementalMarkingStep(heap()->marking_slice_budget())) {
+        heap()->needs_gc(Heap::kGCNone);
+        return;
+      }
+      FinishIncrementalMarking();
+      break;
+     case Heap::kGCOldSpace:
+      if (compact_) break;
+
+      if (!heap()->incremental_marking()) {
+        StartIncrementalMarking(stack_top);
+        heap()->needs_gc(Heap::kGCNone);
+        return;
+      }
+
+      // Finish marking at once only if old space has grown too much
+      if (heap()->old_space()->size() <=
+              heap()->old_space()->size_limit() << 1 &&
+          !IncrementalMarkingStep(heap()->marking_slice_budget())) {
+        heap()->needs_gc(Heap::kGCNone);
+        return;
+      }
+      FinishIncrementalMarking();
+      break;
+     default:
+      break;
+    }
+  }
+
+  // Cached strings may be moved or freed
+  heap()->number_strings()->Clear();
+
   switch (heap()->needs_gc()) {
    case Heap::kGCNewSpace: gc_type(kNewSpace); break;
    case Heap::kGCOldSpace: gc_type(kOldSpace); break;
@@ -41,29 +157,75 @@ void GC::CollectGarbage(char* stack_top) {
       heap()->old_space();
 
   // Temporary space which will contain copies of all visited objects
-  tmp_space(new Space(heap(), space->page_size()));
+  if (gc_type() == kNewSpace) {
+    tmp_space(new Space(heap(), space->page_size()));
+    promoted_bytes_ = 0;
+  } else {
+    tmp_space(new OldSpace(heap(), space->page_size()));
+
+    // All old objects will be moved and their slots will be recorded again
+    heap()->remembered_set()->Clear();
+  }
+
+  // Slots recorded while colouring other roots must not be visited twice,
+  // so old-to-new references go first
+  if (gc_type() == kNewSpace) ColourRememberedSet();
 
   // Add referenced in C++ land values to the grey list
   ColourPersistentHandles();
+  ColourShapes();
+  ColourInlineCaches();
+
+  // Keep values that are waiting to be marked alive
+  if (heap()->incremental_marking()) ColourMarkingStack();
 
   // Colour on-stack registers
   ColourFrames(stack_top);
 
+  // Marking stack can't be changed while it's coloured
+  while (grey_promoted_values_.length() != 0) {
+    marking_stack_.Push(grey_promoted_values_.Pop());
+  }
+
   // Reset marks for items from external space
-  while (black_items()->length() != 0) {
-    GCValue* value = black_items()->Shift();
-    assert(value->value()->IsSoftGCMarked());
-    value->value()->ResetSoftGCMark();
+  for (uint32_t i = 0; i < external_values_.length(); i++) {
+    HValue* value = HValue::Cast(external_values_.Get(i));
+    assert(value->IsSoftGCMarked());
+    value->ResetSoftGCMark();
   }
+  external_values_.Clear();
+  external_index_ = 0;
 
   RelocateWeakHandles();
 
   // Visit all weak references and call callbacks if some of them are dead
   HandleWeakReferences();
 
+  // Internalized strings are old, only copying of old space moves them
+  if (gc_type() == kOldSpace) RelocateInternalizedStrings();
+
+  // Size of new space and pretenuring depend on amount of surviving values
+  if (gc_type() == kNewSpace) {
+    heap()->ResizeNewSpace(space->Used(),
+                           tmp_space()->Used() + promoted_bytes_);
+    heap()->allocation_sites()->Update();
+  }
+
   space->Swap(tmp_space());
   delete tmp_space();
 
+  // Large values weren't copied, release unreachable ones
+  if (gc_type() == kOldSpace) {
+    heap()->large_space()->Sweep();
+    heap()->CheckHeapSize();
+  }
+
+  if (gc_type() == kOldSpace) {
+    compact_ = false;
+  } else if (compact_) {
+    heap()->needs_gc(Heap::kGCOldSpace);
+  }
+
   if (gc_type() != kNewSpace || heap()->needs_gc() == Heap::kGCNewSpace) {
     // Reset GC flag
     heap()->needs_gc(Heap::kGCNone);
@@ -81,11 +243,41 @@ void GC::ColourPersistentHandles() {
     if (ref->is_persistent()) {
       push_grey(ref->value(), reinterpret_cast<char**>(ref->reference()));
       push_grey(ref->value(), reinterpret_cast<char**>(ref->valueptr()));
-      ProcessGrey();
     }
 
     item = item->next();
   }
+  ProcessGrey();
+}
+
+
+void GC::ColourShapes() {
+  ShapeTable* shapes = heap()->shapes();
+  for (uint32_t i = 0; i < shapes->length(); i++) {
+    Shape* shape = shapes->Get(i);
+    for (uint32_t j = 0; j < shape->table_size(); j++) {
+      Shape::Entry* entry = &shape->table()[j];
+      if (entry->key == NULL) continue;
+
+      push_grey(HValue::Cast(entry->key), &entry->key);
+    }
+  }
+  ProcessGrey();
+}
+
+
+void GC::ColourInlineCaches() {
+  ICTable* ics = heap()->ics();
+  for (uint32_t i = 0; i < ics->length(); i++) {
+    InlineCache* ic = ics->Get(i);
+    if (ic->kind() != InlineCache::kCall) continue;
+
+    for (uint32_t j = 0; j < ic->length(); j++) {
+      InlineCache::Entry* entry = &ic->entries()[j];
+      push_grey(HValue::Cast(entry->key), &entry->key);
+    }
+  }
+  ProcessGrey();
 }
 
 
@@ -94,14 +286,10 @@ void GC::RelocateWeakHandles() {
   while (item != NULL) {
     HValueReference* ref = item->value();
     if (ref->is_weak()) {
-      GCValue* v;
       if (ref->value()->IsGCMarked()) {
-        v = new GCValue(ref->value(),
-                        reinterpret_cast<char**>(ref->reference()));
-        v->Relocate(v->value()->GetGCMark());
-        v = new GCValue(ref->value(),
-                        reinterpret_cast<char**>(ref->valueptr()));
-        v->Relocate(v->value()->GetGCMark());
+        char* address = ref->value()->GetGCMark();
+        *reinterpret_cast<char**>(ref->reference()) = address;
+        *reinterpret_cast<char**>(ref->valueptr()) = address;
       } else {
         // Value was garbage collected - remove reference from the list
         heap()->references()->Remove(item);
@@ -129,11 +317,35 @@ void GC::ColourFrames(char* stack_top) {
     // Skip nil, non-pointer values and rbp pushes
     if (value != HNil::New() && !HValue::IsUnboxed(value)) {
       push_grey(HValue::Cast(value), frame);
-      ProcessGrey();
     }
 
     frame++;
   }
+  ProcessGrey();
+}
+
+
+void GC::ColourRememberedSet() {
+  RememberedSet* set = heap()->remembered_set();
+  set->Compact();
+
+  // Slots will be recorded again if they'll still reference new space
+  uint32_t length = set->length();
+  if (length == 0) return;
+
+  char*** slots = reinterpret_cast<char***>(malloc(length * sizeof(*slots)));
+  if (slots == NULL) abort();
+  memcpy(slots, set->start(), length * sizeof(*slots));
+  set->Clear();
+
+  record_slots_ = true;
+  for (uint32_t i = 0; i < length; i++) {
+    push_grey(HValue::Cast(*slots[i]), slots[i]);
+  }
+  record_slots_ = false;
+
+  free(slots);
+  ProcessGrey();
 }
 
 
@@ -142,7 +354,8 @@ void GC::HandleWeakReferences() {
   while (item != NULL) {
     HValueWeakRef* ref = item->value();
     if (!ref->value()->IsGCMarked()) {
-      if (IsInCurrentSpace(ref->value())) {
+      if (IsInCurrentSpace(ref->value()) ||
+          IsUnmarkedLargeValue(ref->value())) {
         // Value is in GC space and wasn't marked
         // call callback as it was GCed
         ref->callback()(ref->value());
@@ -161,52 +374,454 @@ void GC::HandleWeakReferences() {
 }
 
 
-void GC::ProcessGrey() {
-  while (grey_items()->length() != 0) {
-    GCValue* value = grey_items()->Shift();
+void GC::RelocateInternalizedStrings() {
+  StringTable* strings = heap()->strings();
+  char** entries = strings->entries();
+  for (uint32_t i = 0; i < strings->size(); i++) {
+    if (entries[i] == NULL) continue;
 
-    // Skip unboxed address
-    if (value->value() == HValue::Cast(HNil::New()) ||
-        HValue::IsUnboxed(value->value()->addr())) {
-      continue;
+    HValue* value = HValue::Cast(entries[i]);
+    if (value->IsGCMarked()) {
+      entries[i] = value->GetGCMark();
+    } else if (IsInCurrentSpace(value) || IsUnmarkedLargeValue(value)) {
+      entries[i] = NULL;
     }
+  }
+  strings->Rehash();
+}
 
-    if (!value->value()->IsGCMarked()) {
-      // Object is in not in current space, don't move it
-      if (!IsInCurrentSpace(value->value())) {
-        if (!value->value()->IsSoftGCMarked()) {
-          // Set soft mark and add item to black list to reset mark later
-          value->value()->SetSoftGCMark();
-          black_items()->Push(value);
 
-          GC::VisitValue(value->value());
-        }
-        continue;
+void GC::Evacuate(HValue* value, char** slot) {
+  // Skip unboxed address
+  if (value == HValue::Cast(HNil::New()) || HValue::IsUnboxed(value->addr())) {
+    return;
+  }
+
+  char* address;
+  if (value->IsGCMarked()) {
+    address = value->GetGCMark();
+  } else if (value->IsLarge()) {
+    // Large values are never moved
+    address = value->addr();
+
+    // Live mark is free in copying GC, it's used to sweep large space later.
+    // Remembered set is rebuilt, so value is visited as a promoted one
+    if (gc_type() == kOldSpace && !value->IsLiveGCMarked()) {
+      value->SetLiveGCMark();
+      promoted_values_.Push(address);
+    }
+  } else if (!IsInCurrentSpace(value)) {
+    // Object is in not in current space, don't move it
+    address = value->addr();
+
+    // References from old space are in remembered set
+    if (gc_type() == kOldSpace && !value->IsSoftGCMarked()) {
+      // Set soft mark and visit value later, mark will be reset after GC
+      value->SetSoftGCMark();
+      external_values_.Push(address);
+    }
+  } else {
+    assert(!value->IsSoftGCMarked());
+
+    HValue* hvalue;
+    if (gc_type() == kNewSpace) {
+      // New space GC
+      if (value->Generation() == 0) {
+        uint32_t site = value->AllocationSiteIndex();
+        if (site != 0) heap()->allocation_sites()->Get(site)->RecordSurvival();
       }
-      assert(!value->value()->IsSoftGCMarked());
+      hvalue = value->CopyTo(heap()->old_space(), tmp_space());
+    } else {
+      // Old space GC
+      hvalue = value->CopyTo(tmp_space(), heap()->new_space());
+    }
 
-      HValue* hvalue;
+    // Values promoted while marking are alive, otherwise clear marks
+    // left from the previous marking
+    if (!heap()->incremental_marking()) {
+      hvalue->ResetLiveGCMark();
+    } else if (hvalue->Generation() >= Heap::kMinOldSpaceGeneration &&
+               !hvalue->IsLiveGCMarked()) {
+      // Marker hasn't reached value yet, so it should visit promoted copy
+      hvalue->SetLiveGCMark();
+      grey_promoted_values_.Push(hvalue->addr());
+    }
+
+    address = hvalue->addr();
+    value->SetGCMark(address);
+
+    // Promoted values are placed in old space's free chunks,
+    // scan pointer won't reach them
+    if (gc_type() == kNewSpace &&
+        hvalue->Generation() >= Heap::kMinOldSpaceGeneration) {
+      promoted_values_.Push(address);
+      promoted_bytes_ += hvalue->Size();
+    }
+  }
+
+  if (slot != NULL) *slot = address;
+  RecordSlot(slot, address);
+}
 
-      if (gc_type() == kNewSpace) {
-        // New space GC
-        hvalue = value->value()->CopyTo(heap()->old_space(), tmp_space());
+
+void GC::ProcessGrey() {
+  // Marking isn't copying values
+  if (gc_type() == kMarking) return;
+
+  bool visited;
+  do {
+    visited = ScanTmpSpace();
+
+    // Promoted values may reference new space
+    record_slots_ = true;
+    while (promoted_values_.length() != 0) {
+      GC::VisitValue(HValue::Cast(promoted_values_.Pop()));
+      visited = true;
+    }
+    record_slots_ = false;
+
+    while (external_index_ < external_values_.length()) {
+      GC::VisitValue(HValue::Cast(external_values_.Get(external_index_++)));
+      visited = true;
+    }
+  } while (visited);
+}
+
+
+bool GC::ScanTmpSpace() {
+  bool visited = false;
+
+  // Copies of old values may reference new space
+  record_slots_ = gc_type() == kOldSpace;
+
+  // Copied values are placed one after another, though allocation may
+  // return to any page that has enough space
+  List<Space::Page*, EmptyClass>::Item* item = tmp_space()->pages()->head();
+  for (; item != NULL; item = item->next()) {
+    Space::Page* page = item->value();
+    while (page->scan_ < page->top_) {
+      HValue* value = HValue::Cast(page->scan_);
+
+      uint32_t size = value->Size();
+      if (gc_type() == kOldSpace) {
+        size = RoundUp(size, OldSpace::kAlignment);
       } else {
-        // Old space GC
-        hvalue = value->value()->CopyTo(tmp_space(), heap()->new_space());
+        size = RoundUp(size, Space::kAlignment);
       }
+      page->scan_ += size;
 
-      value->Relocate(hvalue->addr());
-      GC::VisitValue(hvalue);
-    } else {
-      value->Relocate(value->value()->GetGCMark());
+      GC::VisitValue(value);
+      visited = true;
     }
   }
+  record_slots_ = false;
+
+  return visited;
+}
+
+
+void GC::RecordSlot(char** slot, char* address) {
+  if (!record_slots_ || slot == NULL) return;
+  if (HValue::Cast(address)->Generation() >= Heap::kMinOldSpaceGeneration) {
+    return;
+  }
+
+  heap()->remembered_set()->Push(slot);
+}
+
+
+void GC::StartIncrementalMarking(char* stack_top) {
+  assert(marking_stack_.length() == 0);
+  heap()->incremental_marking(true);
+
+  // Take a snapshot of roots
+  gc_type(kMarking);
+  ColourPersistentHandles();
+  ColourShapes();
+  ColourInlineCaches();
+  ColourFrames(stack_top);
+  gc_type(kNone);
+
+  heap()->marking_step_budget(Heap::kMarkingStepBytes);
+}
+
+
+bool GC::IncrementalMarkingStep(uint32_t budget) {
+  bool done = ProcessMarkingStack(GetTimeMicroseconds() + budget);
+  heap()->marking_step_budget(Heap::kMarkingStepBytes);
+
+  return done;
+}
+
+
+void GC::FinishIncrementalMarking() {
+  ProcessMarkingStack(0);
+
+  heap()->incremental_marking(false);
+  heap()->marking_step_budget(Heap::kMarkingIdleBudget);
+
+  HandleUnmarkedWeakHandles();
+
+  OldSpace* space = heap()->old_space();
+  space->Sweep();
+  space->compute_size_limit();
+  heap()->large_space()->Sweep();
+  heap()->CheckHeapSize();
+
+  // Free chunks can't be reused by big objects, move live objects together
+  // if there are too many of them
+  compact_ = space->size() > space->page_size() &&
+             space->fragmentation() > heap()->compaction_threshold();
+
+  // Marks in new space will be reset by copying
+  heap()->needs_gc(Heap::kGCNewSpace);
+}
+
+
+bool GC::ProcessMarkingStack(uint64_t deadline) {
+  gc_type(kMarking);
+
+  // Mutator is waiting for the end of slice, use all threads if there're
+  // enough values to share
+  if (heap()->gc_threads() > 1 &&
+      marking_stack_.length() >= kMarkingShareThreshold) {
+    ParallelMark(deadline);
+  }
+
+  uint32_t visited = 0;
+  while (marking_stack_.length() != 0) {
+    VisitValue(HValue::Cast(marking_stack_.Pop()));
+
+    if (deadline != 0 &&
+        ++visited % kMarkingTimeCheckInterval == 0 &&
+        GetTimeMicroseconds() >= deadline) {
+      break;
+    }
+  }
+
+  gc_type(kNone);
+
+  return marking_stack_.length() == 0;
+}
+
+
+void GC::ParallelMark(uint64_t deadline) {
+  uint32_t count = heap()->gc_threads();
+  MarkingPool pool(count, deadline);
+  MarkingThread* threads = new MarkingThread[count];
+
+  // Values on the stack are already marked, just hand them out
+  for (uint32_t i = 0; i < marking_stack_.length(); i++) {
+    threads[i % count].stack.Push(marking_stack_.Get(i));
+  }
+  marking_stack_.Clear();
+
+  for (uint32_t i = 0; i < count; i++) {
+    threads[i].gc = this;
+    threads[i].pool = &pool;
+  }
+
+  // Current thread is marking too
+  for (uint32_t i = 1; i < count; i++) {
+    if (pthread_create(&threads[i].thread,
+                       NULL,
+                       MarkingThread::Loop,
+                       &threads[i]) != 0) {
+      abort();
+    }
+  }
+  MarkingThread::Loop(&threads[0]);
+
+  for (uint32_t i = 1; i < count; i++) {
+    pthread_join(threads[i].thread, NULL);
+  }
+
+  // Deadline has passed, put unvisited values back
+  for (uint32_t i = 0; i < count; i++) {
+    while (threads[i].stack.length() != 0) {
+      marking_stack_.Push(threads[i].stack.Pop());
+    }
+  }
+  pool.Flush(&marking_stack_);
+
+  delete[] threads;
+}
+
+
+void* MarkingThread::Loop(void* arg) {
+  MarkingThread* thread = reinterpret_cast<MarkingThread*>(arg);
+  thread_marking_stack = &thread->stack;
+
+  MarkingPool* pool = thread->pool;
+  uint32_t visited = 0;
+
+  do {
+    while (thread->stack.length() != 0 && !pool->stopped()) {
+      thread->gc->VisitValue(HValue::Cast(thread->stack.Pop()));
+
+      if (thread->stack.length() >= GC::kMarkingShareThreshold &&
+          pool->has_idle()) {
+        pool->Share(&thread->stack);
+      }
+
+      if (pool->deadline() != 0 &&
+          ++visited % GC::kMarkingTimeCheckInterval == 0 &&
+          GetTimeMicroseconds() >= pool->deadline()) {
+        pool->Stop();
+      }
+    }
+  } while (!pool->stopped() && pool->Take(&thread->stack));
+
+  thread_marking_stack = NULL;
+
+  return NULL;
+}
+
+
+void MarkingPool::Share(GC::ValueStack* stack) {
+  GC::ValueStack* segment = new GC::ValueStack();
+  stack->Split(segment);
+
+  pthread_mutex_lock(&mutex_);
+  segments_.Push(segment);
+  pthread_cond_signal(&cond_);
+  pthread_mutex_unlock(&mutex_);
+}
+
+
+bool MarkingPool::Take(GC::ValueStack* stack) {
+  GC::ValueStack* segment = NULL;
+
+  pthread_mutex_lock(&mutex_);
+  idle_++;
+  while (segments_.length() == 0 && idle_ != threads_ && !stopped_) {
+    pthread_cond_wait(&cond_, &mutex_);
+  }
+
+  if (segments_.length() != 0 && !stopped_) {
+    idle_--;
+    segment = segments_.Shift();
+  } else {
+    // Nothing to share anymore, wake up everyone
+    pthread_cond_broadcast(&cond_);
+  }
+  pthread_mutex_unlock(&mutex_);
+
+  if (segment == NULL) return false;
+
+  while (segment->length() != 0) stack->Push(segment->Pop());
+  delete segment;
+
+  return true;
+}
+
+
+void MarkingPool::Stop() {
+  pthread_mutex_lock(&mutex_);
+  stopped_ = true;
+  pthread_cond_broadcast(&cond_);
+  pthread_mutex_unlock(&mutex_);
+}
+
+
+void MarkingPool::Flush(GC::ValueStack* stack) {
+  while (segments_.length() != 0) {
+    GC::ValueStack* segment = segments_.Shift();
+    while (segment->length() != 0) stack->Push(segment->Pop());
+    delete segment;
+  }
+}
+
+
+void GC::MarkValue(char* value) {
+  if (value == HNil::New() || HValue::IsUnboxed(value)) return;
+
+  HValue* hvalue = HValue::Cast(value);
+
+  // Value may be reached by several marking threads at once,
+  // only one of them should visit it
+  if (thread_marking_stack != NULL) {
+    if (hvalue->TestAndSetLiveGCMark()) return;
+    thread_marking_stack->Push(value);
+    return;
+  }
+
+  if (hvalue->IsLiveGCMarked()) return;
+  hvalue->SetLiveGCMark();
+
+  marking_stack_.Push(value);
+}
+
+
+void GC::RecordWrite(char* old_value) {
+  assert(heap()->incremental_marking());
+  MarkValue(old_value);
+}
+
+
+void GC::ColourMarkingStack() {
+  for (uint32_t i = 0; i < marking_stack_.length(); i++) {
+    push_grey(HValue::Cast(marking_stack_.Get(i)), marking_stack_.GetSlot(i));
+  }
+  ProcessGrey();
+}
+
+
+void GC::HandleUnmarkedWeakHandles() {
+  HValueRefList::Item* item = heap()->references()->head();
+  while (item != NULL) {
+    HValueReference* ref = item->value();
+    HValueRefList::Item* current = item;
+    item = item->next();
+
+    if (ref->is_weak() && IsUnmarkedOldValue(ref->value())) {
+      heap()->references()->Remove(current);
+    }
+  }
+
+  HValueWeakRefList::Item* witem = heap()->weak_references()->head();
+  while (witem != NULL) {
+    HValueWeakRef* ref = witem->value();
+    HValueWeakRefList::Item* current = witem;
+    witem = witem->next();
+
+    if (IsUnmarkedOldValue(ref->value())) {
+      ref->callback()(ref->value());
+      heap()->weak_references()->Remove(current);
+    }
+  }
+
+  StringTable* strings = heap()->strings();
+  char** entries = strings->entries();
+  for (uint32_t i = 0; i < strings->size(); i++) {
+    if (entries[i] == NULL) continue;
+    if (IsUnmarkedOldValue(HValue::Cast(entries[i]))) entries[i] = NULL;
+  }
+  strings->Rehash();
+}
+
+
+bool GC::IsUnmarkedOldValue(HValue* value) {
+  if (value == HValue::Cast(HNil::New()) || HValue::IsUnboxed(value->addr())) {
+    return false;
+  }
+
+  return value->Generation() >= Heap::kMinOldSpaceGeneration &&
+         !value->IsLiveGCMarked();
+}
+
+
+bool GC::IsUnmarkedLargeValue(HValue* value) {
+  return gc_type() == kOldSpace &&
+         value->IsLarge() &&
+         !value->IsLiveGCMarked();
 }
 
 
 bool GC::IsInCurrentSpace(HValue* value) {
   return (gc_type() == kOldSpace &&
-         value->Generation() >= Heap::kMinOldSpaceGeneration) ||
+         value->Generation() >= Heap::kMinOldSpaceGeneration &&
+         !value->IsLarge()) ||
          (gc_type() == kNewSpace &&
          value->Generation() < Heap::kMinOldSpaceGeneration);
 }
@@ -229,6 +844,7 @@ void GC::VisitValue(HValue* value) {
    case Heap::kTagString:
     switch (HValue::GetRepresentation<HString::Representation>(value->addr())) {
      case HString::kNormal:
+     case HString::kInternalized:
       break;
      case HString::kCons:
       return VisitString(value);
@@ -278,6 +894,9 @@ void GC::VisitArray(HArray* arr) {
 
 
 void GC::VisitMap(HMap* map) {
+  // Raw doubles aren't pointing anywhere
+  if (map->IsDoubles()) return;
+
   uint32_t size = map->size() << 1;
   for (uint32_t i = 0; i < size; i++) {
     if (map->IsEmptySlot(i)) continue;
@@ -1,8 +1,8 @@
 #ifndef _SRC_GC_H_
 #define _SRC_GC_H_
 
-#include "zone.h" // ZoneObject
-#include "utils.h" // List
+#include <stdint.h> // uint32_t
+#include <stdlib.h> // NULL
 
 namespace candor {
 namespace internal {
@@ -19,40 +19,103 @@ class HMap;
 
 class GC {
  public:
-  class GCValue : public ZoneObject {
+  // Growable stack of values, pushes aren't allocating memory
+  // unless stack is full
+  class ValueStack {
    public:
-    GCValue(HValue* value, char** slot) : value_(value), slot_(slot) {
+    ValueStack() : values_(NULL), length_(0), size_(0) {
     }
+    ~ValueStack();
 
-    void Relocate(char* address);
+    void Push(char* value);
 
-    inline HValue* value() { return value_; }
+    // Move top half of values into `to`
+    void Split(ValueStack* to);
+
+    inline char* Get(uint32_t index) { return values_[index]; }
+    inline char** GetSlot(uint32_t index) { return &values_[index]; }
+    inline char* Pop() { return values_[--length_]; }
+    inline void Clear() { length_ = 0; }
+    inline uint32_t length() { return length_; }
 
    protected:
-    HValue* value_;
-    char** slot_;
+    char** values_;
+    uint32_t length_;
+    uint32_t size_;
   };
 
   enum GCType {
     kNone,
     kOldSpace,
-    kNewSpace
+    kNewSpace,
+    kMarking
   };
 
-  typedef List<GCValue*, ZoneObject> GCList;
+  // How often marking loop should check if slice's time budget is exhausted
+  static const uint32_t kMarkingTimeCheckInterval = 64;
+
+  // Parallel marking thread shares part of its stack with idle threads
+  // only if it has at least this amount of values
+  static const uint32_t kMarkingShareThreshold = 64;
 
-  GC(Heap* heap) : heap_(heap), gc_type_(kNone) {
+  GC(Heap* heap) : heap_(heap),
+                   gc_type_(kNone),
+                   record_slots_(false),
+                   promoted_bytes_(0),
+                   external_index_(0),
+                   compact_(false) {
   }
 
   void CollectGarbage(char* stack_top);
 
+  // Incremental (snapshot-at-the-beginning) marking of old space.
+  // Marking starts with all roots being marked and continues in time-bounded
+  // slices, write barrier is marking all values that are being overwritten.
+  void StartIncrementalMarking(char* stack_top);
+  bool IncrementalMarkingStep(uint32_t budget);
+  void FinishIncrementalMarking();
+
+  // Mark all values reachable from marking stack, zero deadline means no
+  // time limit. Returns true if marking stack was drained.
+  bool ProcessMarkingStack(uint64_t deadline);
+
+  // Drain marking stack using `heap()->gc_threads()` threads, each of them
+  // has own stack and is taking work from others when it runs out of values.
+  // Values that weren't visited before deadline are put back on the stack.
+  void ParallelMark(uint64_t deadline);
+  void MarkValue(char* value);
+  void RecordWrite(char* old_value);
+
+  // Values on marking stack are roots for new space GC
+  void ColourMarkingStack();
+  void HandleUnmarkedWeakHandles();
+
   void ColourPersistentHandles();
   void RelocateWeakHandles();
 
+  // String table doesn't keep internalized strings alive
+  void RelocateInternalizedStrings();
+
+  // Keys of shapes are never collected
+  void ColourShapes();
+
+  // Functions remembered by call sites are kept alive and moved with caches
+  void ColourInlineCaches();
+
   void ColourFrames(char* stack_top);
+
+  // Old-to-new slots are roots for new space GC
+  void ColourRememberedSet();
+  void RecordSlot(char** slot, char* address);
   void HandleWeakReferences();
 
+  // Copy value into tmp space (if it's in current space) and update slot
+  void Evacuate(HValue* value, char** slot);
+
+  // Cheney scan: visit copied values until scan pointers will reach tops
+  // of tmp space pages
   void ProcessGrey();
+  bool ScanTmpSpace();
 
   void VisitValue(HValue* value);
   void VisitContext(HContext* context);
@@ -63,13 +126,17 @@ class GC {
   void VisitString(HValue* value);
 
   bool IsInCurrentSpace(HValue* value);
+  bool IsUnmarkedOldValue(HValue* value);
+  bool IsUnmarkedLargeValue(HValue* value);
 
   inline void push_grey(HValue* value, char** reference) {
-    grey_items()->Push(new GCValue(value, reference));
+    // Marking isn't moving values, just mark them
+    if (gc_type() == kMarking) {
+      return MarkValue(reinterpret_cast<char*>(value));
+    }
+    Evacuate(value, reference);
   }
 
-  inline GCList* grey_items() { return &grey_items_; }
-  inline GCList* black_items() { return &black_items_; }
   inline Heap* heap() { return heap_; }
   inline void tmp_space(Space* space) { tmp_space_ = space; }
   inline Space* tmp_space() { return tmp_space_; }
@@ -78,12 +145,29 @@ class GC {
   inline void gc_type(GCType value) { gc_type_ = value; }
 
  protected:
-  GCList grey_items_;
-  GCList black_items_;
   Heap* heap_;
   Space* tmp_space_;
 
   GCType gc_type_;
+
+  ValueStack marking_stack_;
+
+  // Visited slots are in old space object
+  bool record_slots_;
+
+  // Values promoted to old space are scanned separately from tmp space
+  ValueStack promoted_values_;
+  uint32_t promoted_bytes_;
+
+  // Values promoted while marking, they will be pushed to marking stack
+  ValueStack grey_promoted_values_;
+
+  // Soft marked values from external space, visited ones are below index
+  ValueStack external_values_;
+  uint32_t external_index_;
+
+  // Compact old space after next new space GC
+  bool compact_;
 };
 
 } // namespace internal
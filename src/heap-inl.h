@@ -1,12 +1,28 @@
 #ifndef _SRC_HEAP_INL_H_
 #define _SRC_HEAP_INL_H_
 
-#include <stdint.h> // int64_t
+#include <assert.h> // assert
+#include <stdint.h> // int64_t, uint64_t
+#include <string.h> // memcpy
 #include <sys/types.h> // off_t
 
 namespace candor {
 namespace internal {
 
+inline void Heap::RecordSlot(char* host, char** slot) {
+  char* value = *slot;
+  if (value == HNil::New() || HValue::IsUnboxed(value)) return;
+
+  // Only old-to-new references are recorded
+  if (HValue::Cast(host)->Generation() < kMinOldSpaceGeneration ||
+      HValue::Cast(value)->Generation() >= kMinOldSpaceGeneration) {
+    return;
+  }
+
+  remembered_set()->Record(slot);
+}
+
+
 inline Heap::HeapTag HValue::GetTag(char* addr) {
   if (addr == HNil::New()) return Heap::kTagNil;
 
@@ -19,7 +35,11 @@ inline Heap::HeapTag HValue::GetTag(char* addr) {
 
 
 inline bool HValue::IsUnboxed(char* addr) {
+#ifdef CANDOR_FLONUMS
+  return (*reinterpret_cast<uint8_t*>(&addr) & 0x03) != 0x01;
+#else
   return (*reinterpret_cast<uint8_t*>(&addr) & 0x01) == 0;
+#endif // CANDOR_FLONUMS
 }
 
 
@@ -61,6 +81,28 @@ inline void HValue::ResetSoftGCMark() {
 }
 
 
+inline bool HValue::IsLiveGCMarked() {
+  if (IsUnboxed(addr())) return false;
+  return (*reinterpret_cast<uint8_t*>(addr() + kGCMarkOffset) & 0x20) != 0;
+}
+
+
+inline void HValue::SetLiveGCMark() {
+  *reinterpret_cast<uint8_t*>(addr() + kGCMarkOffset) |= 0x20;
+}
+
+
+inline void HValue::ResetLiveGCMark() {
+  *reinterpret_cast<uint8_t*>(addr() + kGCMarkOffset) &= ~0x20;
+}
+
+
+inline bool HValue::TestAndSetLiveGCMark() {
+  uint8_t* mark = reinterpret_cast<uint8_t*>(addr() + kGCMarkOffset);
+  return (__sync_fetch_and_or(mark, 0x20) & 0x20) != 0;
+}
+
+
 inline void HValue::IncrementGeneration() {
   // tag, generation, reserved, GC mark
   if (Generation() < Heap::kMinOldSpaceGeneration) {
@@ -75,6 +117,16 @@ inline uint8_t HValue::Generation() {
 }
 
 
+inline bool HValue::IsLarge() {
+  return Generation() == Heap::kLargeObjectGeneration;
+}
+
+
+inline uint32_t HValue::AllocationSiteIndex() {
+  return *reinterpret_cast<uint16_t*>(addr() + kAllocationSiteOffset);
+}
+
+
 inline bool HContext::HasSlot(uint32_t index) {
   return *GetSlotAddress(index) != HNil::New();
 }
@@ -112,17 +164,19 @@ inline char* HNumber::ToPointer(int64_t value) {
 
 
 inline int64_t HNumber::IntegralValue(char* addr) {
-  if (IsUnboxed(addr)) {
+  if (IsIntegral(addr)) {
     return Untag(reinterpret_cast<int64_t>(addr));
   } else {
-    return *reinterpret_cast<double*>(addr + kValueOffset);
+    return DoubleValue(addr);
   }
 }
 
 
 inline double HNumber::DoubleValue(char* addr) {
-  if (IsUnboxed(addr)) {
+  if (IsIntegral(addr)) {
     return Untag(reinterpret_cast<int64_t>(addr));
+  } else if (IsFlonum(addr)) {
+    return DecodeFlonum(addr);
   } else {
     return *reinterpret_cast<double*>(addr + kValueOffset);
   }
@@ -130,7 +184,54 @@ inline double HNumber::DoubleValue(char* addr) {
 
 
 inline bool HNumber::IsIntegral(char* addr) {
-  return IsUnboxed(addr);
+  return (*reinterpret_cast<uint8_t*>(&addr) & 0x01) == 0;
+}
+
+
+inline bool HNumber::IsFlonum(char* addr) {
+#ifdef CANDOR_FLONUMS
+  return (*reinterpret_cast<uint8_t*>(&addr) & 0x03) == kFlonumTag;
+#else
+  return false;
+#endif // CANDOR_FLONUMS
+}
+
+
+inline bool HNumber::FitsFlonum(double value) {
+#ifdef CANDOR_FLONUMS
+  uint64_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+
+  // Bits 62..60 should be either 0b011 or 0b100
+  uint64_t top = (bits >> 60) & 0x07;
+  return top == 0x03 || top == 0x04;
+#else
+  return false;
+#endif // CANDOR_FLONUMS
+}
+
+
+inline char* HNumber::EncodeFlonum(double value) {
+  assert(FitsFlonum(value));
+  uint64_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+
+  bits = (bits << 4) | (bits >> 60) | kFlonumTag;
+  return reinterpret_cast<char*>(bits);
+}
+
+
+inline double HNumber::DecodeFlonum(char* addr) {
+  assert(IsFlonum(addr));
+  uint64_t bits = reinterpret_cast<uint64_t>(addr);
+
+  // Restore bits 61 and 60 from bit 62
+  if ((bits & 0x04) != 0) bits ^= kFlonumTag;
+  bits = (bits >> 4) | (bits << 60);
+
+  double value;
+  memcpy(&value, &bits, sizeof(value));
+  return value;
 }
 
 
@@ -140,7 +241,17 @@ inline void HArray::SetLength(char* obj, int64_t length) {
 
 
 inline bool HArray::IsDense(char* obj) {
-  return Length(obj, false) <= kDenseLengthMax;
+  return GetRepresentation<Representation>(obj) != kSparse;
+}
+
+
+inline HArray::Representation HArray::Kind(char* obj) {
+  return GetRepresentation<Representation>(obj);
+}
+
+
+inline uint32_t HArray::Capacity(char* obj) {
+  return Mask(obj) / kPointerSize + 1;
 }
 
 
@@ -159,6 +270,30 @@ inline char** HMap::GetSlotAddress(uint32_t index) {
 }
 
 
+inline void HMap::SetControl(uint32_t index, uint8_t value) {
+  uint8_t* ctrl = control();
+  uint32_t size = this->size();
+
+  // Update mirrored bytes too
+  for (; index < size + kGroupSize; index += size) ctrl[index] = value;
+}
+
+
+inline uint32_t HMap::growth_left() {
+  // Counter is tagged, GC doesn't need to know about it
+  char* counter = *reinterpret_cast<char**>(space() +
+                                            ControlOffset(size()) -
+                                            kPointerSize);
+  return HNumber::Untag(reinterpret_cast<int64_t>(counter));
+}
+
+
+inline void HMap::growth_left(uint32_t value) {
+  *reinterpret_cast<char**>(space() + ControlOffset(size()) - kPointerSize) =
+      HNumber::ToPointer(value);
+}
+
+
 inline char* HFunction::GetContext(char* addr) {
   HContext* hroot = HValue::As<HContext>(HFunction::Root(addr));
 
@@ -171,7 +306,9 @@ inline void HFunction::SetContext(char* addr, char* context) {
   HContext* hroot = HValue::As<HContext>(HFunction::Root(addr));
 
   char** root_slot = hroot->GetSlotAddress(Heap::kRootGlobalIndex);
+  Heap::Current()->WriteBarrier(*root_slot);
   *root_slot = context;
+  Heap::Current()->RecordSlot(hroot->addr(), root_slot);
 }
 
 } // namespace internal
@@ -1,13 +1,17 @@
 #include "heap.h"
 #include "heap-inl.h"
 #include "runtime.h" // RuntimeLookupProperty
+#include "utils.h" // GetPageSize
 
 #include <stdint.h> // uint32_t
 #include <sys/types.h> // off_t
-#include <stdlib.h> // NULL
-#include <string.h> // memcpy
+#include <stdlib.h> // NULL, malloc, calloc, realloc, free, qsort, abort
+#include <stdio.h> // fprintf
+#include <string.h> // memcpy, memcmp
 #include <zone.h> // Zone::Allocate
 #include <assert.h> // assert
+#include <pthread.h> // pthread_create, pthread_join, pthread_mutex_t
+#include <sys/mman.h> // mmap, munmap, madvise
 
 namespace candor {
 namespace internal {
@@ -18,8 +22,8 @@ Space::Space(Heap* heap, uint32_t page_size) : heap_(heap),
                                                page_size_(page_size),
                                                size_(0) {
   // Create the first page
-  pages_.Push(new Page(page_size));
-  pages_.allocated = true;
+  pages_.Push(heap->page_pool()->Get(page_size));
+  size_ += page_size;
 
   select(pages_.head()->value());
 
@@ -27,6 +31,11 @@ Space::Space(Heap* heap, uint32_t page_size) : heap_(heap),
 }
 
 
+Space::~Space() {
+  Clear();
+}
+
+
 void Space::select(Page* page) {
   top_ = &page->top_;
   limit_ = &page->limit_;
@@ -35,7 +44,7 @@ void Space::select(Page* page) {
 
 void Space::AddPage(uint32_t size) {
   uint32_t real_size = RoundUp(size, page_size());
-  Page* page = new Page(real_size);
+  Page* page = heap()->page_pool()->Get(real_size);
   pages_.Push(page);
   size_ += real_size;
 
@@ -45,13 +54,13 @@ void Space::AddPage(uint32_t size) {
 
 char* Space::Allocate(uint32_t bytes) {
   // If current page was exhausted - run GC
-  uint32_t even_bytes = bytes + (bytes & 0x01);
-  bool place_in_current = *top_ + even_bytes <= *limit_;
+  uint32_t aligned_bytes = RoundUp(bytes, kAlignment);
+  bool place_in_current = *top_ + aligned_bytes <= *limit_;
 
   if (!place_in_current) {
     // Go through all pages to find gap
     List<Page*, EmptyClass>::Item* item = pages_.head();
-    for (;*top_ + even_bytes > *limit_ && item != NULL; item = item->next()) {
+    for (;*top_ + aligned_bytes > *limit_ && item != NULL; item = item->next()) {
       select(item->value());
     }
 
@@ -65,12 +74,12 @@ char* Space::Allocate(uint32_t bytes) {
       }
 
       // Including tagging byte offset
-      AddPage(even_bytes + 1);
+      AddPage(aligned_bytes + 1);
     }
   }
 
   char* result = *top_;
-  *top_ += even_bytes;
+  *top_ += aligned_bytes;
 
   return result;
 }
@@ -93,8 +102,850 @@ void Space::Swap(Space* space) {
 void Space::Clear() {
   size_ = 0;
   while (pages_.length() != 0) {
-    delete pages_.Shift();
+    heap()->page_pool()->Release(pages_.Shift());
+  }
+}
+
+
+uint32_t Space::Used() {
+  uint32_t used = 0;
+  List<Page*, EmptyClass>::Item* item = pages_.head();
+  for (; item != NULL; item = item->next()) {
+    Page* page = item->value();
+    used += page->top_ - (page->data_ + 1);
+  }
+
+  return used;
+}
+
+
+void Space::compute_size_limit() {
+  if (this == heap()->new_space()) {
+    // Survivors will be copied again, so allocate at least as much before
+    // next GC
+    uint32_t limit = heap()->new_space_limit();
+    size_limit_ = size_ + (limit > size_ ? limit : size_);
+  } else {
+    size_limit_ = heap()->ComputeOldLimit(size_);
+  }
+}
+
+
+Space::Page::Page(uint32_t size, bool huge) : size_(size) {
+  bool use_huge = huge && size % PagePool::kHugePageSize == 0;
+
+  // Huge page should be aligned, map more and cut the edges
+  uint32_t map_size = use_huge ? size + PagePool::kHugePageSize : size;
+  char* map = reinterpret_cast<char*>(mmap(0,
+                                           map_size,
+                                           PROT_READ | PROT_WRITE,
+                                           MAP_ANON | MAP_PRIVATE,
+                                           -1,
+                                           0));
+  if (map == MAP_FAILED) abort();
+
+  data_ = map;
+  if (use_huge) {
+    off_t mask = PagePool::kHugePageSize - 1;
+    data_ = reinterpret_cast<char*>(
+        (reinterpret_cast<off_t>(map) + mask) & ~mask);
+
+    if (data_ != map) munmap(map, data_ - map);
+    if (data_ + size != map + map_size) {
+      munmap(data_ + size, map + map_size - (data_ + size));
+    }
+#ifdef MADV_HUGEPAGE
+    madvise(data_, size, MADV_HUGEPAGE);
+#endif // MADV_HUGEPAGE
+  }
+
+  Reset();
+}
+
+
+Space::Page::~Page() {
+  munmap(data_, size_);
+}
+
+
+PagePool::PagePool(uint32_t page_size) : started_(false),
+                                         stopped_(false),
+                                         page_size_(page_size),
+                                         huge_pages_(false),
+                                         max_retained_pages_(
+                                             kDefaultMaxRetainedPages),
+                                         in_use_(0) {
+  pthread_mutex_init(&mutex_, NULL);
+  pthread_cond_init(&cond_, NULL);
+  released_.allocated = true;
+  free_.allocated = true;
+}
+
+
+PagePool::~PagePool() {
+  if (started_) {
+    pthread_mutex_lock(&mutex_);
+    stopped_ = true;
+    pthread_cond_signal(&cond_);
+    pthread_mutex_unlock(&mutex_);
+
+    pthread_join(thread_, NULL);
+  }
+
+  pthread_cond_destroy(&cond_);
+  pthread_mutex_destroy(&mutex_);
+}
+
+
+Space::Page* PagePool::Get(uint32_t size) {
+  Space::Page* page = NULL;
+
+  if (size == page_size()) {
+    pthread_mutex_lock(&mutex_);
+    if (free_.length() != 0) page = free_.Shift();
+    in_use_++;
+    pthread_mutex_unlock(&mutex_);
+  }
+
+  if (page == NULL) page = new Space::Page(size, huge_pages());
+
+  return page;
+}
+
+
+void PagePool::Release(Space::Page* page) {
+  pthread_mutex_lock(&mutex_);
+
+  // Thread is started only when it's needed
+  if (!started_) {
+    if (pthread_create(&thread_, NULL, PagePool::Loop, this) != 0) abort();
+    started_ = true;
+  }
+
+  if (page->size_ == page_size()) in_use_--;
+  released_.Push(page);
+  pthread_cond_signal(&cond_);
+  pthread_mutex_unlock(&mutex_);
+}
+
+
+void* PagePool::Loop(void* arg) {
+  PagePool* pool = reinterpret_cast<PagePool*>(arg);
+
+  pthread_mutex_lock(&pool->mutex_);
+  while (!pool->stopped_) {
+    if (pool->released_.length() == 0) {
+      pthread_cond_wait(&pool->cond_, &pool->mutex_);
+      continue;
+    }
+
+    Space::Page* page = pool->released_.Shift();
+    pthread_mutex_unlock(&pool->mutex_);
+
+    pool->Process(page);
+
+    pthread_mutex_lock(&pool->mutex_);
+  }
+  pthread_mutex_unlock(&pool->mutex_);
+
+  return NULL;
+}
+
+
+void PagePool::Process(Space::Page* page) {
+  // Pages of non-default size are allocated for big objects only
+  if (page->size_ != page_size()) {
+    delete page;
+    return;
+  }
+
+  page->Reset();
+
+  pthread_mutex_lock(&mutex_);
+  uint32_t free_count = free_.length();
+  bool is_warm = free_count < in_use_;
+  pthread_mutex_unlock(&mutex_);
+
+  if (free_count >= max_retained_pages_) {
+    delete page;
+    return;
+  }
+
+  // Give memory back to the system, it will be faulted in on reuse
+  if (!is_warm) madvise(page->data_, page->size_, MADV_DONTNEED);
+
+  // Warm pages are reused first
+  pthread_mutex_lock(&mutex_);
+  if (is_warm) {
+    free_.Unshift(page);
+  } else {
+    free_.Push(page);
+  }
+  pthread_mutex_unlock(&mutex_);
+}
+
+
+LargeSpace::LargeSpace(Heap* heap) : heap_(heap), size_(0) {
+  compute_size_limit();
+}
+
+
+LargeSpace::~LargeSpace() {
+  while (pages_.length() != 0) {
+    heap()->page_pool()->Release(pages_.Shift());
+  }
+}
+
+
+char* LargeSpace::Allocate(uint32_t bytes) {
+  // Including tagging byte offset
+  uint32_t real_size = RoundUp(bytes + 1, GetPageSize());
+
+  if (size() > size_limit()) heap()->needs_gc(Heap::kGCOldSpace);
+
+  Space::Page* page = heap()->page_pool()->Get(real_size);
+  pages_.Push(page);
+  size_ += real_size;
+
+  char* result = page->top_;
+  page->top_ += bytes;
+
+  return result;
+}
+
+
+void LargeSpace::Sweep() {
+  RememberedSet* remembered = heap()->remembered_set();
+  remembered->Compact();
+
+  List<Space::Page*, EmptyClass>::Item* item = pages_.head();
+  while (item != NULL) {
+    Space::Page* page = item->value();
+    List<Space::Page*, EmptyClass>::Item* next = item->next();
+
+    HValue* value = HValue::Cast(page->data_ + 1);
+    if (value->IsLiveGCMarked()) {
+      value->ResetLiveGCMark();
+    } else {
+      // Slots of dead object will be reused by other spaces
+      char*** slot = remembered->Find(page->data_);
+      for (; slot < remembered->end() &&
+             reinterpret_cast<char*>(*slot) < page->limit_; slot++) {
+        RememberedSet::ClearSlot(slot);
+      }
+
+      size_ -= page->size_;
+      pages_.Remove(item);
+      heap()->page_pool()->Release(page);
+    }
+
+    item = next;
+  }
+  remembered->RemoveCleared();
+
+  compute_size_limit();
+}
+
+
+void LargeSpace::compute_size_limit() {
+  size_limit_ = heap()->ComputeOldLimit(size_);
+}
+
+
+bool LargeSpace::Contains(char* addr) {
+  List<Space::Page*, EmptyClass>::Item* item = pages_.head();
+  for (; item != NULL; item = item->next()) {
+    Space::Page* page = item->value();
+    if (addr >= page->data_ && addr < page->top_) return true;
+  }
+
+  return false;
+}
+
+
+OldSpace::OldSpace(Heap* heap, uint32_t page_size) : Space(heap, page_size) {
+  ClearFreeLists();
+}
+
+
+char* OldSpace::Allocate(uint32_t bytes) {
+  uint32_t aligned_bytes = RoundUp(bytes, kAlignment);
+
+  char* result = AllocateFromFreeList(aligned_bytes);
+  if (result != NULL) return result;
+
+  return Space::Allocate(aligned_bytes);
+}
+
+
+char* OldSpace::AllocateFromFreeList(uint32_t bytes) {
+  char* result = NULL;
+
+  // Try chunks of exact size first, then any bigger small chunk
+  for (uint32_t i = FreeListIndex(bytes); i < kFreeListCount - 1; i++) {
+    if (free_lists_[i] == NULL) continue;
+
+    result = free_lists_[i];
+    free_lists_[i] = HFree::Next(result);
+    break;
+  }
+
+  // First fit in the list of large chunks
+  if (result == NULL) {
+    char** slot = &free_lists_[kFreeListCount - 1];
+    while (*slot != NULL && HFree::Size(*slot) < bytes) {
+      slot = HFree::NextSlot(*slot);
+    }
+    if (*slot == NULL) return NULL;
+
+    result = *slot;
+    *slot = HFree::Next(result);
+  }
+
+  uint32_t size = HFree::Size(result);
+  free_size_ -= size;
+
+  // Return the rest of the chunk back
+  if (size > bytes) AddFree(result + bytes, size - bytes);
+
+  return result;
+}
+
+
+void OldSpace::AddFree(char* addr, uint32_t size) {
+  HFree::New(addr, size);
+  free_size_ += size;
+
+  if (size < kMinFreeChunk) return;
+
+  uint32_t index = FreeListIndex(size);
+  *HFree::NextSlot(addr) = free_lists_[index];
+  free_lists_[index] = addr;
+}
+
+
+void OldSpace::ClearFreeLists() {
+  for (uint32_t i = 0; i < kFreeListCount; i++) free_lists_[i] = NULL;
+  free_size_ = 0;
+}
+
+
+void OldSpace::Swap(Space* space) {
+  // Chunks are pointing into the pages that will be removed
+  ClearFreeLists();
+  Space::Swap(space);
+}
+
+
+uint32_t OldSpace::Sweep() {
+  uint32_t live = 0;
+
+  ClearFreeLists();
+
+  // Slots of dead objects will be removed from remembered set
+  RememberedSet* remembered = heap()->remembered_set();
+  remembered->Compact();
+
+  List<Page*, EmptyClass>::Item* item = pages_.head();
+  while (item != NULL) {
+    Page* page = item->value();
+    List<Page*, EmptyClass>::Item* next = item->next();
+
+    // Objects are placed one after another, starting at the first odd offset
+    uint32_t page_live = 0;
+    char* free_start = NULL;
+    char* obj = page->data_ + 1;
+    char*** slot = remembered->Find(page->data_);
+    while (obj < page->top_) {
+      HValue* value = HValue::Cast(obj);
+      uint32_t size = RoundUp(value->Size(), kAlignment);
+      bool is_live = value->tag() != Heap::kTagFree &&
+                     value->IsLiveGCMarked();
+
+      // Let pretenured sites know if their values are dying
+      if (value->tag() != Heap::kTagFree) {
+        uint32_t site = value->AllocationSiteIndex();
+        if (site != 0) {
+          heap()->allocation_sites()->Get(site)->RecordSweep(is_live);
+        }
+      }
+
+      // Object starts with a tag
+      char* end = obj + HValue::interior_offset(0) + size;
+      for (; slot < remembered->end() &&
+             reinterpret_cast<char*>(*slot) < end; slot++) {
+        if (!is_live) RememberedSet::ClearSlot(slot);
+      }
+
+      if (is_live) {
+        value->ResetLiveGCMark();
+        page_live += size;
+
+        // Dead objects before this one are forming one chunk
+        if (free_start != NULL) {
+          AddFree(free_start, obj - free_start);
+          free_start = NULL;
+        }
+      } else if (free_start == NULL) {
+        free_start = obj;
+      }
+      obj += size;
+    }
+
+    if (page_live == 0) {
+      // Keep at least one page in the space
+      if (pages_.length() > 1) {
+        pages_.Remove(item);
+        heap()->page_pool()->Release(page);
+      } else {
+        page->top_ = page->data_ + 1;
+      }
+    } else if (free_start != NULL) {
+      // Dead tail can be reused by bump allocation
+      page->top_ = free_start;
+    }
+
+    live += page_live;
+    item = next;
+  }
+  remembered->RemoveCleared();
+
+  size_ = 0;
+  for (item = pages_.head(); item != NULL; item = item->next()) {
+    size_ += item->value()->size_;
+  }
+
+  select(pages_.head()->value());
+
+  return live;
+}
+
+
+bool OldSpace::Contains(char* addr) {
+  List<Page*, EmptyClass>::Item* item = pages_.head();
+  for (; item != NULL; item = item->next()) {
+    Page* page = item->value();
+    if (addr >= page->data_ && addr < page->top_) return true;
+  }
+
+  return false;
+}
+
+
+RememberedSet::RememberedSet(Heap* heap) : heap_(heap) {
+  start_ = reinterpret_cast<char***>(malloc(kInitialSize * sizeof(*start_)));
+  if (start_ == NULL) abort();
+
+  top_ = start_;
+  limit_ = start_ + kInitialSize;
+}
+
+
+RememberedSet::~RememberedSet() {
+  free(start_);
+}
+
+
+void AllocationSite::Update() {
+  if (!is_tenured()) {
+    if (allocated_ < kMinAllocations) return;
+
+    if (survived_ * 100 >= allocated_ * kTenureRate) {
+      generation_ = Heap::kMinOldSpaceGeneration;
+    }
+  } else {
+    if (live_ + dead_ < kMinAllocations) return;
+
+    if (dead_ * 100 >= (live_ + dead_) * kUntenureRate) generation_ = 0;
+  }
+
+  // Start collecting feedback again
+  allocated_ = 0;
+  survived_ = 0;
+  live_ = 0;
+  dead_ = 0;
+}
+
+
+AllocationSiteTable::AllocationSiteTable() : sites_(NULL),
+                                             length_(0),
+                                             size_(0) {
+}
+
+
+AllocationSiteTable::~AllocationSiteTable() {
+  for (uint32_t i = 0; i < length_; i++) delete sites_[i];
+  free(sites_);
+}
+
+
+AllocationSite* AllocationSiteTable::New() {
+  if (length_ == kMaxSites) return NULL;
+
+  if (length_ == size_) {
+    size_ = size_ == 0 ? 64 : size_ << 1;
+    sites_ = reinterpret_cast<AllocationSite**>(
+        realloc(sites_, size_ * sizeof(*sites_)));
+    if (sites_ == NULL) abort();
+  }
+
+  AllocationSite* site = new AllocationSite(length_ + 1);
+  sites_[length_++] = site;
+
+  return site;
+}
+
+
+void AllocationSiteTable::Update() {
+  for (uint32_t i = 0; i < length_; i++) sites_[i]->Update();
+}
+
+
+Shape::Shape(Heap* heap, Shape* parent, char* key) : last_(NULL),
+                                                     length_(0),
+                                                     transitions_(NULL),
+                                                     transition_count_(0) {
+  if (parent != NULL) length_ = parent->length() + 1;
+
+  // Table is filled only by half at maximum
+  uint32_t size = PowerOfTwo(length_ << 1);
+  mask_ = (size - 1) * sizeof(*table_);
+  table_ = reinterpret_cast<Entry*>(calloc(size, sizeof(*table_)));
+  if (table_ == NULL) abort();
+
+  if (parent == NULL) return;
+
+  for (uint32_t i = 0; i < parent->table_size(); i++) {
+    Entry* entry = &parent->table()[i];
+    if (entry->key == NULL) continue;
+    Insert(heap, entry->key, entry->offset);
+  }
+  last_ = Insert(heap, key, parent->NextOffset());
+}
+
+
+Shape::~Shape() {
+  free(table_);
+  free(transitions_);
+}
+
+
+Shape::Entry* Shape::Insert(Heap* heap, char* key, off_t offset) {
+  off_t index = RuntimeGetHash(heap, key) & mask_;
+  Entry* entry;
+  while (true) {
+    entry = reinterpret_cast<Entry*>(reinterpret_cast<char*>(table_) + index);
+    if (entry->key == NULL) break;
+    index = (index + sizeof(*entry)) & mask_;
+  }
+
+  entry->key = key;
+  entry->offset = offset;
+
+  return entry;
+}
+
+
+off_t Shape::Lookup(Heap* heap, char* key) {
+  off_t start = RuntimeGetHash(heap, key) & mask_;
+  off_t index = start;
+  do {
+    Entry* entry = reinterpret_cast<Entry*>(
+        reinterpret_cast<char*>(table_) + index);
+
+    // Table always has empty entries
+    if (entry->key == NULL) break;
+    if (RuntimeStrictCompare(heap, entry->key, key) == 0) return entry->offset;
+
+    index = (index + sizeof(*entry)) & mask_;
+  } while (index != start);
+
+  return -1;
+}
+
+
+Shape* Shape::Transition(Heap* heap, char* key) {
+  // Other keys are hashed by address or value, keep them in hash map
+  if (HValue::GetTag(key) != Heap::kTagString) return NULL;
+
+  for (uint32_t i = 0; i < transition_count_; i++) {
+    Shape* child = transitions_[i];
+    if (RuntimeStrictCompare(heap, child->last_->key, key) == 0) return child;
+  }
+
+  if (length_ >= kMaxLength || transition_count_ >= kMaxTransitions) {
+    return NULL;
+  }
+
+  transitions_ = reinterpret_cast<Shape**>(realloc(
+      transitions_, (transition_count_ + 1) * sizeof(*transitions_)));
+  if (transitions_ == NULL) abort();
+
+  Shape* child = heap->shapes()->New(heap, this, key);
+  transitions_[transition_count_++] = child;
+
+  return child;
+}
+
+
+off_t Shape::NextOffset() {
+  return HMap::kSpaceOffset + length_ * HValue::kPointerSize;
+}
+
+
+ShapeTable::~ShapeTable() {
+  for (uint32_t i = 0; i < length_; i++) delete shapes_[i];
+  free(shapes_);
+}
+
+
+Shape* ShapeTable::New(Heap* heap, Shape* parent, char* key) {
+  if (length_ == size_) {
+    size_ = size_ == 0 ? 64 : size_ << 1;
+    shapes_ = reinterpret_cast<Shape**>(
+        realloc(shapes_, size_ * sizeof(*shapes_)));
+    if (shapes_ == NULL) abort();
+  }
+
+  Shape* shape = new Shape(heap, parent, key);
+  shapes_[length_++] = shape;
+
+  return shape;
+}
+
+
+Shape* ShapeTable::Root(Heap* heap) {
+  if (root_ == NULL) root_ = New(heap, NULL, NULL);
+  return root_;
+}
+
+
+StringTable::~StringTable() {
+  free(entries_);
+}
+
+
+char* StringTable::Intern(Heap* heap, char* str) {
+  char* result = Lookup(heap, str);
+  if (result != NULL) return result;
+
+  // Flat old strings are internalized in place, others are copied
+  if (HValue::GetRepresentation<HString::Representation>(str) ==
+          HString::kNormal &&
+      HValue::Cast(str)->Generation() >= Heap::kMinOldSpaceGeneration) {
+    result = str;
+  } else {
+    result = HString::New(heap,
+                          Heap::kTenureOld,
+                          HString::Value(heap, str),
+                          HString::Length(str));
   }
+
+  HValue::SetRepresentation(result, HString::kInternalized);
+  HString::Hash(heap, result);
+  Insert(result);
+
+  return result;
+}
+
+
+char* StringTable::Intern(Heap* heap, const char* value, uint32_t length) {
+  if (size_ != 0) {
+    char** entry = Find(ComputeHash(value, length), value, length);
+    if (*entry != NULL) {
+      heap->WriteBarrier(*entry);
+      return *entry;
+    }
+  }
+
+  char* result = HString::New(heap, Heap::kTenureOld, value, length);
+
+  HValue::SetRepresentation(result, HString::kInternalized);
+  HString::Hash(heap, result);
+  Insert(result);
+
+  return result;
+}
+
+
+char* StringTable::Lookup(Heap* heap, char* str) {
+  if (HString::IsInternalized(str)) return str;
+  if (size_ == 0) return NULL;
+
+  uint32_t hash = HString::Hash(heap, str);
+  char** entry = Find(hash, HString::Value(heap, str), HString::Length(str));
+  if (*entry == NULL) return NULL;
+
+  // String may be unreachable from marking's snapshot, but it's used now
+  heap->WriteBarrier(*entry);
+
+  return *entry;
+}
+
+
+void StringTable::Resize(uint32_t size) {
+  char** entries = entries_;
+  uint32_t old_size = size_;
+
+  size_ = size;
+  entries_ = reinterpret_cast<char**>(calloc(size_, sizeof(*entries_)));
+  if (entries_ == NULL) abort();
+  length_ = 0;
+
+  for (uint32_t i = 0; i < old_size; i++) {
+    if (entries[i] != NULL) Insert(entries[i]);
+  }
+  free(entries);
+}
+
+
+char* NumberStringCache::Get(char* number) {
+  uint64_t key;
+  bool boxed;
+  Entry* entry = Find(number, &key, &boxed);
+
+  if (entry->value == NULL || entry->key != key || entry->boxed != boxed) {
+    return NULL;
+  }
+  return entry->value;
+}
+
+
+void NumberStringCache::Set(char* number, char* str) {
+  uint64_t key;
+  bool boxed;
+  Entry* entry = Find(number, &key, &boxed);
+
+  entry->key = key;
+  entry->boxed = boxed;
+  entry->value = str;
+}
+
+
+void NumberStringCache::Clear() {
+  memset(entries_, 0, sizeof(entries_));
+}
+
+
+NumberStringCache::Entry* NumberStringCache::Find(char* number,
+                                                  uint64_t* key,
+                                                  bool* boxed) {
+  *boxed = !HNumber::IsIntegral(number);
+  if (*boxed) {
+    double value = HNumber::DoubleValue(number);
+    memcpy(key, &value, sizeof(value));
+  } else {
+    *key = HNumber::Untag(reinterpret_cast<int64_t>(number));
+  }
+
+  // Sequential integers are taking sequential entries
+  return &entries_[(*key ^ (*key >> 32)) & (kSize - 1)];
+}
+
+
+char** StringTable::Find(uint32_t hash, const char* value, uint32_t length) {
+  uint32_t mask = size_ - 1;
+  uint32_t index = hash & mask;
+
+  // Table is filled only by half at maximum, so there's always empty entry
+  while (entries_[index] != NULL) {
+    char* entry = entries_[index];
+    if (HString::Hash(NULL, entry) == hash &&
+        HString::Length(entry) == length &&
+        memcmp(entry + HString::kValueOffset, value, length) == 0) {
+      break;
+    }
+    index = (index + 1) & mask;
+  }
+
+  return &entries_[index];
+}
+
+
+void StringTable::Insert(char* str) {
+  if ((length_ + 1) << 1 > size_) Resize(size_ == 0 ? 256 : size_ << 1);
+
+  char** entry = Find(HString::Hash(NULL, str),
+                      str + HString::kValueOffset,
+                      HString::Length(str));
+  *entry = str;
+  length_++;
+}
+
+
+static int CompareSlots(const void* a, const void* b) {
+  char** lhs = *reinterpret_cast<char** const*>(a);
+  char** rhs = *reinterpret_cast<char** const*>(b);
+
+  return lhs < rhs ? -1 : lhs > rhs ? 1 : 0;
+}
+
+
+void RememberedSet::Compact() {
+  // Generated code is recording all stores of new space values,
+  // including stores into new space objects
+  char*** out = start_;
+  for (char*** slot = start_; slot < top_; slot++) {
+    char* addr = reinterpret_cast<char*>(*slot);
+    if (IsCleared(*slot) ||
+        (!heap()->old_space()->Contains(addr) &&
+         !heap()->large_space()->Contains(addr))) {
+      continue;
+    }
+    *out++ = *slot;
+  }
+  top_ = out;
+
+  qsort(start_, length(), sizeof(*start_), CompareSlots);
+
+  // Hot slots are recorded many times
+  if (length() != 0) {
+    out = start_ + 1;
+    for (char*** slot = start_ + 1; slot < top_; slot++) {
+      if (*slot != *(out - 1)) *out++ = *slot;
+    }
+    top_ = out;
+  }
+
+  if (length() > static_cast<uint32_t>(limit_ - start_) >> 1) Grow();
+}
+
+
+void RememberedSet::RemoveCleared() {
+  char*** out = start_;
+  for (char*** slot = start_; slot < top_; slot++) {
+    if (!IsCleared(*slot)) *out++ = *slot;
+  }
+  top_ = out;
+}
+
+
+char*** RememberedSet::Find(char* addr) {
+  char*** start = start_;
+  char*** end = top_;
+
+  while (start < end) {
+    char*** middle = start + ((end - start) >> 1);
+    if (reinterpret_cast<char*>(*middle) < addr) {
+      start = middle + 1;
+    } else {
+      end = middle;
+    }
+  }
+
+  return start;
+}
+
+
+void RememberedSet::Grow() {
+  uint32_t size = (limit_ - start_) << 1;
+  uint32_t length = this->length();
+
+  start_ = reinterpret_cast<char***>(realloc(start_, size * sizeof(*start_)));
+  if (start_ == NULL) abort();
+
+  top_ = start_ + length;
+  limit_ = start_ + size;
 }
 
 
@@ -115,19 +966,123 @@ const char* Heap::ErrorToString(Error err) {
 
 
 char* Heap::AllocateTagged(HeapTag tag, TenureType tenure, uint32_t bytes) {
-  char* result = space(tenure)->Allocate(bytes + 8);
-  off_t qtag = tag;
-  if (tenure == kTenureOld) {
-    int bit_offset = (HValue::kGenerationOffset -
-                      HValue::interior_offset(0)) << 3;
-    qtag = qtag | (kMinOldSpaceGeneration << bit_offset);
+  char* result;
+  off_t generation = 0;
+  if (bytes + 8 >= LargeSpace::kMinObjectSize) {
+    // Big objects aren't copied by GC, they're old from the start
+    result = large_space()->Allocate(bytes + 8);
+    tenure = kTenureOld;
+    generation = kLargeObjectGeneration;
+  } else {
+    result = space(tenure)->Allocate(bytes + 8);
+    if (tenure == kTenureOld) generation = kMinOldSpaceGeneration;
   }
+
+  int bit_offset = (HValue::kGenerationOffset -
+                    HValue::interior_offset(0)) << 3;
+  off_t qtag = tag | (generation << bit_offset);
   *reinterpret_cast<off_t*>(result + HValue::kTagOffset) = qtag;
 
+  if (incremental_marking()) {
+    // Objects allocated in old space while marking are considered alive
+    if (tenure == kTenureOld) HValue::Cast(result)->SetLiveGCMark();
+
+    marking_step_budget_ -= bytes;
+    if (marking_step_budget_ < 0 && needs_gc() == kGCNone) {
+      needs_gc(kGCIncrementalStep);
+    }
+  }
+
   return result;
 }
 
 
+void Heap::new_space_size(uint32_t value) {
+  new_space_size_ = value;
+  if (max_new_space_size_ < value) max_new_space_size_ = value;
+  new_space_limit_ = value;
+  new_space()->compute_size_limit();
+}
+
+
+void Heap::max_new_space_size(uint32_t value) {
+  max_new_space_size_ = value < new_space_size_ ? new_space_size_ : value;
+  if (new_space_limit_ > max_new_space_size_) {
+    new_space_limit_ = max_new_space_size_;
+  }
+  new_space()->compute_size_limit();
+}
+
+
+void Heap::old_space_growth(uint32_t value) {
+  // Space should be able to grow at least a bit
+  old_space_growth_ = value <= 100 ? 101 : value;
+  old_space()->compute_size_limit();
+  large_space()->compute_size_limit();
+}
+
+
+void Heap::max_heap_size(uint64_t value) {
+  max_heap_size_ = value;
+  old_space()->compute_size_limit();
+  large_space()->compute_size_limit();
+}
+
+
+uint32_t Heap::ComputeOldLimit(uint32_t size) {
+  uint64_t limit = static_cast<uint64_t>(size) * old_space_growth_ / 100;
+
+  // Collect more often when approaching maximum size
+  if (max_heap_size_ != 0 && limit > max_heap_size_) limit = max_heap_size_;
+  if (limit > 0xffffffff) limit = 0xffffffff;
+
+  return static_cast<uint32_t>(limit);
+}
+
+
+void Heap::ResizeNewSpace(uint32_t allocated, uint32_t survived) {
+  // Forced GCs are saying nothing about allocation pattern
+  if (allocated < new_space_limit_ >> 1) return;
+
+  uint64_t rate = static_cast<uint64_t>(survived) * 100 / allocated;
+  if (rate >= kHighSurvivalRate) {
+    // Give values more time to die before copying them again
+    if (new_space_limit_ > max_new_space_size_ >> 1) {
+      new_space_limit_ = max_new_space_size_;
+    } else {
+      new_space_limit_ <<= 1;
+    }
+  } else if (rate <= kLowSurvivalRate) {
+    // Smaller space is cheaper for cache
+    new_space_limit_ >>= 1;
+    if (new_space_limit_ < new_space_size_) new_space_limit_ = new_space_size_;
+  }
+}
+
+
+void Heap::CheckHeapSize() {
+  if (max_heap_size_ == 0) return;
+
+  // Free chunks may be reused, so they're not counted
+  uint64_t size = static_cast<uint64_t>(old_space()->size()) -
+                  old_space()->free_size() +
+                  large_space()->size();
+  if (size <= max_heap_size_) return;
+
+  fprintf(stderr,
+          "Fatal: heap size limit reached (%llu > %llu bytes)\n",
+          static_cast<unsigned long long>(size),
+          static_cast<unsigned long long>(max_heap_size_));
+  abort();
+}
+
+
+AllocationSite* Heap::NewAllocationSite() {
+  if (!pretenuring()) return NULL;
+  return allocation_sites()->New();
+}
+
+
 HValueReference* Heap::Reference(ReferenceType type,
                                  HValue** reference,
                                  HValue* value) {
@@ -167,6 +1122,26 @@ void Heap::RemoveWeak(HValue* value) {
 
 
 HValue* HValue::CopyTo(Space* old_space, Space* new_space) {
+  uint32_t size = Size();
+
+  IncrementGeneration();
+  char* result;
+  if (Generation() >= old_space->heap()->tenure_age()) {
+    // Survived enough GCs, from now on value is old
+    *reinterpret_cast<uint8_t*>(addr() + kGenerationOffset) =
+        Heap::kMinOldSpaceGeneration;
+    result = old_space->Allocate(size);
+  } else {
+    result = new_space->Allocate(size);
+  }
+
+  memcpy(result + interior_offset(0), addr() + interior_offset(0), size);
+
+  return HValue::Cast(result);
+}
+
+
+uint32_t HValue::Size() {
   assert(!IsUnboxed(addr()));
 
   uint32_t size = kPointerSize;
@@ -188,11 +1163,12 @@ HValue* HValue::CopyTo(Space* old_space, Space* new_space) {
     size += 2 * kPointerSize;
     switch (GetRepresentation<HString::Representation>(addr())) {
      case HString::kNormal:
+     case HString::kInternalized:
       // + bytes
       size += As<HString>()->length();
       break;
      case HString::kCons:
-      // + lhs + rhs + scratch_slot (for traversing)
+      // + lhs + rhs
       size += 2 * kPointerSize;
       break;
      default:
@@ -201,8 +1177,8 @@ HValue* HValue::CopyTo(Space* old_space, Space* new_space) {
     }
     break;
    case Heap::kTagObject:
-    // mask + map
-    size += 2 * kPointerSize;
+    // mask + map + shape
+    size += 3 * kPointerSize;
     break;
    case Heap::kTagArray:
     // mask + map + length
@@ -211,26 +1187,25 @@ HValue* HValue::CopyTo(Space* old_space, Space* new_space) {
    case Heap::kTagMap:
     // size + space ( keys + values )
     size += (1 + (As<HMap>()->size() << 1)) * kPointerSize;
+
+    // + growth counter + control bytes
+    if (As<HMap>()->IsDictionary()) {
+      size += kPointerSize + HMap::ControlSize(As<HMap>()->size());
+    }
     break;
    case Heap::kTagCData:
     // size + data
     size += kPointerSize + As<HCData>()->size();
     break;
+   case Heap::kTagFree:
+    // Chunk size already includes tag
+    size = HFree::Size(addr());
+    break;
    default:
     UNEXPECTED
   }
 
-  IncrementGeneration();
-  char* result;
-  if (Generation() >= Heap::kMinOldSpaceGeneration) {
-    result = old_space->Allocate(size);
-  } else {
-    result = new_space->Allocate(size);
-  }
-
-  memcpy(result + interior_offset(0), addr() + interior_offset(0), size);
-
-  return HValue::Cast(result);
+  return size;
 }
 
 
@@ -250,6 +1225,7 @@ char* HContext::New(Heap* heap,
   char** slot = reinterpret_cast<char**>(result + GetIndexDisp(0));
   while (values->length() != 0) {
     *slot = values->Shift();
+    heap->RecordSlot(result, slot);
     slot ++;
   }
 
@@ -263,16 +1239,30 @@ char* HNumber::New(Heap* heap, int64_t value) {
 
 
 char* HNumber::New(Heap* heap, Heap::TenureType tenure, double value) {
+  if (FitsFlonum(value)) return EncodeFlonum(value);
+
   char* result = heap->AllocateTagged(Heap::kTagNumber, tenure, 8);
   *reinterpret_cast<double*>(result + kValueOffset) = value;
   return result;
 }
 
 
-char* HBoolean::New(Heap* heap, Heap::TenureType tenure, bool value) {
-  char* result = heap->AllocateTagged(Heap::kTagBoolean, tenure, kPointerSize);
+char* HBoolean::New(Heap* heap, bool value) {
+  char** slot = heap->boolean_slot(value);
+  if (*slot != NULL) return *slot;
+
+  // Allocated once per heap, reference keeps it alive and updated when
+  // old space is compacted
+  char* result = heap->AllocateTagged(Heap::kTagBoolean,
+                                      Heap::kTenureOld,
+                                      kPointerSize);
   *reinterpret_cast<int8_t*>(result + kValueOffset) = value ? 1 : 0;
 
+  *slot = result;
+  heap->Reference(Heap::kRefPersistent,
+                  reinterpret_cast<HValue**>(slot),
+                  HValue::Cast(result));
+
   return result;
 }
 
@@ -280,9 +1270,10 @@ char* HBoolean::New(Heap* heap, Heap::TenureType tenure, bool value) {
 char* HString::New(Heap* heap,
                    Heap::TenureType tenure,
                    uint32_t length) {
+  // hash + length + bytes
   char* result = heap->AllocateTagged(Heap::kTagString,
                                       tenure,
-                                      length + 3 * kPointerSize);
+                                      length + 2 * kPointerSize);
 
   // Zero hash
   *reinterpret_cast<off_t*>(result + kHashOffset) = 0;
@@ -331,6 +1322,7 @@ char* HString::FlattenCons(char* addr, char* buffer) {
   while (addr != NULL) {
     switch (GetRepresentation<Representation>(addr)) {
      case kNormal:
+     case kInternalized:
       {
         uint32_t len = HString::Length(addr);
         memcpy(buffer, addr + kValueOffset, len);
@@ -368,6 +1360,7 @@ char* HString::FlattenCons(char* addr, char* buffer) {
 char* HString::Value(Heap* heap, char* addr) {
   switch (GetRepresentation<Representation>(addr)) {
    case kNormal:
+   case kInternalized:
     return addr + kValueOffset;
    case kCons:
     if (RightCons(addr) == HNil::New()) {
@@ -383,8 +1376,11 @@ char* HString::Value(Heap* heap, char* addr) {
       // Traverse cons tree and put strings in
       HString::FlattenCons(addr, value);
 
+      heap->WriteBarrier(RightCons(addr));
+      heap->WriteBarrier(LeftCons(addr));
       *RightConsSlot(addr) = HNil::New();
       *LeftConsSlot(addr) = result;
+      heap->RecordSlot(addr, LeftConsSlot(addr));
 
       return value;
     }
@@ -409,25 +1405,32 @@ uint32_t HString::Hash(Heap* heap, char* addr) {
 char* HObject::NewEmpty(Heap* heap) {
   char* obj = heap->AllocateTagged(Heap::kTagObject,
                                    Heap::kTenureNew,
-                                   2 * kPointerSize);
-  HObject::Init(heap, obj);
+                                   3 * kPointerSize);
+
+  // Set mask (unused by objects with shape)
+  *reinterpret_cast<off_t*>(obj + kMaskOffset) =
+      (kInitialSize - 1) * kPointerSize;
+  // Set map
+  *reinterpret_cast<char**>(obj + kMapOffset) =
+      HMap::NewEmpty(heap, kInitialSize);
+  // Set shape
+  *ShapeSlot(obj) = heap->shapes()->Root(heap);
 
   return obj;
 }
 
 
-void HObject::Init(Heap* heap, char* obj) {
-  static const uint32_t size = 16;
+char** HObject::LookupProperty(Heap* heap, char* addr, char* key, int insert) {
+  static char* nil_slot;
 
-  // Set mask
-  *reinterpret_cast<off_t*>(obj + kMaskOffset) = (size - 1) * kPointerSize;
-  // Set map
-  *reinterpret_cast<char**>(obj + kMapOffset) = HMap::NewEmpty(heap, size);
-}
+  off_t offset = RuntimeLookupProperty(heap, addr, key, insert);
 
+  // There's no slot for missing property
+  if (offset == Heap::kTagNil) {
+    nil_slot = HNil::New();
+    return &nil_slot;
+  }
 
-char** HObject::LookupProperty(Heap* heap, char* addr, char* key, int insert) {
-  off_t offset = RuntimeLookupProperty(heap, addr, key, insert);
   return reinterpret_cast<char**>(HObject::Map(addr) + offset);
 }
 
@@ -437,33 +1440,48 @@ char* HArray::NewEmpty(Heap* heap) {
                                    Heap::kTenureNew,
                                    3 * kPointerSize);
 
-  HObject::Init(heap, obj);
+  // Set mask, dense elements are occupying both halves of the map
+  *reinterpret_cast<off_t*>(obj + kMaskOffset) =
+      (kInitialCapacity - 1) * kPointerSize;
+  // Set map
+  *MapSlot(obj) = HMap::NewEmpty(heap, kInitialCapacity >> 1);
 
-  // Set length
+  // Set length, no elements yet - the most specific kind
   SetLength(obj, 0);
+  SetRepresentation(obj, kSmiElements);
 
   return obj;
 }
 
 
+// Raw double elements have no slots, holes are checked in place
+static bool IsMissingElement(char* obj, int64_t index) {
+  if (HArray::Kind(obj) != HArray::kDoubleElements) {
+    // NOTE: passing NULL as heap is completely safe here,
+    // as we ain't going to allocate or change anything
+    char* key = HNumber::ToPointer(index);
+    return *HObject::LookupProperty(NULL, obj, key, 0) == HNil::New();
+  }
+
+  if (index < 0 || index >= HArray::Capacity(obj)) return true;
+
+  uint64_t* space = reinterpret_cast<uint64_t*>(HObject::Map(obj) +
+                                                HMap::kSpaceOffset);
+  return space[index] == HArray::kHoleNaN;
+}
+
+
 int64_t HArray::Length(char* obj, bool shrink) {
   int64_t result = *reinterpret_cast<int64_t*>(obj + kLengthOffset);
 
   if (shrink) {
     // Lookup property at [length - 1]
     // Shrink if it's nil
-    //
-    // NOTE: passing NULL as heap is completely safe here,
-    // as we ain't going to allocate or change anything
     int64_t shrinked = result;
-    char* shrinkedptr;
-    char** slot;
     do {
       if (shrinked < 0) break;
       shrinked--;
-      shrinkedptr = reinterpret_cast<char*>(HNumber::Tag(shrinked));
-      slot = HObject::LookupProperty(NULL, obj, shrinkedptr, 0);
-    } while (*slot == HNil::New());
+    } while (IsMissingElement(obj, shrinked));
 
     // If array was shrinked - change length
     if (result != (shrinked - 1)) {
@@ -477,24 +1495,65 @@ int64_t HArray::Length(char* obj, bool shrink) {
 
 
 char* HMap::NewEmpty(Heap* heap, uint32_t size) {
-  char* map = heap->AllocateTagged(Heap::kTagMap,
-                                   Heap::kTenureNew,
-                                   ((size << 1) + 1) * kPointerSize);
+  return New(heap, size, kPlain);
+}
+
+
+char* HMap::NewDictionary(Heap* heap, uint32_t size) {
+  return New(heap, size, kDictionary);
+}
+
+
+char* HMap::NewDoubles(Heap* heap, uint32_t size) {
+  return New(heap, size, kDoubles);
+}
+
+
+char* HMap::New(Heap* heap, uint32_t size, Representation representation) {
+  uint32_t bytes = ((size << 1) + 1) * kPointerSize;
+  if (representation == kDictionary) {
+    bytes += kPointerSize + ControlSize(size);
+  }
+
+  char* map = heap->AllocateTagged(Heap::kTagMap, Heap::kTenureNew, bytes);
+  SetRepresentation(map, representation);
 
   // Set map's size
   *reinterpret_cast<off_t*>(map + kSizeOffset) = size;
 
   // Nullify all map's slots (both keys and values)
-  size = (size << 1) * kPointerSize;
-  memset(map + kSpaceOffset, 0x00, size);
-  for (uint32_t i = 0; i < size; i += kPointerSize) {
-    map[i + kSpaceOffset] = Heap::kTagNil;
+  uint32_t space_size = (size << 1) * kPointerSize;
+  if (representation == kDoubles) {
+    uint64_t* space = reinterpret_cast<uint64_t*>(map + kSpaceOffset);
+    for (uint32_t i = 0; i < size << 1; i++) space[i] = HArray::kHoleNaN;
+  } else {
+    memset(map + kSpaceOffset, 0x00, space_size);
+    for (uint32_t i = 0; i < space_size; i += kPointerSize) {
+      map[i + kSpaceOffset] = Heap::kTagNil;
+    }
+  }
+
+  if (representation == kDictionary) {
+    HMap* hmap = As<HMap>(map);
+    hmap->growth_left(MaxGrowth(size));
+    memset(hmap->control(), kEmptySlot, ControlSize(size));
   }
 
   return map;
 }
 
 
+char* HFree::New(char* addr, uint32_t size) {
+  // Tag and size are sharing one word, GC mark is cleared
+  off_t qtag = Heap::kTagFree;
+  int bit_offset = (kSizeOffset - HValue::interior_offset(0)) << 3;
+  qtag = qtag | (static_cast<off_t>(size) << bit_offset);
+  *reinterpret_cast<off_t*>(addr + HValue::kTagOffset) = qtag;
+
+  return addr;
+}
+
+
 char* HFunction::New(Heap* heap, char* parent, char* addr, char* root) {
   char* fn = heap->AllocateTagged(Heap::kTagFunction,
                                   Heap::kTenureOld,
@@ -508,6 +1567,8 @@ char* HFunction::New(Heap* heap, char* parent, char* addr, char* root) {
 
   // Set root context
   *reinterpret_cast<char**>(fn + kRootOffset) = root;
+  heap->RecordSlot(fn, reinterpret_cast<char**>(fn + kParentOffset));
+  heap->RecordSlot(fn, reinterpret_cast<char**>(fn + kRootOffset));
 
   // Set argc
   *reinterpret_cast<char**>(fn + kArgcOffset) = NULL;
@@ -7,16 +7,36 @@
 //  * new space - all objects will be allocated here
 //  * old space - tenured objects will be placed here
 //
-// Both spaces are lists of allocated buffers(pages) with a stack structure
+// Both spaces are lists of allocated buffers(pages) with a stack structure.
+// Old space is swept in place: gaps between live objects are put into
+// free lists and reused by the following allocations.
+//
+// Slots of old objects that are referencing new space values are kept in
+// remembered set, so new space GC doesn't need to visit old space.
+//
+// Pages are taken from and returned to the heap's page pool, released
+// pages are processed by a background thread.
+//
+// Big objects are placed in large space, each of them on its own page.
+// They are tenured at allocation, marked in place and never copied.
+//
+// Literals are allocated directly in old space if most values of their
+// allocation site survive new space GC (pretenuring).
+//
+// Objects are sharing hidden classes (shapes) that map keys to offsets of
+// values, objects with too many keys are turned into hash maps.
 //
 
 #include "zone.h" // ZoneObject
 #include "gc.h" // GC
 #include "source-map.h" // SourceMap
+#include "ic.h" // ICTable
+#include "feedback.h" // FeedbackTable
 #include "utils.h"
 
 #include <stdint.h> // uint32_t
 #include <sys/types.h> // size_t
+#include <pthread.h> // pthread_t, pthread_mutex_t, pthread_cond_t
 
 namespace candor {
 namespace internal {
@@ -30,37 +50,54 @@ class Space {
  public:
   class Page {
    public:
-    Page(uint32_t size) : size_(size) {
-      data_ = new char[size];
+    // Memory is mapped directly, huge pages are used if `huge` is true and
+    // size is a multiple of huge page size
+    Page(uint32_t size, bool huge);
+    ~Page();
+
+    inline void Reset() {
       // Make all offsets odd (pointers are tagged with 1 at last bit)
       top_ = data_ + 1;
-      limit_ = data_ + size;
-    }
-    ~Page() {
-      delete[] data_;
+      limit_ = data_ + size_;
+      scan_ = top_;
     }
 
     char* data_;
     char* top_;
     char* limit_;
+
+    // Values below scan pointer were visited by GC (see GC::ScanTmpSpace)
+    char* scan_;
     uint32_t size_;
   };
 
+  // Sizes of values are rounded up to it. Flonums are using second bit of
+  // the value, so it should be clear in pointers
+#ifdef CANDOR_FLONUMS
+  static const uint32_t kAlignment = 4;
+#else
+  static const uint32_t kAlignment = 2;
+#endif // CANDOR_FLONUMS
+
   Space(Heap* heap, uint32_t page_size);
+  virtual ~Space();
 
   // Adds empty page of specific size
   void AddPage(uint32_t size);
 
   // Move to next page where are at least `bytes` free
   // Otherwise allocate new page
-  char* Allocate(uint32_t bytes);
+  virtual char* Allocate(uint32_t bytes);
 
   // Deallocate all pages and take all from the `space`
-  void Swap(Space* space);
+  virtual void Swap(Space* space);
 
-  // Remove all pages
+  // Return all pages to the page pool
   void Clear();
 
+  // Bytes taken by values on all pages
+  uint32_t Used();
+
   inline Heap* heap() { return heap_; }
 
   // Both top and limit are always pointing to current page's
@@ -69,12 +106,13 @@ class Space {
   inline char*** limit() { return &limit_; }
 
   inline uint32_t page_size() { return page_size_; }
+  inline List<Page*, EmptyClass>* pages() { return &pages_; }
 
   inline uint32_t size() { return size_; }
   inline uint32_t size_limit() { return size_limit_; }
-  inline void compute_size_limit() {
-    size_limit_ = size_ << 1;
-  }
+
+  // GC is requested when space grows above the limit (see Heap's policy)
+  void compute_size_limit();
 
  protected:
   Heap* heap_;
@@ -91,6 +129,414 @@ class Space {
   uint32_t size_limit_;
 };
 
+// Pages of all spaces, released pages are freed by background thread or
+// kept for reuse if they have the default size. Next GC may need as many
+// pages as are in use now, free pages above that are kept without their
+// contents.
+class PagePool {
+ public:
+  static const uint32_t kHugePageSize = 2 * 1024 * 1024;
+
+  // Free pages above this number are unmapped
+  static const uint32_t kDefaultMaxRetainedPages = 64;
+
+  PagePool(uint32_t page_size);
+  ~PagePool();
+
+  // Reuse free page or allocate new one
+  Space::Page* Get(uint32_t size);
+
+  // Hand page to the background thread
+  void Release(Space::Page* page);
+
+  inline uint32_t page_size() { return page_size_; }
+
+  inline bool huge_pages() { return huge_pages_; }
+  inline void huge_pages(bool value) { huge_pages_ = value; }
+  inline uint32_t max_retained_pages() { return max_retained_pages_; }
+  inline void max_retained_pages(uint32_t value) {
+    max_retained_pages_ = value;
+  }
+
+ protected:
+  static void* Loop(void* arg);
+
+  // Invoked in background thread
+  void Process(Space::Page* page);
+
+  pthread_t thread_;
+  pthread_mutex_t mutex_;
+  pthread_cond_t cond_;
+  bool started_;
+  bool stopped_;
+
+  uint32_t page_size_;
+  bool huge_pages_;
+  volatile uint32_t max_retained_pages_;
+
+  // Number of default-size pages given to spaces
+  uint32_t in_use_;
+
+  // Pages waiting for background thread and ones ready for reuse
+  List<Space::Page*, EmptyClass> released_;
+  List<Space::Page*, EmptyClass> free_;
+};
+
+// Non-moving space for tenured objects
+class OldSpace : public Space {
+ public:
+  // Objects are aligned, so any gap can hold a free chunk
+  static const uint32_t kAlignment = 8;
+
+  // Chunks smaller than that are not reused
+  static const uint32_t kMinFreeChunk = 16;
+
+  // Lists for chunks of exact size and one for larger chunks
+  static const uint32_t kFreeListCount = 64;
+
+  OldSpace(Heap* heap, uint32_t page_size);
+
+  char* Allocate(uint32_t bytes);
+  void Swap(Space* space);
+
+  // Walk objects on all pages, reset marks of live objects, put gaps into
+  // free lists and release pages without live objects.
+  // Returns amount of live bytes
+  uint32_t Sweep();
+
+  // Turn memory region into free chunk (and reuse it if it isn't too small)
+  void AddFree(char* addr, uint32_t size);
+  void ClearFreeLists();
+
+  // Percent of space that is occupied by free chunks
+  inline uint32_t fragmentation() {
+    if (size() == 0) return 0;
+    return static_cast<uint32_t>(
+        (static_cast<uint64_t>(free_size_) * 100) / size());
+  }
+
+  inline uint32_t free_size() { return free_size_; }
+
+  // Check if address belongs to one of space's objects
+  bool Contains(char* addr);
+
+ protected:
+  char* AllocateFromFreeList(uint32_t bytes);
+
+  static inline uint32_t FreeListIndex(uint32_t size) {
+    uint32_t index = size / kAlignment;
+    return index < kFreeListCount - 1 ? index : kFreeListCount - 1;
+  }
+
+  char* free_lists_[kFreeListCount];
+  uint32_t free_size_;
+};
+
+// Non-moving space for big objects, every object has its own page
+class LargeSpace {
+ public:
+  // Objects of this size (including tag) or bigger are allocated here
+  static const uint32_t kMinObjectSize = 256 * 1024;
+
+  LargeSpace(Heap* heap);
+  ~LargeSpace();
+
+  char* Allocate(uint32_t bytes);
+
+  // Release pages of objects without live mark and reset marks of others
+  void Sweep();
+
+  // Check if address belongs to one of space's objects
+  bool Contains(char* addr);
+
+  inline Heap* heap() { return heap_; }
+
+  inline uint32_t size() { return size_; }
+  inline uint32_t size_limit() { return size_limit_; }
+  void compute_size_limit();
+
+ protected:
+  Heap* heap_;
+
+  List<Space::Page*, EmptyClass> pages_;
+
+  uint32_t size_;
+  uint32_t size_limit_;
+};
+
+// Addresses of old space slots that may contain new space values
+class RememberedSet {
+ public:
+  static const uint32_t kInitialSize = 4096;
+
+  RememberedSet(Heap* heap);
+  ~RememberedSet();
+
+  // Generated code is inlining the same thing
+  inline void Record(char** slot) {
+    *top_++ = slot;
+    if (top_ == limit_) Compact();
+  }
+
+  // Used by GC, when slots are in space that isn't yet old space
+  inline void Push(char** slot) {
+    *top_++ = slot;
+    if (top_ == limit_) Grow();
+  }
+
+  // Remove cleared slots, slots that are not in old space and duplicates.
+  // Leaves slots sorted, grows if set is still more than half full
+  void Compact();
+
+  // Slots are aligned, cleared ones are tagged with the lowest bit
+  // to keep set sorted until they'll be removed
+  static inline void ClearSlot(char*** slot) {
+    *slot = reinterpret_cast<char**>(reinterpret_cast<off_t>(*slot) | 1);
+  }
+  static inline bool IsCleared(char** slot) {
+    return (reinterpret_cast<off_t>(slot) & 1) != 0;
+  }
+  void RemoveCleared();
+
+  // Find first slot that is not less than `addr` (set should be sorted)
+  char*** Find(char* addr);
+
+  void Grow();
+  inline void Clear() { top_ = start_; }
+
+  inline Heap* heap() { return heap_; }
+  inline char*** start() { return start_; }
+  inline char*** end() { return top_; }
+  inline uint32_t length() { return top_ - start_; }
+
+  // Generated code appends slots by itself
+  inline char**** top() { return &top_; }
+  inline char**** limit() { return &limit_; }
+
+ protected:
+  Heap* heap_;
+
+  char*** start_;
+  char*** top_;
+  char*** limit_;
+};
+
+// Site of object or array literal in generated code. Values allocated there
+// are carrying site's index in their tag. New space GC counts values that
+// have survived, and site allocates in old space once most of them do.
+class AllocationSite {
+ public:
+  // Decision is made after that many allocations (or swept old values)
+  static const uint64_t kMinAllocations = 1000;
+
+  // Percent of surviving values that makes site pretenured
+  static const uint64_t kTenureRate = 80;
+
+  // Percent of dead old values that makes site allocate in new space again
+  static const uint64_t kUntenureRate = 50;
+
+  AllocationSite(uint32_t index) : index_(index),
+                                   allocated_(0),
+                                   survived_(0),
+                                   live_(0),
+                                   dead_(0),
+                                   generation_(0) {
+  }
+
+  // Invoked after GC, updates generation of allocated values
+  void Update();
+
+  inline uint32_t index() { return index_; }
+  inline bool is_tenured() { return generation_ != 0; }
+
+  // Generated code counts allocations and reads generation
+  inline uint64_t* allocated_addr() { return &allocated_; }
+  inline uint8_t* generation_addr() { return &generation_; }
+
+  // Value has survived its first new space GC
+  inline void RecordSurvival() { survived_++; }
+
+  // Old value was swept
+  inline void RecordSweep(bool is_live) {
+    if (is_live) {
+      live_++;
+    } else {
+      dead_++;
+    }
+  }
+
+ protected:
+  uint32_t index_;
+  uint64_t allocated_;
+  uint64_t survived_;
+  uint64_t live_;
+  uint64_t dead_;
+  uint8_t generation_;
+};
+
+// Sites are never removed, index 0 means no site
+class AllocationSiteTable {
+ public:
+  // Index should fit into value's tag
+  static const uint32_t kMaxSites = 0xffff;
+
+  AllocationSiteTable();
+  ~AllocationSiteTable();
+
+  // Returns NULL if all indexes are taken
+  AllocationSite* New();
+
+  inline AllocationSite* Get(uint32_t index) { return sites_[index - 1]; }
+
+  // Let sites make decisions after GC
+  void Update();
+
+ protected:
+  AllocationSite** sites_;
+  uint32_t length_;
+  uint32_t size_;
+};
+
+// Hidden class of object. Objects that got the same keys in the same order
+// are sharing one shape, their maps contain only values and shape's table
+// holds offsets of them. Adding a key moves object to a child shape
+// (transition). Objects without shape (dictionary mode) are keeping both
+// keys and values in a hash map.
+class Shape {
+ public:
+  // Objects with more keys are turned into dictionary mode
+  static const uint32_t kMaxLength = 64;
+
+  // Shape won't get more children than that, objects that are adding other
+  // keys are turned into dictionary mode too
+  static const uint32_t kMaxTransitions = 64;
+
+  struct Entry {
+    char* key;
+    off_t offset;
+  };
+
+  // Generated code probes table by string's hash,
+  // keep these fields at the start
+  static const int kMaskOffset = 0;
+  static const int kTableOffset = 8;
+
+  Shape(Heap* heap, Shape* parent, char* key);
+  ~Shape();
+
+  // Offset of key's value relative to the map, -1 if there's no such key
+  off_t Lookup(Heap* heap, char* key);
+
+  // Shape with key added to this one, NULL if object should be turned into
+  // dictionary mode instead
+  Shape* Transition(Heap* heap, char* key);
+
+  // Offset of the value that will be added by transition
+  off_t NextOffset();
+
+  inline uint32_t length() { return length_; }
+
+  // All keys are referenced from table (GC updates them)
+  inline uint32_t table_size() { return (mask_ / sizeof(Entry)) + 1; }
+  inline Entry* table() { return table_; }
+
+ protected:
+  Entry* Insert(Heap* heap, char* key, off_t offset);
+
+  off_t mask_;
+  Entry* table_;
+
+  // Entry added by transition from parent (NULL in root shape)
+  Entry* last_;
+
+  uint32_t length_;
+
+  Shape** transitions_;
+  uint32_t transition_count_;
+};
+
+// Shapes are never removed, keys of them are roots for GC
+class ShapeTable {
+ public:
+  ShapeTable() : shapes_(NULL), length_(0), size_(0), root_(NULL) {
+  }
+  ~ShapeTable();
+
+  Shape* New(Heap* heap, Shape* parent, char* key);
+
+  // Shape of empty object
+  Shape* Root(Heap* heap);
+
+  inline uint32_t length() { return length_; }
+  inline Shape* Get(uint32_t index) { return shapes_[index]; }
+
+ protected:
+  Shape** shapes_;
+  uint32_t length_;
+  uint32_t size_;
+  Shape* root_;
+};
+
+// Flat old space strings that are used as property names. There's only one
+// internalized string with given contents, so objects are comparing keys
+// by pointers. Table doesn't keep strings alive, GC removes dead ones.
+class StringTable {
+ public:
+  StringTable() : entries_(NULL), length_(0), size_(0) {
+  }
+  ~StringTable();
+
+  // Internalized string with the same contents (created if there's none)
+  char* Intern(Heap* heap, char* str);
+  char* Intern(Heap* heap, const char* value, uint32_t length);
+
+  // Internalized string with the same contents, NULL if there's none
+  char* Lookup(Heap* heap, char* str);
+
+  // GC is NULLing entries of dead strings and updating moved ones,
+  // rehash remaining ones after it
+  inline void Rehash() { if (size_ != 0) Resize(size_); }
+
+  inline uint32_t size() { return size_; }
+  inline char** entries() { return entries_; }
+
+ protected:
+  char** Find(uint32_t hash, const char* value, uint32_t length);
+  void Insert(char* str);
+  void Resize(uint32_t size);
+
+  char** entries_;
+  uint32_t length_;
+  uint32_t size_;
+};
+
+// Strings of recently converted numbers, indexed by number's value. Cached
+// strings are new space values that aren't visited by GC, so cache is
+// cleared on every collection.
+class NumberStringCache {
+ public:
+  static const uint32_t kSize = 1024;
+
+  NumberStringCache() { Clear(); }
+
+  // String of the number (either unboxed or heap one), NULL if it isn't
+  // cached
+  char* Get(char* number);
+  void Set(char* number, char* str);
+  void Clear();
+
+ protected:
+  struct Entry {
+    uint64_t key;
+    bool boxed;
+    char* value;
+  };
+
+  Entry* Find(char* number, uint64_t* key, bool* boxed);
+
+  Entry entries_[kSize];
+};
+
 typedef List<HValueReference*, EmptyClass> HValueRefList;
 typedef List<HValueWeakRef*, EmptyClass> HValueWeakRefList;
 
@@ -109,7 +555,10 @@ class Heap {
     kTagFunction,
     kTagCData,
 
-    kTagMap
+    kTagMap,
+
+    // Gap in old space
+    kTagFree
   };
 
   enum TenureType {
@@ -118,9 +567,10 @@ class Heap {
   };
 
   enum GCType {
-    kGCNone     = 0,
-    kGCNewSpace = 1,
-    kGCOldSpace = 2
+    kGCNone            = 0,
+    kGCNewSpace        = 1,
+    kGCOldSpace        = 2,
+    kGCIncrementalStep = 3
   };
 
   enum Error {
@@ -151,22 +601,68 @@ class Heap {
     kRefPersistent
   };
 
-  // Tenure configuration (GC)
-  static const int8_t kMinOldSpaceGeneration = 5;
+  // Tenure configuration (GC), values are getting this generation once
+  // they've survived `tenure_age` new space GCs
+  static const int8_t kMinOldSpaceGeneration = 16;
+  static const uint32_t kDefaultTenureAge = 5;
+
+  // Large space objects are old from the start and are never moved
+  static const int8_t kLargeObjectGeneration = 0x40;
   static const uint32_t kBindingContextTag = 0x0DEC0DEC;
   static const uint32_t kEnterFrameTag = 0xFEEDBEEE;
 
-  Heap(uint32_t page_size) : new_space_(this, page_size),
+  // Incremental marking configuration (GC)
+  static const uint32_t kDefaultMarkingSliceBudget = 1000; // microseconds
+  static const int64_t kMarkingStepBytes = 256 * 1024;
+  static const int64_t kMarkingIdleBudget = 0x3fffffffffffffffLL;
+
+  // Compact old space when free chunks take more than this percent of it
+  static const uint32_t kDefaultCompactionThreshold = 50;
+
+  // Threads used for marking while mutator is waiting
+  static const uint32_t kDefaultGCThreads = 1;
+
+  // Sizing policy: new space may take `new_space_size` bytes above the
+  // values that have survived previous GC (but not less than survivors).
+  // That size is doubled (up to maximum) if too many values are surviving
+  // and halved if most die.
+  static const uint32_t kDefaultNewSpaceSize = 2 * 1024 * 1024;
+  static const uint32_t kDefaultMaxNewSpaceSize = 16 * 1024 * 1024;
+  static const uint32_t kHighSurvivalRate = 20; // percent
+  static const uint32_t kLowSurvivalRate = 5; // percent
+
+  // Old space may grow to this percent of its size after full GC
+  static const uint32_t kDefaultOldSpaceGrowth = 200;
+
+  Heap(uint32_t page_size) : new_space_size_(kDefaultNewSpaceSize),
+                             max_new_space_size_(kDefaultMaxNewSpaceSize),
+                             new_space_limit_(kDefaultNewSpaceSize),
+                             old_space_growth_(kDefaultOldSpaceGrowth),
+                             tenure_age_(kDefaultTenureAge),
+                             max_heap_size_(0),
+                             page_pool_(page_size),
+                             new_space_(this, page_size),
                              old_space_(this, page_size),
+                             large_space_(this),
+                             remembered_set_(this),
+                             pretenuring_(true),
                              last_stack_(NULL),
                              last_frame_(NULL),
                              pending_exception_(NULL),
                              needs_gc_(kGCNone),
+                             incremental_marking_(0),
+                             marking_step_budget_(kMarkingIdleBudget),
+                             incremental_gc_(true),
+                             marking_slice_budget_(kDefaultMarkingSliceBudget),
+                             compaction_threshold_(kDefaultCompactionThreshold),
+                             gc_threads_(kDefaultGCThreads),
                              gc_(this) {
     current_ = this;
     references_.allocated = true;
     reloc_references_.allocated = true;
     weak_references_.allocated = true;
+    booleans_[0] = NULL;
+    booleans_[1] = NULL;
   }
 
   // TODO: Use thread id
@@ -189,7 +685,15 @@ class Heap {
   void RemoveWeak(HValue* value);
 
   inline Space* new_space() { return &new_space_; }
-  inline Space* old_space() { return &old_space_; }
+  inline OldSpace* old_space() { return &old_space_; }
+  inline LargeSpace* large_space() { return &large_space_; }
+  inline RememberedSet* remembered_set() { return &remembered_set_; }
+  inline AllocationSiteTable* allocation_sites() { return &allocation_sites_; }
+  inline ShapeTable* shapes() { return &shapes_; }
+  inline StringTable* strings() { return &strings_; }
+  inline NumberStringCache* number_strings() { return &number_strings_; }
+  inline ICTable* ics() { return &ics_; }
+  inline FeedbackTable* feedback() { return &feedback_; }
 
   inline Space* space(TenureType type) {
     if (type == kTenureOld) {
@@ -202,22 +706,124 @@ class Heap {
   inline char** last_stack() { return &last_stack_; }
   inline char** last_frame() { return &last_frame_; }
   inline char** pending_exception() { return &pending_exception_; }
+  inline char** boolean_slot(bool value) { return &booleans_[value ? 1 : 0]; }
 
   inline GCType* needs_gc_addr() {
     return reinterpret_cast<GCType*>(&needs_gc_);
   }
   inline GCType needs_gc() { return static_cast<GCType>(needs_gc_); }
   inline void needs_gc(GCType value) { needs_gc_ = value; }
+
+  // Non-zero while old space is being marked incrementally,
+  // checked by write barrier in generated code
+  inline uint8_t* incremental_marking_addr() {
+    return reinterpret_cast<uint8_t*>(&incremental_marking_);
+  }
+  inline bool incremental_marking() { return incremental_marking_ != 0; }
+  inline void incremental_marking(bool value) {
+    incremental_marking_ = value ? 1 : 0;
+  }
+
+  // Amount of bytes that may be allocated before next marking step
+  inline int64_t* marking_step_budget_addr() { return &marking_step_budget_; }
+  inline void marking_step_budget(int64_t value) {
+    marking_step_budget_ = value;
+  }
+
+  inline bool incremental_gc() { return incremental_gc_; }
+  inline void incremental_gc(bool value) { incremental_gc_ = value; }
+  inline uint32_t marking_slice_budget() { return marking_slice_budget_; }
+  inline void marking_slice_budget(uint32_t value) {
+    marking_slice_budget_ = value;
+  }
+
+  // 100 and more - disables compaction
+  inline uint32_t compaction_threshold() { return compaction_threshold_; }
+  inline void compaction_threshold(uint32_t value) {
+    compaction_threshold_ = value;
+  }
+
+  inline uint32_t gc_threads() { return gc_threads_; }
+  inline void gc_threads(uint32_t value) {
+    gc_threads_ = value == 0 ? 1 : value;
+  }
+
+  // Sizing policy, limits of spaces are recomputed on change
+  inline uint32_t new_space_size() { return new_space_size_; }
+  void new_space_size(uint32_t value);
+  inline uint32_t max_new_space_size() { return max_new_space_size_; }
+  void max_new_space_size(uint32_t value);
+  inline uint32_t new_space_limit() { return new_space_limit_; }
+  inline uint32_t old_space_growth() { return old_space_growth_; }
+  void old_space_growth(uint32_t value);
+  inline uint32_t tenure_age() { return tenure_age_; }
+  inline void tenure_age(uint32_t value) {
+    if (value < 1) value = 1;
+    uint32_t max = static_cast<uint32_t>(kMinOldSpaceGeneration);
+    tenure_age_ = value > max ? max : value;
+  }
+
+  // Zero - unlimited
+  inline uint64_t max_heap_size() { return max_heap_size_; }
+  void max_heap_size(uint64_t value);
+
+  // Limit of old or large space that has `size` bytes after GC
+  uint32_t ComputeOldLimit(uint32_t size);
+
+  // Grow or shrink new space depending on amount of `allocated` bytes that
+  // have `survived` new space GC
+  void ResizeNewSpace(uint32_t allocated, uint32_t survived);
+
+  // Abort if tenured values are taking more than maximum heap size
+  void CheckHeapSize();
+
+  // Allocation site for literal, NULL if pretenuring is disabled
+  AllocationSite* NewAllocationSite();
+
+  inline bool pretenuring() { return pretenuring_; }
+  inline void pretenuring(bool value) { pretenuring_ = value; }
+
+  // Snapshot-at-the-beginning write barrier, should be invoked with
+  // the value that is going to be overwritten
+  inline void WriteBarrier(char* old_value) {
+    if (incremental_marking_ != 0) gc_.RecordWrite(old_value);
+  }
+
+  // Generational write barrier, should be invoked after storing value
+  // into `host` object's slot
+  inline void RecordSlot(char* host, char** slot);
+
   inline HValueRefList* references() { return &references_; }
   inline HValueRefList* reloc_references() { return &reloc_references_; }
   inline HValueWeakRefList* weak_references() { return &weak_references_; }
 
   inline GC* gc() { return &gc_; }
   inline SourceMap* source_map() { return &source_map_; }
+  inline PagePool* page_pool() { return &page_pool_; }
 
  private:
+  // Spaces are using policy in constructors
+  uint32_t new_space_size_;
+  uint32_t max_new_space_size_;
+  uint32_t new_space_limit_;
+  uint32_t old_space_growth_;
+  uint32_t tenure_age_;
+  uint64_t max_heap_size_;
+
+  // Should outlive spaces
+  PagePool page_pool_;
+
   Space new_space_;
-  Space old_space_;
+  OldSpace old_space_;
+  LargeSpace large_space_;
+  RememberedSet remembered_set_;
+  AllocationSiteTable allocation_sites_;
+  bool pretenuring_;
+  ShapeTable shapes_;
+  StringTable strings_;
+  NumberStringCache number_strings_;
+  ICTable ics_;
+  FeedbackTable feedback_;
 
   // Support reentering candor after invoking C++ side
   char* last_stack_;
@@ -225,7 +831,17 @@ class Heap {
 
   char* pending_exception_;
 
+  // Canonical `false` and `true` (see HBoolean::New)
+  char* booleans_[2];
+
   off_t needs_gc_;
+  off_t incremental_marking_;
+  int64_t marking_step_budget_;
+
+  bool incremental_gc_;
+  uint32_t marking_slice_budget_;
+  uint32_t compaction_threshold_;
+  uint32_t gc_threads_;
 
   HValueRefList references_;
   HValueRefList reloc_references_;
@@ -262,6 +878,9 @@ class HValue {
 
   HValue* CopyTo(Space* old_space, Space* new_space);
 
+  // Size of object including tag
+  uint32_t Size();
+
   inline bool IsGCMarked();
   inline char* GetGCMark();
   inline void SetGCMark(char* new_addr);
@@ -270,9 +889,23 @@ class HValue {
   inline void SetSoftGCMark();
   inline void ResetSoftGCMark();
 
+  // Incremental marking
+  inline bool IsLiveGCMarked();
+  inline void SetLiveGCMark();
+  inline void ResetLiveGCMark();
+
+  // Atomically set mark, returns true if value was already marked
+  inline bool TestAndSetLiveGCMark();
+
   inline void IncrementGeneration();
   inline uint8_t Generation();
 
+  // Value was allocated in large space
+  inline bool IsLarge();
+
+  // Index of literal's allocation site, zero if there's none
+  inline uint32_t AllocationSiteIndex();
+
   template <typename Representation>
   static inline Representation GetRepresentation(char* addr) {
     return static_cast<Representation>(*reinterpret_cast<uint8_t*>(
@@ -291,12 +924,14 @@ class HValue {
   static const int kGCForwardOffset = HINTERIOR_OFFSET(1);
   static const int kRepresentationOffset = HINTERIOR_OFFSET(0) + 1;
   static const int kGenerationOffset = HINTERIOR_OFFSET(0) + 2;
+  static const int kAllocationSiteOffset = HINTERIOR_OFFSET(0) + 3;
 
   static inline int interior_offset(int offset) {
     return HINTERIOR_OFFSET(offset);
   }
 
   static inline Heap::HeapTag GetTag(char* addr);
+  // True for every value that isn't a pointer to the heap (nil excluded)
   static inline bool IsUnboxed(char* addr);
 
   inline Heap::HeapTag tag() { return GetTag(addr()); }
@@ -400,7 +1035,17 @@ class HNumber : public HValue {
 
   static inline bool IsIntegral(char* addr);
 
+  // When built with CANDOR_FLONUMS doubles with exponent in [-255, 256]
+  // are stored in the value itself (low bits 0b11): bits 61 and 60 are
+  // dropped (they're both inverse of bit 62), the rest is rotated left by 4.
+  // Other doubles (zero, NaN, infinities, huge values) live in heap.
+  static inline bool IsFlonum(char* addr);
+  static inline bool FitsFlonum(double value);
+  static inline char* EncodeFlonum(double value);
+  static inline double DecodeFlonum(char* addr);
+
   static const int kValueOffset = HINTERIOR_OFFSET(1);
+  static const int kFlonumTag = 0x03;
 
   static const Heap::HeapTag class_tag = Heap::kTagNumber;
 };
@@ -408,7 +1053,8 @@ class HNumber : public HValue {
 
 class HBoolean : public HValue {
  public:
-  static char* New(Heap* heap, Heap::TenureType tenure, bool value);
+  // Booleans are immutable, every `true` (or `false`) is the same value
+  static char* New(Heap* heap, bool value);
 
   inline bool is_true() { return Value(addr()); }
   inline bool is_false() { return !is_true(); }
@@ -425,9 +1071,11 @@ class HBoolean : public HValue {
 
 class HString : public HValue {
  public:
+  // Internalized strings are flat too
   enum Representation {
-    kNormal = 0x00,
-    kCons   = 0x01
+    kNormal       = 0x00,
+    kCons         = 0x01,
+    kInternalized = 0x02
   };
 
   static char* New(Heap* heap,
@@ -453,6 +1101,10 @@ class HString : public HValue {
     return *reinterpret_cast<uint32_t*>(addr + kLengthOffset);
   }
 
+  static inline bool IsInternalized(char* addr) {
+    return GetRepresentation<Representation>(addr) == kInternalized;
+  }
+
   static inline char* LeftCons(char* addr) { return *LeftConsSlot(addr); }
   static inline char* RightCons(char* addr) { return *RightConsSlot(addr); }
 
@@ -480,7 +1132,6 @@ class HString : public HValue {
 class HObject : public HValue {
  public:
   static char* NewEmpty(Heap* heap);
-  static void Init(Heap* heap, char* obj);
 
   inline char* map() { return *map_slot(); }
   inline char** map_slot() { return MapSlot(addr()); }
@@ -496,10 +1147,20 @@ class HObject : public HValue {
   }
   static inline uint32_t Mask(char* addr) { return *MaskSlot(addr); }
 
+  // Objects only (arrays have length there), NULL in dictionary mode
+  static inline Shape** ShapeSlot(char* addr) {
+    return reinterpret_cast<Shape**>(addr + kShapeOffset);
+  }
+  static inline Shape* GetShape(char* addr) { return *ShapeSlot(addr); }
+
   static char** LookupProperty(Heap* heap, char* addr, char* key, int insert);
 
   static const int kMaskOffset = HINTERIOR_OFFSET(1);
   static const int kMapOffset = HINTERIOR_OFFSET(2);
+  static const int kShapeOffset = HINTERIOR_OFFSET(3);
+
+  // Size of map in new objects (two values per unit)
+  static const uint32_t kInitialSize = 1;
 
   static const Heap::HeapTag class_tag = Heap::kTagObject;
 };
@@ -507,29 +1168,104 @@ class HObject : public HValue {
 
 class HArray : public HObject {
  public:
+  // Dense arrays keep elements one after another in the whole map (index is
+  // an offset), sparse ones are hashing numeric keys like objects do.
+  // Dense elements have a kind: small integers, raw doubles in a map that
+  // GC doesn't visit, or any values (kDense). Kinds are only generalized.
+  enum Representation {
+    kDense,
+    kSparse,
+    kSmiElements,
+    kDoubleElements
+  };
+
   static char* NewEmpty(Heap* heap);
 
   static int64_t Length(char* obj, bool shrink);
   static inline void SetLength(char* obj, int64_t length);
 
   static inline bool IsDense(char* obj);
+  static inline Representation Kind(char* obj);
+
+  // Number of elements that fit into dense array's map
+  static inline uint32_t Capacity(char* obj);
 
   static const int kVarArgLength = 16;
-  static const int kDenseLengthMax = 128;
+  static const int kInitialCapacity = 16;
+
+  // Dense array becomes sparse when the element is inserted that far
+  // behind the end of its storage
+  static const int kMaxDenseGap = 1024;
   static const int kLengthOffset = HINTERIOR_OFFSET(3);
 
+  // Missing double element, a signaling NaN is never produced by arithmetic
+  static const uint64_t kHoleNaN = 0x7FF7FFFFFFFFFFFFULL;
+
   static const Heap::HeapTag class_tag = Heap::kTagArray;
 };
 
 
 class HMap : public HValue {
  public:
+  // Dictionary maps are followed by a counter of empty slots that may
+  // still be taken and by a control byte for every slot: either 7 bits of
+  // key's hash or an empty/deleted mark. Lookups are comparing a group of
+  // control bytes at once and are touching keys only on match. First
+  // kGroupSize bytes are mirrored after the end, so any group may be
+  // loaded without wrapping around. Doubles maps are holding raw elements of
+  // double arrays and have no pointers in them.
+  enum Representation {
+    kPlain,
+    kDictionary,
+    kDoubles
+  };
+
+  static const uint8_t kEmptySlot = 0x80;
+  static const uint8_t kDeletedSlot = 0xFE;
+  static const uint32_t kGroupSize = 16;
+
   static char* NewEmpty(Heap* heap, uint32_t size);
+  static char* NewDictionary(Heap* heap, uint32_t size);
+  static char* NewDoubles(Heap* heap, uint32_t size);
 
   inline bool IsEmptySlot(uint32_t index);
   inline HValue* GetSlot(uint32_t index);
   inline char** GetSlotAddress(uint32_t index);
 
+  inline bool IsDictionary() {
+    return GetRepresentation<Representation>(addr()) == kDictionary;
+  }
+  inline bool IsDoubles() {
+    return GetRepresentation<Representation>(addr()) == kDoubles;
+  }
+  inline uint8_t* control() {
+    return reinterpret_cast<uint8_t*>(space() + ControlOffset(size()));
+  }
+  inline void SetControl(uint32_t index, uint8_t value);
+  inline uint32_t growth_left();
+  inline void growth_left(uint32_t value);
+
+  // Slot probed first, and hash bits stored in control byte
+  static inline uint32_t HashIndex(uint32_t hash, uint32_t size) {
+    return (hash >> 3) & (size - 1);
+  }
+  static inline uint8_t HashFragment(uint32_t hash) {
+    return (hash >> 25) & 0x7f;
+  }
+
+  // Offsets of control bytes and their count, relative to space
+  static inline uint32_t ControlOffset(uint32_t size) {
+    return ((size << 1) + 1) * kPointerSize;
+  }
+  static inline uint32_t ControlSize(uint32_t size) {
+    return RoundUp(size + kGroupSize, kPointerSize);
+  }
+
+  // Keep at least 1/8 of slots empty, probing stops on them
+  static inline uint32_t MaxGrowth(uint32_t size) {
+    return size - (size >> 3) - 1;
+  }
+
   inline uint32_t size() {
     return *reinterpret_cast<uint32_t*>(addr() + kSizeOffset);
   }
@@ -539,6 +1275,31 @@ class HMap : public HValue {
   static const int kSpaceOffset = HINTERIOR_OFFSET(2);
 
   static const Heap::HeapTag class_tag = Heap::kTagMap;
+
+ protected:
+  static char* New(Heap* heap, uint32_t size, Representation representation);
+};
+
+
+class HFree : public HValue {
+ public:
+  static char* New(char* addr, uint32_t size);
+
+  // Size of chunk including tag
+  static inline uint32_t Size(char* addr) {
+    return *reinterpret_cast<uint32_t*>(addr + kSizeOffset);
+  }
+
+  static inline char** NextSlot(char* addr) {
+    return reinterpret_cast<char**>(addr + kNextOffset);
+  }
+  static inline char* Next(char* addr) { return *NextSlot(addr); }
+
+  // Size is stored in unused bytes of tag, so chunk may be a tag only
+  static const int kSizeOffset = HINTERIOR_OFFSET(0) + 3;
+  static const int kNextOffset = HINTERIOR_OFFSET(1);
+
+  static const Heap::HeapTag class_tag = Heap::kTagFree;
 };
 
 
@@ -0,0 +1,1239 @@
+#include "hir.h"
+#include "ast.h" // AstNode, AstValue, FunctionLiteral
+#include "heap.h" // HObject
+#include "heap-inl.h"
+#include "zone.h" // Zone
+#include "utils.h" // List, PrintBuffer, StringToInt, PowerOfTwo
+
+#include <assert.h> // assert
+#include <stdint.h> // int64_t
+#include <string.h> // strncmp, memcmp
+
+namespace candor {
+namespace internal {
+
+static const char* kBinOpNames[] = {
+  "kAdd", "kSub", "kDiv", "kMul", "kMod", "kUShr", "kShl", "kShr", "kBAnd",
+  "kBOr", "kBXor", "kEq", "kStrictEq", "kNe", "kStrictNe", "kLt", "kGt",
+  "kLe", "kGe", "kLOr", "kLAnd"
+};
+
+// Unboxed integers are shifted left by one bit, results of folding should
+// fit into that
+static const int64_t kMaxInteger = (static_cast<int64_t>(1) << 62) - 1;
+static const int64_t kMinInteger = -(static_cast<int64_t>(1) << 62);
+
+
+static void RemoveOne(HIRInstructionList* list, HIRInstruction* instr) {
+  HIRInstructionList::Item* item = list->head();
+  while (item != NULL) {
+    if (item->value() == instr) {
+      list->Remove(item);
+      return;
+    }
+    item = item->next();
+  }
+}
+
+
+HIRInstruction::HIRInstruction(Type type, AstNode* ast) : type_(type),
+                                                          id_(-1),
+                                                          block_(NULL),
+                                                          ast_(ast),
+                                                          value_(0),
+                                                          depth_(0),
+                                                          binop_(BinOp::kNone),
+                                                          interval_(NULL),
+                                                          live_(false) {
+}
+
+
+void HIRInstruction::AddArg(HIRInstruction* arg) {
+  args_.Push(arg);
+  arg->uses()->Push(this);
+}
+
+
+void HIRInstruction::RemoveArgs() {
+  HIRInstruction* arg;
+  while ((arg = args_.Shift()) != NULL) {
+    RemoveOne(arg->uses(), this);
+  }
+}
+
+
+void HIRInstruction::ReplaceWith(HIRInstruction* other) {
+  HIRInstruction* use;
+  while ((use = uses_.Shift()) != NULL) {
+    HIRInstructionList::Item* item = use->args()->head();
+    for (; item != NULL; item = item->next()) {
+      if (item->value() != this) continue;
+
+      // Every occurrence of argument has its own entry in the uses list
+      item->value(other);
+      other->uses()->Push(use);
+      break;
+    }
+  }
+}
+
+
+void HIRInstruction::MakeConstant(Type type, int64_t value) {
+  RemoveArgs();
+  type_ = type;
+  value_ = value;
+}
+
+
+bool HIRInstruction::IsEqual(HIRInstruction* other) {
+  if (type_ != other->type_ ||
+      value_ != other->value_ ||
+      depth_ != other->depth_ ||
+      binop_ != other->binop_ ||
+      args_.length() != other->args_.length()) {
+    return false;
+  }
+
+  // Literals are compared by their text
+  if (type_ == kDouble || type_ == kString) {
+    if (ast_->length() != other->ast_->length() ||
+        memcmp(ast_->value(), other->ast_->value(), ast_->length()) != 0) {
+      return false;
+    }
+  }
+
+  HIRInstructionList::Item* a = args_.head();
+  HIRInstructionList::Item* b = other->args_.head();
+  for (; a != NULL; a = a->next(), b = b->next()) {
+    if (a->value() != b->value()) return false;
+  }
+
+  return true;
+}
+
+
+bool HIRInstruction::Print(PrintBuffer* p) {
+  const char* name;
+  switch (type_) {
+#define HIR_INSTRUCTION_NAME(V) case k##V: name = #V; break;
+    HIR_INSTRUCTION_TYPES(HIR_INSTRUCTION_NAME)
+#undef HIR_INSTRUCTION_NAME
+   default:
+    name = "None";
+    break;
+  }
+
+  // Stores and control instructions have no value
+  if (!IsControl() && !IsStore() && !p->Print("i%d = ", id_)) {
+    return false;
+  }
+  if (!p->Print("%s", name)) return false;
+
+  // Payload
+  bool res = true;
+  switch (type_) {
+   case kParameter:
+   case kInteger:
+   case kLoadStack:
+   case kStoreStack:
+   case kNewObject:
+   case kNewArray:
+    res = p->Print("[%lld]", static_cast<long long>(value_));
+    break;
+   case kDouble:
+    res = p->Print("[") &&
+          p->PrintValue(ast_->value(), ast_->length()) &&
+          p->Print("]");
+    break;
+   case kString:
+    res = p->Print("['") &&
+          p->PrintValue(ast_->value(), ast_->length()) &&
+          p->Print("']");
+    break;
+   case kLoadContext:
+   case kStoreContext:
+    res = p->Print("[%d:%lld]", depth_, static_cast<long long>(value_));
+    break;
+   case kBinOp:
+    res = p->Print("[%s]", kBinOpNames[binop_]);
+    break;
+   default:
+    break;
+  }
+  if (!res) return false;
+
+  // Arguments and successors
+  if (args_.length() == 0 && !is(kGoto) && !is(kBranch)) return true;
+  if (!p->Print("(")) return false;
+
+  HIRInstructionList::Item* item = args_.head();
+  for (; item != NULL; item = item->next()) {
+    if (!p->Print("i%d", item->value()->id())) return false;
+    if (item->next() != NULL && !p->Print(", ")) return false;
+  }
+
+  if (is(kGoto) || is(kBranch)) {
+    for (int i = 0; i < block_->succ_count(); i++) {
+      if ((i != 0 || args_.length() != 0) && !p->Print(", ")) return false;
+      if (!p->Print("B%d", block_->succ(i)->id())) return false;
+    }
+  }
+
+  return p->Print(")");
+}
+
+
+HIRBlock::HIRBlock(HIRGen* g) : g_(g),
+                                id_(-1),
+                                succ_count_(0),
+                                ended_(false),
+                                env_(NULL),
+                                loop_end_(NULL),
+                                dominator_(NULL),
+                                start_(-1),
+                                end_(-1),
+                                live_in_(NULL) {
+  succ_[0] = NULL;
+  succ_[1] = NULL;
+}
+
+
+void HIRBlock::Add(HIRInstruction* instr) {
+  assert(!ended_);
+  instructions_.Push(instr);
+  instr->block(this);
+}
+
+
+void HIRBlock::AddPhi(HIRInstruction* phi) {
+  phis_.Push(phi);
+  phi->block(this);
+}
+
+
+void HIRBlock::Remove(HIRInstruction* instr) {
+  HIRInstructionList* list = instr->is(HIRInstruction::kPhi) ?
+      &phis_ : &instructions_;
+  RemoveOne(list, instr);
+}
+
+
+void HIRBlock::AddPredecessor(HIRBlock* block) {
+  preds_.Push(block);
+}
+
+
+void HIRBlock::Goto(HIRBlock* target, AstNode* ast) {
+  Add(new HIRInstruction(HIRInstruction::kGoto, ast));
+  succ_[0] = target;
+  succ_count_ = 1;
+  ended_ = true;
+
+  target->AddPredecessor(this);
+}
+
+
+void HIRBlock::Branch(HIRInstruction* cond,
+                      HIRBlock* t,
+                      HIRBlock* f,
+                      AstNode* ast) {
+  HIRInstruction* branch = new HIRInstruction(HIRInstruction::kBranch, ast);
+  branch->AddArg(cond);
+  Add(branch);
+  succ_[0] = t;
+  succ_[1] = f;
+  succ_count_ = 2;
+  ended_ = true;
+
+  t->AddPredecessor(this);
+  f->AddPredecessor(this);
+}
+
+
+void HIRBlock::Return(HIRInstruction* value, AstNode* ast) {
+  HIRInstruction* ret = new HIRInstruction(HIRInstruction::kReturn, ast);
+  ret->AddArg(value);
+  Add(ret);
+  ended_ = true;
+}
+
+
+void HIRBlock::Exit() {
+  Add(new HIRInstruction(HIRInstruction::kExit, NULL));
+  ended_ = true;
+}
+
+
+int HIRBlock::PredecessorIndex(HIRBlock* block) {
+  int index = 0;
+  HIRBlockList::Item* item = preds_.head();
+  for (; item != NULL; item = item->next(), index++) {
+    if (item->value() == block) return index;
+  }
+
+  UNEXPECTED
+  return -1;
+}
+
+
+bool HIRBlock::Dominates(HIRBlock* block) {
+  while (block != NULL) {
+    if (block == this) return true;
+    block = block->dominator();
+  }
+  return false;
+}
+
+
+bool HIRBlock::Print(PrintBuffer* p) {
+  if (!p->Print("[B%d:", id_)) return false;
+
+  HIRInstructionList::Item* item = phis_.head();
+  for (; item != NULL; item = item->next()) {
+    if (!p->Print(" ") || !item->value()->Print(p) || !p->Print(";")) {
+      return false;
+    }
+  }
+
+  item = instructions_.head();
+  for (; item != NULL; item = item->next()) {
+    if (!p->Print(" ") || !item->value()->Print(p)) return false;
+    if (item->next() != NULL && !p->Print(";")) return false;
+  }
+
+  return p->Print("]");
+}
+
+
+HIRGen::HIRGen(FunctionLiteral* fn, AstNode* loop)
+    : Visitor(kPreorder),
+      fn_(fn),
+      osr_loop_(loop),
+      current_(NULL),
+      value_(NULL),
+      loop_(NULL),
+      slots_(fn->stack_slots()),
+      instruction_count_(0),
+      bailout_(false) {
+}
+
+
+bool HIRGen::Build() {
+  // Closures and `global` assignments are living in contexts, functions
+  // with own context are left for fullgen (but loop is entered when
+  // context is already allocated)
+  if (!is_osr() && fn()->context_slots() != 0) return false;
+
+  HIRBlock* entry = new HIRBlock(this);
+  entry->env(CopyEnv(NULL));
+  Enter(entry);
+
+  if (is_osr()) {
+    BuildLoop();
+  } else {
+    // Arguments are stack variables too
+    AstList::Item* arg = fn()->args()->head();
+    for (int64_t i = 0; arg != NULL; arg = arg->next(), i++) {
+      if (!arg->value()->is(AstNode::kValue)) return false;
+      AstValue* value = AstValue::Cast(arg->value());
+      if (!value->slot()->is_stack()) return false;
+
+      HIRInstruction* param = Add(HIRInstruction::kParameter, value);
+      param->value(i);
+      current_->env()[value->slot()->index()] = param;
+    }
+
+    VisitBlock(fn());
+
+    // Functions without `return` are returning nil
+    if (!bailout_ && current_ != NULL) {
+      current_->Return(Add(HIRInstruction::kNil, NULL), NULL);
+      current_ = NULL;
+    }
+  }
+
+  if (bailout_) return false;
+
+  RemoveTrivialPhis();
+  ComputeDominators();
+  FoldConstants();
+  NumberValues();
+  EliminateDeadCode();
+  Renumber();
+
+  return true;
+}
+
+
+void HIRGen::BuildLoop() {
+  // Variables are living in non-optimized function's frame
+  for (int32_t i = 0; i < slots_; i++) {
+    HIRInstruction* load = Add(HIRInstruction::kLoadStack, NULL);
+    load->value(i);
+    current_->env()[i] = load;
+  }
+
+  Visit(osr_loop());
+  if (bailout_ || current_ == NULL) return;
+
+  // Put variables back and continue after the loop in non-optimized code
+  // (stores of unchanged ones are removed as dead code)
+  for (int32_t i = 0; i < slots_; i++) {
+    HIRInstruction* store = Add(HIRInstruction::kStoreStack, NULL);
+    store->value(i);
+    store->AddArg(current_->env()[i]);
+  }
+
+  current_->Exit();
+  current_ = NULL;
+}
+
+
+void HIRGen::Print(char* buffer, uint32_t size) {
+  PrintBuffer p(buffer, size);
+
+  HIRBlockList::Item* item = blocks()->head();
+  for (; item != NULL; item = item->next()) {
+    if (!item->value()->Print(&p)) break;
+    if (item->next() != NULL && !p.Print(" ")) break;
+  }
+
+  p.Finalize();
+}
+
+
+HIRInstruction* HIRGen::Add(HIRInstruction::Type type, AstNode* ast) {
+  HIRInstruction* instr = new HIRInstruction(type, ast);
+  current_->Add(instr);
+  return instr;
+}
+
+
+HIRInstruction* HIRGen::VisitForValue(AstNode* node) {
+  value_ = NULL;
+  Visit(node);
+
+  // Statements and unsupported nodes have no value
+  if (value_ == NULL) {
+    Bailout();
+    value_ = Add(HIRInstruction::kNil, node);
+  }
+
+  return value_;
+}
+
+
+HIRInstruction* HIRGen::AddUnary(HIRInstruction::Type type, AstNode* node) {
+  HIRInstruction* arg = VisitForValue(node->lhs());
+  HIRInstruction* instr = Add(type, node);
+  instr->AddArg(arg);
+
+  return instr;
+}
+
+
+HIRInstruction* HIRGen::Assign(AstValue* value, HIRInstruction* instr) {
+  if (value->slot()->is_stack()) {
+    current_->env()[value->slot()->index()] = instr;
+    return instr;
+  }
+
+  // `global` can't be replaced, own context exists only in loops
+  int32_t depth = value->slot()->depth();
+  if (depth < 0 || (depth == 0 && !is_osr())) {
+    Bailout();
+    return instr;
+  }
+
+  HIRInstruction* store = Add(HIRInstruction::kStoreContext, value);
+  store->depth(depth);
+  store->value(value->slot()->index());
+  store->AddArg(instr);
+
+  return instr;
+}
+
+
+void HIRGen::AddStore(HIRInstruction* obj,
+                      HIRInstruction* key,
+                      HIRInstruction* value,
+                      AstNode* ast) {
+  HIRInstruction* store = Add(HIRInstruction::kStoreProperty, ast);
+  store->AddArg(obj);
+  store->AddArg(key);
+  store->AddArg(value);
+}
+
+
+HIRInstruction** HIRGen::CopyEnv(HIRInstruction** env) {
+  HIRInstruction** copy = reinterpret_cast<HIRInstruction**>(
+      Zone::current()->Allocate(sizeof(*copy) * (slots_ + 1)));
+
+  for (int32_t i = 0; i < slots_; i++) {
+    copy[i] = env == NULL ? NULL : env[i];
+  }
+
+  return copy;
+}
+
+
+void HIRGen::Enter(HIRBlock* block) {
+  block->id(blocks()->length());
+  blocks()->Push(block);
+  current_ = block;
+
+  HIRBlockList* preds = block->preds();
+  if (preds->length() == 0) {
+    // Entry block has environment already, nil is the value of
+    // every variable that wasn't assigned yet
+    HIRInstruction* nil = Add(HIRInstruction::kNil, NULL);
+    for (int32_t i = 0; i < slots_; i++) block->env()[i] = nil;
+    return;
+  }
+
+  block->env(CopyEnv(preds->head()->value()->env()));
+  if (preds->length() == 1) return;
+
+  // Join point: insert phis for variables with different values
+  for (int32_t i = 0; i < slots_; i++) {
+    HIRInstruction* value = block->env()[i];
+    bool same = true;
+
+    HIRBlockList::Item* item = preds->head()->next();
+    for (; item != NULL; item = item->next()) {
+      if (item->value()->env()[i] != value) {
+        same = false;
+        break;
+      }
+    }
+    if (same) continue;
+
+    HIRInstruction* phi = new HIRInstruction(HIRInstruction::kPhi, NULL);
+    block->AddPhi(phi);
+    for (item = preds->head(); item != NULL; item = item->next()) {
+      phi->AddArg(item->value()->env()[i]);
+    }
+    block->env()[i] = phi;
+  }
+}
+
+
+void HIRGen::EnterLoop(HIRBlock* header) {
+  assert(header->preds()->length() == 1);
+  header->id(blocks()->length());
+  blocks()->Push(header);
+  current_ = header;
+
+  // Values coming from back edges are unknown yet, so every variable gets
+  // a phi (trivial ones are removed after building the graph)
+  HIRInstruction** pre = header->preds()->head()->value()->env();
+  header->env(CopyEnv(NULL));
+  for (int32_t i = 0; i < slots_; i++) {
+    HIRInstruction* phi = new HIRInstruction(HIRInstruction::kPhi, NULL);
+    header->AddPhi(phi);
+    phi->AddArg(pre[i]);
+    header->env()[i] = phi;
+  }
+}
+
+
+void HIRGen::FinishLoop(HIRBlock* header) {
+  header->loop_end(blocks()->tail()->value());
+
+  HIRBlockList::Item* pred = header->preds()->head()->next();
+  for (; pred != NULL; pred = pred->next()) {
+    HIRInstructionList::Item* phi = header->phis()->head();
+    for (int32_t i = 0; phi != NULL; phi = phi->next(), i++) {
+      phi->value()->AddArg(pred->value()->env()[i]);
+    }
+  }
+}
+
+
+AstNode* HIRGen::Visit(AstNode* node) {
+  if (bailout_) return node;
+
+  switch (node->type()) {
+   case AstNode::kMValue:
+   case AstNode::kSelf:
+   case AstNode::kName:
+    Bailout();
+    return node;
+   default:
+    return Visitor::Visit(node);
+  }
+}
+
+
+AstNode* HIRGen::VisitFunction(AstNode* node) {
+  Bailout();
+  return node;
+}
+
+
+AstNode* HIRGen::VisitCall(AstNode* node) {
+  FunctionLiteral* fn = FunctionLiteral::Cast(node);
+
+  if (fn->variable() == NULL) {
+    Bailout();
+    return node;
+  }
+
+  // __$gc() and __$trace() are handled by fullgen
+  if (fn->variable()->is(AstNode::kValue)) {
+    AstNode* name = AstValue::Cast(fn->variable())->name();
+    if (name->length() > 3 && strncmp(name->value(), "__$", 3) == 0) {
+      Bailout();
+      return node;
+    }
+  }
+
+  HIRInstruction* callee = VisitForValue(fn->variable());
+
+  HIRInstruction* call = new HIRInstruction(HIRInstruction::kCall, node);
+  call->AddArg(callee);
+
+  AstList::Item* item = fn->args()->head();
+  for (; item != NULL; item = item->next()) {
+    if (item->value()->is(AstNode::kSelf) ||
+        item->value()->is(AstNode::kVarArg)) {
+      Bailout();
+      break;
+    }
+    call->AddArg(VisitForValue(item->value()));
+  }
+
+  current_->Add(call);
+  value_ = call;
+
+  return node;
+}
+
+
+AstNode* HIRGen::VisitBlock(AstNode* node) {
+  AstList::Item* item = node->children()->head();
+  for (; item != NULL; item = item->next()) {
+    // Code after `return`, `break` or `continue` is unreachable
+    if (current_ == NULL || bailout_) break;
+    Visit(item->value());
+  }
+
+  return node;
+}
+
+
+AstNode* HIRGen::VisitIf(AstNode* node) {
+  AstList::Item* fail = node->children()->head()->next()->next();
+
+  HIRBlock* t = new HIRBlock(this);
+  HIRBlock* f = new HIRBlock(this);
+  HIRBlock* join = new HIRBlock(this);
+
+  HIRInstruction* cond = VisitForValue(node->lhs());
+  current_->Branch(cond, t, f, node);
+
+  // Both branches have their blocks, so edges into join are never critical
+  Enter(t);
+  Visit(node->rhs());
+  if (current_ != NULL) current_->Goto(join, NULL);
+
+  Enter(f);
+  if (fail != NULL) Visit(fail->value());
+  if (current_ != NULL) current_->Goto(join, NULL);
+
+  if (join->preds()->length() == 0) {
+    current_ = NULL;
+  } else {
+    Enter(join);
+  }
+
+  return node;
+}
+
+
+AstNode* HIRGen::VisitWhile(AstNode* node) {
+  HIRBlock* header = new HIRBlock(this);
+  HIRBlock* body = new HIRBlock(this);
+  HIRBlock* exit = new HIRBlock(this);
+  HIRBlock* exit_split = new HIRBlock(this);
+
+  current_->Goto(header, NULL);
+  EnterLoop(header);
+
+  {
+    LoopInfo loop(this, header, exit);
+
+    HIRInstruction* cond = VisitForValue(node->lhs());
+    current_->Branch(cond, body, exit_split, node);
+
+    Enter(body);
+    Visit(node->rhs());
+    if (current_ != NULL) current_->Goto(header, NULL);
+  }
+
+  FinishLoop(header);
+
+  // `break`s are joining with the loop's condition in exit block
+  Enter(exit_split);
+  current_->Goto(exit, NULL);
+  Enter(exit);
+
+  return node;
+}
+
+
+AstNode* HIRGen::VisitAssign(AstNode* node) {
+  // Right-hand side is evaluated first (as in fullgen)
+  HIRInstruction* value = VisitForValue(node->rhs());
+
+  if (node->lhs()->is(AstNode::kMember)) {
+    HIRInstruction* obj = VisitForValue(node->lhs()->lhs());
+    HIRInstruction* key = VisitForValue(node->lhs()->rhs());
+    AddStore(obj, key, value, node);
+
+    value_ = value;
+    return node;
+  }
+
+  if (!node->lhs()->is(AstNode::kValue)) {
+    Bailout();
+    return node;
+  }
+
+  value_ = Assign(AstValue::Cast(node->lhs()), value);
+
+  return node;
+}
+
+
+AstNode* HIRGen::VisitValue(AstNode* node) {
+  AstValue* value = AstValue::Cast(node);
+
+  if (value->slot()->is_stack()) {
+    value_ = current_->env()[value->slot()->index()];
+    return node;
+  }
+
+  // Only parent contexts and `global` could be referenced (and own
+  // context in loops)
+  int32_t depth = value->slot()->depth();
+  if (depth < -1 || (depth == 0 && !is_osr())) {
+    Bailout();
+    return node;
+  }
+
+  value_ = Add(HIRInstruction::kLoadContext, node);
+  value_->depth(depth);
+  value_->value(value->slot()->index());
+
+  return node;
+}
+
+
+AstNode* HIRGen::VisitNumber(AstNode* node) {
+  if (StringIsDouble(node->value(), node->length())) {
+    value_ = Add(HIRInstruction::kDouble, node);
+  } else {
+    value_ = Add(HIRInstruction::kInteger, node);
+    value_->value(StringToInt(node->value(), node->length()));
+  }
+
+  return node;
+}
+
+
+AstNode* HIRGen::VisitString(AstNode* node) {
+  value_ = Add(HIRInstruction::kString, node);
+  return node;
+}
+
+
+AstNode* HIRGen::VisitNil(AstNode* node) {
+  value_ = Add(HIRInstruction::kNil, node);
+  return node;
+}
+
+
+AstNode* HIRGen::VisitTrue(AstNode* node) {
+  value_ = Add(HIRInstruction::kTrue, node);
+  return node;
+}
+
+
+AstNode* HIRGen::VisitFalse(AstNode* node) {
+  value_ = Add(HIRInstruction::kFalse, node);
+  return node;
+}
+
+
+AstNode* HIRGen::VisitReturn(AstNode* node) {
+  HIRInstruction* value;
+  if (node->lhs() != NULL) {
+    value = VisitForValue(node->lhs());
+  } else {
+    value = Add(HIRInstruction::kNil, node);
+  }
+
+  current_->Return(value, node);
+  current_ = NULL;
+
+  return node;
+}
+
+
+AstNode* HIRGen::VisitBreak(AstNode* node) {
+  if (loop() == NULL) {
+    Bailout();
+    return node;
+  }
+
+  current_->Goto(loop()->exit(), node);
+  current_ = NULL;
+
+  return node;
+}
+
+
+AstNode* HIRGen::VisitContinue(AstNode* node) {
+  if (loop() == NULL) {
+    Bailout();
+    return node;
+  }
+
+  current_->Goto(loop()->header(), node);
+  current_ = NULL;
+
+  return node;
+}
+
+
+AstNode* HIRGen::VisitTypeof(AstNode* node) {
+  value_ = AddUnary(HIRInstruction::kTypeof, node);
+  return node;
+}
+
+
+AstNode* HIRGen::VisitSizeof(AstNode* node) {
+  value_ = AddUnary(HIRInstruction::kSizeof, node);
+  return node;
+}
+
+
+AstNode* HIRGen::VisitKeysof(AstNode* node) {
+  value_ = AddUnary(HIRInstruction::kKeysof, node);
+  return node;
+}
+
+
+AstNode* HIRGen::VisitClone(AstNode* node) {
+  value_ = AddUnary(HIRInstruction::kClone, node);
+  return node;
+}
+
+
+AstNode* HIRGen::VisitUnOp(AstNode* node) {
+  UnOp* op = UnOp::Cast(node);
+
+  if (op->is_changing()) {
+    // ++a => a = a + 1, a++ => $tmp = a; a = $tmp + 1; $tmp
+    if (!op->lhs()->is(AstNode::kValue)) {
+      Bailout();
+      return node;
+    }
+
+    HIRInstruction* old = VisitForValue(op->lhs());
+    HIRInstruction* one = Add(HIRInstruction::kInteger, node);
+    one->value(1);
+
+    HIRInstruction* result = Add(HIRInstruction::kBinOp, node);
+    result->binop(op->subtype() == UnOp::kPreInc ||
+                  op->subtype() == UnOp::kPostInc ?
+                      BinOp::kAdd : BinOp::kSub);
+    result->AddArg(old);
+    result->AddArg(one);
+    Assign(AstValue::Cast(op->lhs()), result);
+
+    value_ = op->subtype() == UnOp::kPreInc ||
+             op->subtype() == UnOp::kPreDec ? result : old;
+  } else if (op->subtype() == UnOp::kPlus || op->subtype() == UnOp::kMinus) {
+    // +a = 0 + a, -a = 0 - a
+    HIRInstruction* zero = Add(HIRInstruction::kInteger, node);
+    HIRInstruction* arg = VisitForValue(op->lhs());
+
+    value_ = Add(HIRInstruction::kBinOp, node);
+    value_->binop(op->subtype() == UnOp::kPlus ? BinOp::kAdd : BinOp::kSub);
+    value_->AddArg(zero);
+    value_->AddArg(arg);
+  } else if (op->subtype() == UnOp::kNot) {
+    value_ = AddUnary(HIRInstruction::kNot, node);
+  } else {
+    Bailout();
+  }
+
+  return node;
+}
+
+
+AstNode* HIRGen::VisitBinOp(AstNode* node) {
+  BinOp* op = BinOp::Cast(node);
+
+  HIRInstruction* lhs = VisitForValue(op->lhs());
+  HIRInstruction* rhs = VisitForValue(op->rhs());
+
+  value_ = Add(HIRInstruction::kBinOp, node);
+  value_->binop(op->subtype());
+  value_->AddArg(lhs);
+  value_->AddArg(rhs);
+
+  return node;
+}
+
+
+AstNode* HIRGen::VisitMember(AstNode* node) {
+  HIRInstruction* obj = VisitForValue(node->lhs());
+  HIRInstruction* key = VisitForValue(node->rhs());
+
+  value_ = Add(HIRInstruction::kLoadProperty, node);
+  value_->AddArg(obj);
+  value_->AddArg(key);
+
+  return node;
+}
+
+
+AstNode* HIRGen::VisitProperty(AstNode* node) {
+  // `a.b` is the same as `a["b"]`
+  value_ = Add(HIRInstruction::kString, node);
+  return node;
+}
+
+
+AstNode* HIRGen::VisitObjectLiteral(AstNode* node) {
+  ObjectLiteral* literal = ObjectLiteral::Cast(node);
+
+  // Map will contain only values (two per unit of size)
+  uint32_t size = (literal->keys()->length() + 1) >> 1;
+  if (size < HObject::kInitialSize) size = HObject::kInitialSize;
+
+  HIRInstruction* obj = Add(HIRInstruction::kNewObject, node);
+  obj->value(size);
+
+  AstList::Item* key = literal->keys()->head();
+  AstList::Item* value = literal->values()->head();
+  for (; key != NULL; key = key->next(), value = value->next()) {
+    HIRInstruction* v = VisitForValue(value->value());
+    AddStore(obj, VisitForValue(key->value()), v, node);
+  }
+
+  value_ = obj;
+  return node;
+}
+
+
+AstNode* HIRGen::VisitArrayLiteral(AstNode* node) {
+  // Elements are occupying the whole map (keys and values), ensure that
+  // it will be filled only by half at maximum
+  HIRInstruction* arr = Add(HIRInstruction::kNewArray, node);
+  arr->value(PowerOfTwo(node->children()->length()));
+
+  AstList::Item* item = node->children()->head();
+  for (int64_t i = 0; item != NULL; item = item->next(), i++) {
+    HIRInstruction* v = VisitForValue(item->value());
+    HIRInstruction* index = Add(HIRInstruction::kInteger, node);
+    index->value(i);
+    AddStore(arr, index, v, node);
+  }
+
+  value_ = arr;
+  return node;
+}
+
+
+AstNode* HIRGen::VisitDelete(AstNode* node) {
+  Bailout();
+  return node;
+}
+
+
+AstNode* HIRGen::VisitVarArg(AstNode* node) {
+  Bailout();
+  return node;
+}
+
+
+void HIRGen::RemoveTrivialPhis() {
+  // Phi that merges only one value (and itself) is that value
+  bool changed = true;
+  while (changed) {
+    changed = false;
+
+    HIRBlockList::Item* block = blocks()->head();
+    for (; block != NULL; block = block->next()) {
+      HIRInstructionList::Item* item = block->value()->phis()->head();
+      while (item != NULL) {
+        HIRInstruction* phi = item->value();
+        HIRInstruction* same = NULL;
+        bool trivial = true;
+
+        HIRInstructionList::Item* arg = phi->args()->head();
+        for (; arg != NULL; arg = arg->next()) {
+          if (arg->value() == phi || arg->value() == same) continue;
+          if (same != NULL) {
+            trivial = false;
+            break;
+          }
+          same = arg->value();
+        }
+
+        item = item->next();
+        if (!trivial || same == NULL) continue;
+
+        phi->ReplaceWith(same);
+        phi->RemoveArgs();
+        block->value()->Remove(phi);
+        changed = true;
+      }
+    }
+  }
+}
+
+
+void HIRGen::ComputeDominators() {
+  // Blocks are ordered so that dominators are going before dominated ones,
+  // iterate until fixed point (Cooper, Harvey, Kennedy)
+  HIRBlock* entry = blocks()->head()->value();
+  entry->dominator(entry);
+
+  bool changed = true;
+  while (changed) {
+    changed = false;
+
+    HIRBlockList::Item* block = blocks()->head()->next();
+    for (; block != NULL; block = block->next()) {
+      HIRBlock* idom = NULL;
+
+      HIRBlockList::Item* pred = block->value()->preds()->head();
+      for (; pred != NULL; pred = pred->next()) {
+        HIRBlock* p = pred->value();
+        if (p->dominator() == NULL) continue;
+        if (idom == NULL) {
+          idom = p;
+          continue;
+        }
+
+        // Intersect
+        while (p != idom) {
+          while (p->id() > idom->id()) p = p->dominator();
+          while (idom->id() > p->id()) idom = idom->dominator();
+        }
+      }
+
+      if (block->value()->dominator() != idom) {
+        block->value()->dominator(idom);
+        changed = true;
+      }
+    }
+  }
+
+  entry->dominator(NULL);
+}
+
+
+void HIRGen::FoldConstants() {
+  HIRBlockList::Item* block = blocks()->head();
+  for (; block != NULL; block = block->next()) {
+    HIRInstructionList::Item* item = block->value()->instructions()->head();
+    for (; item != NULL; item = item->next()) {
+      HIRInstruction* instr = item->value();
+
+      if (instr->is(HIRInstruction::kNot)) {
+        HIRInstruction* arg = instr->arg(0);
+        bool value;
+        if (arg->is(HIRInstruction::kNil) || arg->is(HIRInstruction::kFalse)) {
+          value = true;
+        } else if (arg->is(HIRInstruction::kTrue)) {
+          value = false;
+        } else if (arg->is(HIRInstruction::kInteger)) {
+          value = arg->value() == 0;
+        } else {
+          continue;
+        }
+
+        instr->MakeConstant(value ? HIRInstruction::kTrue :
+                                    HIRInstruction::kFalse,
+                            0);
+        continue;
+      }
+
+      if (!instr->is(HIRInstruction::kBinOp) ||
+          !instr->arg(0)->is(HIRInstruction::kInteger) ||
+          !instr->arg(1)->is(HIRInstruction::kInteger)) {
+        continue;
+      }
+
+      int64_t lhs = instr->arg(0)->value();
+      int64_t rhs = instr->arg(1)->value();
+      int64_t result;
+      bool logic = false;
+
+      switch (instr->binop()) {
+       case BinOp::kAdd:
+        if ((rhs > 0 && lhs > kMaxInteger - rhs) ||
+            (rhs < 0 && lhs < kMinInteger - rhs)) {
+          continue;
+        }
+        result = lhs + rhs;
+        break;
+       case BinOp::kSub:
+        if ((rhs < 0 && lhs > kMaxInteger + rhs) ||
+            (rhs > 0 && lhs < kMinInteger + rhs)) {
+          continue;
+        }
+        result = lhs - rhs;
+        break;
+       case BinOp::kMul:
+        if (lhs >= 0x7fffffff || lhs <= -0x7fffffff ||
+            rhs >= 0x7fffffff || rhs <= -0x7fffffff) {
+          continue;
+        }
+        result = lhs * rhs;
+        break;
+       case BinOp::kBAnd: result = lhs & rhs; break;
+       case BinOp::kBOr: result = lhs | rhs; break;
+       case BinOp::kBXor: result = lhs ^ rhs; break;
+       case BinOp::kEq:
+       case BinOp::kStrictEq: logic = true; result = lhs == rhs; break;
+       case BinOp::kNe:
+       case BinOp::kStrictNe: logic = true; result = lhs != rhs; break;
+       case BinOp::kLt: logic = true; result = lhs < rhs; break;
+       case BinOp::kGt: logic = true; result = lhs > rhs; break;
+       case BinOp::kLe: logic = true; result = lhs <= rhs; break;
+       case BinOp::kGe: logic = true; result = lhs >= rhs; break;
+       default:
+        continue;
+      }
+
+      if (logic) {
+        instr->MakeConstant(result ? HIRInstruction::kTrue :
+                                     HIRInstruction::kFalse,
+                            0);
+      } else {
+        instr->MakeConstant(HIRInstruction::kInteger, result);
+      }
+    }
+  }
+}
+
+
+void HIRGen::NumberValues() {
+  // Replace pure instructions by equal ones that dominate them
+  HIRInstructionList seen;
+
+  HIRBlockList::Item* block = blocks()->head();
+  for (; block != NULL; block = block->next()) {
+    HIRInstructionList::Item* item = block->value()->instructions()->head();
+    while (item != NULL) {
+      HIRInstruction* instr = item->value();
+      item = item->next();
+
+      if (!instr->IsPure()) continue;
+
+      HIRInstruction* match = NULL;
+      HIRInstructionList::Item* s = seen.head();
+      for (; s != NULL; s = s->next()) {
+        if (s->value()->IsEqual(instr) &&
+            s->value()->block()->Dominates(instr->block())) {
+          match = s->value();
+          break;
+        }
+      }
+
+      if (match == NULL) {
+        seen.Push(instr);
+        continue;
+      }
+
+      instr->ReplaceWith(match);
+      instr->RemoveArgs();
+      block->value()->Remove(instr);
+    }
+  }
+}
+
+
+void HIRGen::EliminateDeadCode() {
+  // Mark everything that is needed by control flow and side effects
+  HIRInstructionList work;
+
+  HIRBlockList::Item* block = blocks()->head();
+  for (; block != NULL; block = block->next()) {
+    HIRInstructionList::Item* item = block->value()->instructions()->head();
+    for (; item != NULL; item = item->next()) {
+      HIRInstruction* instr = item->value();
+      if (!instr->HasSideEffects()) continue;
+
+      // Variable that wasn't changed by OSR loop is in its slot already
+      if (instr->is(HIRInstruction::kStoreStack) &&
+          instr->arg(0)->is(HIRInstruction::kLoadStack) &&
+          instr->arg(0)->value() == instr->value()) {
+        continue;
+      }
+
+      instr->is_live(true);
+      work.Push(instr);
+    }
+  }
+
+  HIRInstruction* instr;
+  while ((instr = work.Shift()) != NULL) {
+    HIRInstructionList::Item* arg = instr->args()->head();
+    for (; arg != NULL; arg = arg->next()) {
+      if (arg->value()->is_live()) continue;
+      arg->value()->is_live(true);
+      work.Push(arg->value());
+    }
+  }
+
+  // And sweep everything else
+  for (block = blocks()->head(); block != NULL; block = block->next()) {
+    HIRInstructionList* lists[] = {
+      block->value()->phis(),
+      block->value()->instructions()
+    };
+
+    for (int i = 0; i < 2; i++) {
+      HIRInstructionList::Item* item = lists[i]->head();
+      while (item != NULL) {
+        HIRInstructionList::Item* next = item->next();
+        if (!item->value()->is_live()) {
+          item->value()->RemoveArgs();
+          lists[i]->Remove(item);
+        }
+        item = next;
+      }
+    }
+  }
+}
+
+
+void HIRGen::Renumber() {
+  int id = 0;
+
+  HIRBlockList::Item* block = blocks()->head();
+  for (; block != NULL; block = block->next()) {
+    HIRInstructionList* lists[] = {
+      block->value()->phis(),
+      block->value()->instructions()
+    };
+
+    for (int i = 0; i < 2; i++) {
+      HIRInstructionList::Item* item = lists[i]->head();
+      for (; item != NULL; item = item->next()) item->value()->id(id++);
+    }
+  }
+
+  instruction_count_ = id;
+}
+
+} // namespace internal
+} // namespace candor
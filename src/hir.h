@@ -0,0 +1,375 @@
+#ifndef _SRC_HIR_H_
+#define _SRC_HIR_H_
+
+#include "ast.h" // AstNode, FunctionLiteral, BinOp
+#include "visitor.h" // Visitor
+#include "zone.h" // ZoneObject
+#include "utils.h" // List, PrintBuffer
+
+#include <stdint.h> // int32_t, int64_t, uint32_t
+
+namespace candor {
+namespace internal {
+
+// Forward declarations
+class HIRGen;
+class HIRBlock;
+class HIRInstruction;
+class LInterval;
+class BitField;
+
+typedef List<HIRBlock*, ZoneObject> HIRBlockList;
+typedef List<HIRInstruction*, ZoneObject> HIRInstructionList;
+
+#define HIR_INSTRUCTION_TYPES(V)\
+    V(Parameter)\
+    V(Nil)\
+    V(True)\
+    V(False)\
+    V(Integer)\
+    V(Double)\
+    V(String)\
+    V(LoadContext)\
+    V(StoreContext)\
+    V(LoadStack)\
+    V(StoreStack)\
+    V(BinOp)\
+    V(Not)\
+    V(Typeof)\
+    V(Sizeof)\
+    V(Keysof)\
+    V(Clone)\
+    V(NewObject)\
+    V(NewArray)\
+    V(LoadProperty)\
+    V(StoreProperty)\
+    V(Call)\
+    V(Phi)\
+    V(Goto)\
+    V(Branch)\
+    V(Return)\
+    V(Exit)
+
+// Instruction of optimizing compiler's graph. Every instruction is a value
+// (in SSA form) and keeps lists of its arguments and of instructions
+// using it.
+class HIRInstruction : public ZoneObject {
+ public:
+  enum Type {
+#define HIR_INSTRUCTION_ENUM(V) k##V,
+    HIR_INSTRUCTION_TYPES(HIR_INSTRUCTION_ENUM)
+#undef HIR_INSTRUCTION_ENUM
+    kNone
+  };
+
+  HIRInstruction(Type type, AstNode* ast);
+
+  void AddArg(HIRInstruction* arg);
+  void RemoveArgs();
+
+  // Make every user of instruction use `other` instead
+  void ReplaceWith(HIRInstruction* other);
+
+  // Turn instruction into a constant (arguments are released)
+  void MakeConstant(Type type, int64_t value);
+
+  // Literals can be loaded at any use instead of being kept in a register
+  inline bool IsConstant() {
+    return type_ == kNil || type_ == kTrue || type_ == kFalse ||
+           type_ == kInteger || type_ == kDouble || type_ == kString;
+  }
+
+  // Results of such instructions depend only on arguments' values
+  inline bool IsPure() {
+    return IsConstant() || type_ == kBinOp || type_ == kNot ||
+           type_ == kTypeof;
+  }
+
+  // Instruction can't be removed even if its value isn't used
+  inline bool HasSideEffects() {
+    return type_ == kCall || type_ == kKeysof || type_ == kClone ||
+           IsStore() || IsControl();
+  }
+
+  // Stores have no value
+  inline bool IsStore() {
+    return type_ == kStoreProperty || type_ == kStoreContext ||
+           type_ == kStoreStack;
+  }
+
+  // Instruction may call a stub or function, that may run GC
+  inline bool IsCall() {
+    return type_ == kBinOp || type_ == kNot || type_ == kTypeof ||
+           type_ == kSizeof || type_ == kKeysof || type_ == kClone ||
+           type_ == kNewObject || type_ == kNewArray ||
+           type_ == kLoadProperty || type_ == kStoreProperty ||
+           type_ == kCall || type_ == kBranch;
+  }
+
+  inline bool IsControl() {
+    return type_ == kGoto || type_ == kBranch || type_ == kReturn ||
+           type_ == kExit;
+  }
+
+  // Same operation on the same arguments (used by value numbering)
+  bool IsEqual(HIRInstruction* other);
+
+  bool Print(PrintBuffer* p);
+
+  inline Type type() { return type_; }
+  inline bool is(Type type) { return type_ == type; }
+
+  inline int id() { return id_; }
+  inline void id(int id) { id_ = id; }
+
+  inline HIRBlock* block() { return block_; }
+  inline void block(HIRBlock* block) { block_ = block; }
+
+  inline AstNode* ast() { return ast_; }
+
+  inline HIRInstructionList* args() { return &args_; }
+  inline HIRInstructionList* uses() { return &uses_; }
+  inline HIRInstruction* arg(int index) {
+    HIRInstructionList::Item* item = args_.head();
+    while (index-- > 0) item = item->next();
+    return item->value();
+  }
+
+  // Parameter's index, integer's value, context or stack slot's index,
+  // size of object literal's map (cell of heap constant after code
+  // generation)
+  inline int64_t value() { return value_; }
+  inline void value(int64_t value) { value_ = value; }
+
+  // Depth of context slot (-1 for `global`)
+  inline int32_t depth() { return depth_; }
+  inline void depth(int32_t depth) { depth_ = depth; }
+
+  inline BinOp::BinOpType binop() { return binop_; }
+  inline void binop(BinOp::BinOpType binop) { binop_ = binop; }
+
+  inline LInterval* interval() { return interval_; }
+  inline void interval(LInterval* interval) { interval_ = interval; }
+
+  inline bool is_live() { return live_; }
+  inline void is_live(bool live) { live_ = live; }
+
+ protected:
+  Type type_;
+  int id_;
+  HIRBlock* block_;
+  AstNode* ast_;
+
+  HIRInstructionList args_;
+  HIRInstructionList uses_;
+
+  int64_t value_;
+  int32_t depth_;
+  BinOp::BinOpType binop_;
+
+  LInterval* interval_;
+  bool live_;
+};
+
+// Basic block: phis, instructions and one control instruction at the end
+class HIRBlock : public ZoneObject {
+ public:
+  HIRBlock(HIRGen* g);
+
+  void Add(HIRInstruction* instr);
+  void AddPhi(HIRInstruction* phi);
+  void Remove(HIRInstruction* instr);
+  void AddPredecessor(HIRBlock* block);
+
+  // Control instructions are ending the block
+  void Goto(HIRBlock* target, AstNode* ast);
+  void Branch(HIRInstruction* cond,
+              HIRBlock* t,
+              HIRBlock* f,
+              AstNode* ast);
+  void Return(HIRInstruction* value, AstNode* ast);
+  void Exit();
+
+  // Index of predecessor (phi's inputs are going in the same order)
+  int PredecessorIndex(HIRBlock* block);
+
+  bool Dominates(HIRBlock* block);
+
+  bool Print(PrintBuffer* p);
+
+  inline int id() { return id_; }
+  inline void id(int id) { id_ = id; }
+
+  inline HIRInstructionList* instructions() { return &instructions_; }
+  inline HIRInstructionList* phis() { return &phis_; }
+  inline HIRBlockList* preds() { return &preds_; }
+  inline HIRBlock* succ(int index) { return succ_[index]; }
+  inline int succ_count() { return succ_count_; }
+  inline bool is_ended() { return ended_; }
+
+  // Values of stack variables (used while building the graph)
+  inline HIRInstruction** env() { return env_; }
+  inline void env(HIRInstruction** env) { env_ = env; }
+
+  // Loop header knows last block of loop's body
+  inline bool is_loop() { return loop_end_ != NULL; }
+  inline HIRBlock* loop_end() { return loop_end_; }
+  inline void loop_end(HIRBlock* end) { loop_end_ = end; }
+
+  inline HIRBlock* dominator() { return dominator_; }
+  inline void dominator(HIRBlock* dominator) { dominator_ = dominator; }
+
+  // LIR: positions of first and last instructions, live-in values
+  inline int start() { return start_; }
+  inline void start(int start) { start_ = start; }
+  inline int end() { return end_; }
+  inline void end(int end) { end_ = end; }
+  inline BitField* live_in() { return live_in_; }
+  inline void live_in(BitField* live_in) { live_in_ = live_in; }
+
+ protected:
+  HIRGen* g_;
+  int id_;
+
+  HIRInstructionList instructions_;
+  HIRInstructionList phis_;
+  HIRBlockList preds_;
+  HIRBlock* succ_[2];
+  int succ_count_;
+  bool ended_;
+
+  HIRInstruction** env_;
+  HIRBlock* loop_end_;
+  HIRBlock* dominator_;
+
+  int start_;
+  int end_;
+  BitField* live_in_;
+};
+
+// Builds SSA graph of function's body. Only functions that keep all their
+// variables on stack (i.e. without closures and varargs) are supported,
+// Build() returns false on anything else.
+//
+// When `loop` is given only that loop is compiled (for on-stack
+// replacement): variables are loaded from non-optimized function's frame
+// on entry and are stored back on exit, function's own context is
+// accessible too.
+class HIRGen : public Visitor {
+ public:
+  class LoopInfo {
+   public:
+    LoopInfo(HIRGen* g, HIRBlock* header, HIRBlock* exit) : g_(g),
+                                                           header_(header),
+                                                           exit_(exit) {
+      parent_ = g->loop();
+      g->loop(this);
+    }
+
+    ~LoopInfo() {
+      g_->loop(parent_);
+    }
+
+    inline HIRBlock* header() { return header_; }
+    inline HIRBlock* exit() { return exit_; }
+
+   private:
+    HIRGen* g_;
+    HIRBlock* header_;
+    HIRBlock* exit_;
+    LoopInfo* parent_;
+  };
+
+  HIRGen(FunctionLiteral* fn, AstNode* loop);
+
+  bool Build();
+
+  // Print graph into buffer (debug purposes only)
+  void Print(char* buffer, uint32_t size);
+
+  AstNode* Visit(AstNode* node);
+
+  AstNode* VisitFunction(AstNode* node);
+  AstNode* VisitCall(AstNode* node);
+  AstNode* VisitBlock(AstNode* node);
+  AstNode* VisitIf(AstNode* node);
+  AstNode* VisitWhile(AstNode* node);
+  AstNode* VisitAssign(AstNode* node);
+  AstNode* VisitValue(AstNode* node);
+  AstNode* VisitNumber(AstNode* node);
+  AstNode* VisitString(AstNode* node);
+  AstNode* VisitNil(AstNode* node);
+  AstNode* VisitTrue(AstNode* node);
+  AstNode* VisitFalse(AstNode* node);
+  AstNode* VisitReturn(AstNode* node);
+  AstNode* VisitBreak(AstNode* node);
+  AstNode* VisitContinue(AstNode* node);
+  AstNode* VisitTypeof(AstNode* node);
+  AstNode* VisitSizeof(AstNode* node);
+  AstNode* VisitKeysof(AstNode* node);
+  AstNode* VisitClone(AstNode* node);
+  AstNode* VisitUnOp(AstNode* node);
+  AstNode* VisitBinOp(AstNode* node);
+  AstNode* VisitMember(AstNode* node);
+  AstNode* VisitProperty(AstNode* node);
+  AstNode* VisitObjectLiteral(AstNode* node);
+  AstNode* VisitArrayLiteral(AstNode* node);
+
+  // Everything else makes function unsupported
+  AstNode* VisitDelete(AstNode* node);
+  AstNode* VisitVarArg(AstNode* node);
+
+  inline void Bailout() { bailout_ = true; }
+
+  inline FunctionLiteral* fn() { return fn_; }
+  inline AstNode* osr_loop() { return osr_loop_; }
+  inline bool is_osr() { return osr_loop_ != NULL; }
+  inline HIRBlockList* blocks() { return &blocks_; }
+  inline int32_t slots() { return slots_; }
+  inline int instruction_count() { return instruction_count_; }
+  inline LoopInfo* loop() { return loop_; }
+  inline void loop(LoopInfo* loop) { loop_ = loop; }
+
+ protected:
+  // Graph of OSR loop: load variables, visit loop, store them back
+  void BuildLoop();
+
+  HIRInstruction* VisitForValue(AstNode* node);
+  HIRInstruction* Add(HIRInstruction::Type type, AstNode* ast);
+  HIRInstruction* AddUnary(HIRInstruction::Type type, AstNode* node);
+  HIRInstruction* Assign(AstValue* value, HIRInstruction* instr);
+  void AddStore(HIRInstruction* obj,
+                HIRInstruction* key,
+                HIRInstruction* value,
+                AstNode* ast);
+
+  // Enter new block, values of variables are merged from predecessors
+  void Enter(HIRBlock* block);
+  void EnterLoop(HIRBlock* header);
+  void FinishLoop(HIRBlock* header);
+  HIRInstruction** CopyEnv(HIRInstruction** env);
+
+  // Optimization passes
+  void RemoveTrivialPhis();
+  void ComputeDominators();
+  void FoldConstants();
+  void NumberValues();
+  void EliminateDeadCode();
+  void Renumber();
+
+  FunctionLiteral* fn_;
+  AstNode* osr_loop_;
+  HIRBlockList blocks_;
+  HIRBlock* current_;
+  HIRInstruction* value_;
+  LoopInfo* loop_;
+
+  int32_t slots_;
+  int instruction_count_;
+  bool bailout_;
+};
+
+} // namespace internal
+} // namespace candor
+
+#endif // _SRC_HIR_H_
@@ -58,8 +58,8 @@ void Fullgen::InitRoots() {
   root_context()->Push(HObject::NewEmpty(heap()));
 
   // Place some root values
-  root_context()->Push(HBoolean::New(heap(), Heap::kTenureOld, true));
-  root_context()->Push(HBoolean::New(heap(), Heap::kTenureOld, false));
+  root_context()->Push(HBoolean::New(heap(), true));
+  root_context()->Push(HBoolean::New(heap(), false));
 
   // Place types
   root_context()->Push(HString::New(heap(), Heap::kTenureOld, "nil", 3));
@@ -656,7 +656,9 @@ AstNode* Fullgen::VisitString(AstNode* node) {
   uint32_t length;
   const char* unescaped = Unescape(node->value(), node->length(), &length);
 
-  PlaceInRoot(HString::New(heap(), Heap::kTenureOld, unescaped, length));
+  // Literals are deduplicated, property names among them are compared
+  // by pointers
+  PlaceInRoot(heap()->strings()->Intern(heap(), unescaped, length));
 
   delete unescaped;
 
@@ -774,9 +776,10 @@ AstNode* Fullgen::VisitObjectLiteral(AstNode* node) {
 
   ObjectLiteral* obj = ObjectLiteral::Cast(node);
 
-  // Ensure that map will be filled only by half at maximum
+  // Elements are occupying the whole map (keys and values), ensure that
+  // it will be filled only by half at maximum
   movl(eax,
-       Immediate(HNumber::Tag(PowerOfTwo(node->children()->length() << 1))));
+       Immediate(HNumber::Tag(PowerOfTwo(node->children()->length()))));
   AllocateObjectLiteral(Heap::kTagObject, eax, edx);
 
   Spill edx_s(this, edx);
@@ -812,9 +815,10 @@ AstNode* Fullgen::VisitArrayLiteral(AstNode* node) {
     return node;
   }
 
-  // Ensure that map will be filled only by half at maximum
+  // Elements are occupying the whole map (keys and values), ensure that
+  // it will be filled only by half at maximum
   movl(eax,
-       Immediate(HNumber::Tag(PowerOfTwo(node->children()->length() << 1))));
+       Immediate(HNumber::Tag(PowerOfTwo(node->children()->length()))));
   AllocateObjectLiteral(Heap::kTagArray, eax, edx);
 
   Spill edx_s(this, edx);
@@ -248,7 +248,9 @@ void Masm::AllocateObjectLiteral(Heap::HeapTag tag,
   movl(scratch, size);
 
   // mask (= (size - 1) << 2)
+  // dense array's elements are occupying both keys and values
   Untag(scratch);
+  if (tag == Heap::kTagArray) shl(scratch, Immediate(1));
   dec(scratch);
   shl(scratch, Immediate(2));
   movl(qmask, scratch);
@@ -443,8 +445,8 @@ void Masm::StringHash(Register str, Register result) {
 
   // Check if string is a cons string
   movzxb(eax, repr_field);
-  cmpl(eax, Immediate(HString::kNormal));
-  jmp(kNe, &call_runtime);
+  cmpl(eax, Immediate(HString::kCons));
+  jmp(kEq, &call_runtime);
 
   // Compute new hash
   assert(!str.is(ecx));
@@ -586,10 +588,10 @@ void Masm::IsTrue(Register reference, Label* is_false, Label* is_true) {
 
 
 void Masm::IsDenseArray(Register reference, Label* non_dense, Label* dense) {
-  Operand qlength(reference, HArray::kLengthOffset);
-  cmpl(qlength, Immediate(HArray::kDenseLengthMax));
-  if (non_dense != NULL) jmp(kGt, non_dense);
-  if (dense != NULL) jmp(kLe, dense);
+  Operand repr(reference, HValue::kRepresentationOffset);
+  cmpb(repr, Immediate(HArray::kDense));
+  if (non_dense != NULL) jmp(kNe, non_dense);
+  if (dense != NULL) jmp(kEq, dense);
 }
 
 
@@ -0,0 +1,108 @@
+#include "ic.h"
+#include "utils.h" // GetSourceLineByOffset
+
+#include <stdint.h> // uint32_t
+#include <stdlib.h> // NULL, realloc, free, abort
+#include <stdio.h> // fprintf
+
+namespace candor {
+namespace internal {
+
+InlineCache::InlineCache(Kind kind, uint32_t offset) : hits_(0),
+                                                       misses_(0),
+                                                       state_(kUninitialized),
+                                                       length_(0),
+                                                       kind_(kind),
+                                                       offset_(offset),
+                                                       filename_(NULL),
+                                                       line_(0) {
+  for (uint32_t i = 0; i < kMaxEntries; i++) {
+    entries_[i].key = NULL;
+    entries_[i].value = 0;
+  }
+}
+
+
+void InlineCache::Update(char* key, off_t value) {
+  if (key == NULL || state_ == kMegamorphic) return;
+
+  for (uint32_t i = 0; i < length_; i++) {
+    if (entries_[i].key == key) return;
+  }
+
+  // No place for another key - stop caching
+  if (length_ == kMaxEntries) {
+    for (uint32_t i = 0; i < kMaxEntries; i++) entries_[i].key = NULL;
+    length_ = 0;
+    state_ = kMegamorphic;
+    return;
+  }
+
+  entries_[length_].key = key;
+  entries_[length_].value = value;
+  length_++;
+
+  state_ = length_ == 1 ? kMonomorphic : kPolymorphic;
+}
+
+
+void InlineCache::SetSource(const char* filename, const char* source) {
+  int pos;
+
+  filename_ = filename;
+  if (offset_ == kNoOffset) return;
+  line_ = GetSourceLineByOffset(source, offset_, &pos);
+}
+
+
+void InlineCache::Print(FILE* out) {
+  static const char* kinds[] = { "property", "call" };
+  static const char* states[] = {
+    "uninitialized", "monomorphic", "polymorphic", "megamorphic"
+  };
+
+  fprintf(out,
+          "%s:%d %s %s hits=%llu misses=%llu\n",
+          filename_ == NULL ? "???" : filename_,
+          line_,
+          kinds[kind_],
+          states[state_],
+          static_cast<unsigned long long>(hits_),
+          static_cast<unsigned long long>(misses_));
+}
+
+
+ICTable::~ICTable() {
+  for (uint32_t i = 0; i < length_; i++) delete caches_[i];
+  free(caches_);
+}
+
+
+InlineCache* ICTable::New(InlineCache::Kind kind, uint32_t offset) {
+  if (length_ == size_) {
+    size_ = size_ == 0 ? 64 : size_ << 1;
+    caches_ = reinterpret_cast<InlineCache**>(
+        realloc(caches_, size_ * sizeof(*caches_)));
+    if (caches_ == NULL) abort();
+  }
+
+  InlineCache* ic = new InlineCache(kind, offset);
+  caches_[length_++] = ic;
+
+  return ic;
+}
+
+
+void ICTable::Commit(const char* filename, const char* source) {
+  for (; committed_ < length_; committed_++) {
+    caches_[committed_]->SetSource(filename, source);
+  }
+}
+
+
+void ICTable::Print(FILE* out) {
+  for (uint32_t i = 0; i < length_; i++) caches_[i]->Print(out);
+}
+
+} // namespace internal
+} // namespace candor
@@ -0,0 +1,103 @@
+#ifndef _SRC_IC_H_
+#define _SRC_IC_H_
+
+#include <stdint.h> // uint32_t, uint64_t
+#include <stdio.h> // FILE
+#include <sys/types.h> // off_t
+
+namespace candor {
+namespace internal {
+
+// Inline cache of a site in generated code. It remembers the keys (i.e.
+// shapes of objects, or called functions) that were seen there together
+// with lookup results, generated code compares key with every entry and
+// uses cached value on match. Cache becomes megamorphic (and is skipped)
+// when there're too many different keys.
+class InlineCache {
+ public:
+  enum Kind {
+    kProperty,
+    kCall
+  };
+
+  enum State {
+    kUninitialized,
+    kMonomorphic,
+    kPolymorphic,
+    kMegamorphic
+  };
+
+  static const uint32_t kMaxEntries = 4;
+  static const uint32_t kNoOffset = static_cast<uint32_t>(-1);
+
+  struct Entry {
+    char* key;
+    off_t value;
+  };
+
+  // Generated code is probing entries and updating counters,
+  // keep these fields at the start
+  static const int kEntriesOffset = 0;
+  static const int kHitsOffset = kMaxEntries * sizeof(Entry);
+  static const int kMissesOffset = kHitsOffset + 8;
+  static const int kStateOffset = kMissesOffset + 8;
+
+  InlineCache(Kind kind, uint32_t offset);
+
+  // Remember lookup result for the key (NULL keys are never cached)
+  void Update(char* key, off_t value);
+
+  // Source position is known only after compilation
+  void SetSource(const char* filename, const char* source);
+
+  void Print(FILE* out);
+
+  inline Kind kind() { return kind_; }
+  inline State state() { return static_cast<State>(state_); }
+  inline Entry* entries() { return entries_; }
+  inline uint32_t length() { return length_; }
+  inline uint64_t hits() { return hits_; }
+  inline uint64_t misses() { return misses_; }
+
+ protected:
+  Entry entries_[kMaxEntries];
+  uint64_t hits_;
+  uint64_t misses_;
+  off_t state_;
+
+  uint32_t length_;
+  Kind kind_;
+
+  uint32_t offset_;
+  const char* filename_;
+  int line_;
+};
+
+class ICTable {
+ public:
+  ICTable() : caches_(NULL), length_(0), size_(0), committed_(0) {
+  }
+  ~ICTable();
+
+  InlineCache* New(InlineCache::Kind kind, uint32_t offset);
+
+  // Set source position of caches created since last commit
+  void Commit(const char* filename, const char* source);
+
+  // Print counters and states of all caches
+  void Print(FILE* out);
+
+  inline InlineCache* Get(uint32_t index) { return caches_[index]; }
+  inline uint32_t length() { return length_; }
+
+ protected:
+  InlineCache** caches_;
+  uint32_t length_;
+  uint32_t size_;
+  uint32_t committed_;
+};
+
+} // namespace internal
+} // namespace candor
+
+#endif // _SRC_IC_H_
@@ -0,0 +1,273 @@
+#include "lir.h"
+#include "hir.h" // HIRGen, HIRBlock, HIRInstruction
+#include "zone.h" // Zone
+#include "utils.h" // List
+
+#include <assert.h> // assert
+#include <stdint.h> // uint32_t
+#include <string.h> // memset
+
+namespace candor {
+namespace internal {
+
+BitField::BitField(int size) : size_(size) {
+  int words = (size + 31) >> 5;
+  bits_ = reinterpret_cast<uint32_t*>(
+      Zone::current()->Allocate(sizeof(*bits_) * (words + 1)));
+  memset(bits_, 0, sizeof(*bits_) * (words + 1));
+}
+
+
+void BitField::Merge(BitField* other) {
+  for (int i = 0; i < (size_ + 31) >> 5; i++) bits_[i] |= other->bits_[i];
+}
+
+
+void BitField::Copy(BitField* other) {
+  for (int i = 0; i < (size_ + 31) >> 5; i++) bits_[i] = other->bits_[i];
+}
+
+
+LGen::LGen(HIRGen* hir, CodeSpace* space, SourceMap* map)
+    : Masm(space),
+      hir_(hir),
+      stack_slots_(0),
+      source_map_(map),
+      labels_(NULL),
+      label_count_(0),
+      used_registers_(0) {
+}
+
+
+LGen::~LGen() {
+  for (int i = 0; i < label_count_; i++) delete labels_[i];
+  delete[] labels_;
+}
+
+
+void LGen::Generate() {
+  NumberInstructions();
+  ComputeLiveness();
+  AllocateRegisters();
+
+  GeneratePrologue();
+
+  HIRBlockList::Item* block = hir()->blocks()->head();
+  for (; block != NULL; block = block->next()) {
+    GenerateBlock(block->value());
+  }
+
+  FinalizeSpills();
+}
+
+
+void LGen::NumberInstructions() {
+  int pos = 0;
+
+  label_count_ = hir()->blocks()->length();
+  labels_ = new Label*[label_count_];
+
+  HIRBlockList::Item* block = hir()->blocks()->head();
+  for (; block != NULL; block = block->next()) {
+    HIRBlock* b = block->value();
+    labels_[b->id()] = new Label(this);
+
+    b->start(pos);
+
+    // All phis are defined at once, before the first instruction
+    HIRInstructionList::Item* item = b->phis()->head();
+    for (; item != NULL; item = item->next()) {
+      item->value()->id(pos);
+      if (item->value()->uses()->length() != 0) {
+        LInterval* interval = new LInterval(item->value(),
+                                            intervals()->length());
+        item->value()->interval(interval);
+        intervals()->Push(interval);
+      }
+    }
+
+    for (item = b->instructions()->head(); item != NULL; item = item->next()) {
+      HIRInstruction* instr = item->value();
+      pos += 2;
+      instr->id(pos);
+
+      // Constants are loaded at every use
+      if (instr->IsConstant() || instr->uses()->length() == 0) continue;
+
+      LInterval* interval = new LInterval(instr, intervals()->length());
+      instr->interval(interval);
+      intervals()->Push(interval);
+    }
+
+    b->end(pos);
+    pos += 2;
+  }
+}
+
+
+bool LGen::IsFused(HIRInstruction* instr) {
+  if (!instr->is(HIRInstruction::kBinOp) ||
+      !BinOp::is_logic(instr->binop()) ||
+      instr->uses()->length() != 1) {
+    return false;
+  }
+
+  // Nothing should be generated between them
+  HIRInstruction* use = instr->uses()->head()->value();
+  return use->is(HIRInstruction::kBranch) &&
+         use->block() == instr->block() &&
+         use->id() == instr->id() + 2;
+}
+
+
+void LGen::ComputeLiveness() {
+  int count = intervals()->length();
+  LInterval** map = reinterpret_cast<LInterval**>(
+      Zone::current()->Allocate(sizeof(*map) * (count + 1)));
+
+  LIntervalList::Item* iitem = intervals()->head();
+  for (; iitem != NULL; iitem = iitem->next()) {
+    map[iitem->value()->id()] = iitem->value();
+  }
+
+  // Blocks are visited in reverse order, loop headers are extending
+  // everything that lives through the loop to its end
+  HIRBlockList::Item* block = hir()->blocks()->tail();
+  for (; block != NULL; block = block->prev()) {
+    HIRBlock* b = block->value();
+    BitField* live = new BitField(count);
+
+    for (int i = 0; i < b->succ_count(); i++) {
+      HIRBlock* succ = b->succ(i);
+      if (succ->live_in() != NULL) live->Merge(succ->live_in());
+
+      // Phi's input is used at the end of predecessor
+      int index = succ->PredecessorIndex(b);
+      HIRInstructionList::Item* phi = succ->phis()->head();
+      for (; phi != NULL; phi = phi->next()) {
+        LInterval* input = phi->value()->arg(index)->interval();
+        if (input != NULL) live->Set(input->id());
+      }
+    }
+
+    for (int i = 0; i < count; i++) {
+      if (live->Test(i)) map[i]->Extend(b->end());
+    }
+
+    HIRInstructionList::Item* item = b->instructions()->tail();
+    for (; item != NULL; item = item->prev()) {
+      HIRInstruction* instr = item->value();
+
+      if (instr->interval() != NULL) {
+        instr->interval()->Extend(instr->id());
+        live->Clear(instr->interval()->id());
+      }
+
+      HIRInstructionList::Item* arg = instr->args()->head();
+      for (; arg != NULL; arg = arg->next()) {
+        LInterval* interval = arg->value()->interval();
+        if (interval == NULL) continue;
+
+        interval->Extend(instr->id());
+        live->Set(interval->id());
+      }
+    }
+
+    for (item = b->phis()->head(); item != NULL; item = item->next()) {
+      LInterval* interval = item->value()->interval();
+      if (interval == NULL) continue;
+
+      interval->Extend(b->start());
+      live->Clear(interval->id());
+    }
+
+    b->live_in(live);
+
+    if (b->is_loop()) {
+      for (int i = 0; i < count; i++) {
+        if (live->Test(i)) map[i]->Extend(b->loop_end()->end());
+      }
+    }
+  }
+}
+
+
+void LGen::AllocateRegisters() {
+  LIntervalList active;
+  LIntervalList active_slots;
+  LIntervalList free_slots;
+  bool* used = reinterpret_cast<bool*>(
+      Zone::current()->Allocate(sizeof(*used) * kRegisterCount));
+
+  for (int i = 0; i < kRegisterCount; i++) used[i] = false;
+
+  // Intervals are created in order of their definitions (i.e. starts)
+  LIntervalList::Item* item = intervals()->head();
+  for (; item != NULL; item = item->next()) {
+    LInterval* current = item->value();
+
+    // Expire intervals that have ended before current
+    LIntervalList::Item* a = active.head();
+    while (a != NULL) {
+      LIntervalList::Item* next = a->next();
+      if (a->value()->end() <= current->start()) {
+        used[a->value()->index()] = false;
+        active.Remove(a);
+      }
+      a = next;
+    }
+
+    a = active_slots.head();
+    while (a != NULL) {
+      LIntervalList::Item* next = a->next();
+      if (a->value()->end() <= current->start()) {
+        free_slots.Push(a->value());
+        active_slots.Remove(a);
+      }
+      a = next;
+    }
+
+    int reg = -1;
+    for (int i = 0; i < kRegisterCount; i++) {
+      if (!used[i]) {
+        reg = i;
+        break;
+      }
+    }
+
+    if (reg != -1) {
+      used[reg] = true;
+      current->Allocate(LInterval::kRegister, reg);
+      active.Push(current);
+      continue;
+    }
+
+    // No free registers: interval that ends last goes to the stack
+    LIntervalList::Item* victim = NULL;
+    for (a = active.head(); a != NULL; a = a->next()) {
+      if (victim == NULL || a->value()->end() > victim->value()->end()) {
+        victim = a;
+      }
+    }
+
+    LInterval* spill = current;
+    if (victim != NULL && victim->value()->end() > current->end()) {
+      spill = victim->value();
+      current->Allocate(LInterval::kRegister, spill->index());
+      active.Remove(victim);
+      active.Push(current);
+    }
+
+    int slot;
+    if (free_slots.length() != 0) {
+      slot = free_slots.Shift()->index();
+    } else {
+      slot = stack_slots_++;
+    }
+    spill->Allocate(LInterval::kStackSlot, slot);
+    active_slots.Push(spill);
+  }
+}
+
+} // namespace internal
+} // namespace candor
@@ -0,0 +1,169 @@
+#ifndef _SRC_LIR_H_
+#define _SRC_LIR_H_
+
+#include "hir.h" // HIRGen, HIRBlock, HIRInstruction
+#include "zone.h" // ZoneObject
+#include "utils.h" // List
+
+#include "macroassembler.h" // Masm
+
+#include <stdint.h> // uint32_t
+
+namespace candor {
+namespace internal {
+
+// Forward declarations
+class CodeSpace;
+class SourceMap;
+class Optimizer;
+class LInterval;
+
+typedef List<LInterval*, ZoneObject> LIntervalList;
+
+// Set of values (indexed by interval's id)
+class BitField : public ZoneObject {
+ public:
+  BitField(int size);
+
+  inline void Set(int index) { bits_[index >> 5] |= 1 << (index & 31); }
+  inline void Clear(int index) { bits_[index >> 5] &= ~(1 << (index & 31)); }
+  inline bool Test(int index) {
+    return (bits_[index >> 5] & (1 << (index & 31))) != 0;
+  }
+
+  void Merge(BitField* other);
+  void Copy(BitField* other);
+
+  inline int size() { return size_; }
+
+ protected:
+  int size_;
+  uint32_t* bits_;
+};
+
+// Live range of instruction's value (from definition to the last use),
+// value is kept either in register or in frame's slot for the whole range
+class LInterval : public ZoneObject {
+ public:
+  enum Kind {
+    kUnallocated,
+    kRegister,
+    kStackSlot
+  };
+
+  LInterval(HIRInstruction* instr, int id) : instr_(instr),
+                                             id_(id),
+                                             start_(-1),
+                                             end_(-1),
+                                             kind_(kUnallocated),
+                                             index_(-1) {
+  }
+
+  inline void Extend(int pos) {
+    if (start_ == -1 || pos < start_) start_ = pos;
+    if (pos > end_) end_ = pos;
+  }
+
+  // Value is alive (and should be preserved) while `pos` executes
+  inline bool Covers(int pos) { return start_ < pos && pos < end_; }
+
+  inline void Allocate(Kind kind, int index) {
+    kind_ = kind;
+    index_ = index;
+  }
+
+  inline bool is_register() { return kind_ == kRegister; }
+  inline bool is_stack() { return kind_ == kStackSlot; }
+
+  inline bool Is(LInterval* other) {
+    return kind_ == other->kind_ && index_ == other->index_;
+  }
+
+  inline HIRInstruction* instr() { return instr_; }
+  inline int id() { return id_; }
+  inline int start() { return start_; }
+  inline int end() { return end_; }
+  inline Kind kind() { return kind_; }
+  inline int index() { return index_; }
+
+ protected:
+  HIRInstruction* instr_;
+  int id_;
+  int start_;
+  int end_;
+  Kind kind_;
+  int index_;
+};
+
+// Generates optimized code from HIR: instructions are numbered, live
+// intervals of values are computed and registers are assigned by linear
+// scan (intervals that doesn't fit into registers are living in frame's
+// slots). Machine code generation is platform-specific.
+class LGen : public Masm {
+ public:
+  // Number of registers available for allocation (platform-specific)
+  static const int kRegisterCount;
+
+  LGen(HIRGen* hir, CodeSpace* space, SourceMap* map);
+  ~LGen();
+
+  void Generate();
+
+  inline HIRGen* hir() { return hir_; }
+  inline LIntervalList* intervals() { return &intervals_; }
+  inline int stack_slots() { return stack_slots_; }
+  inline SourceMap* source_map() { return source_map_; }
+
+ protected:
+  // Assign positions to instructions (phis are defined at block's start)
+  void NumberInstructions();
+  void ComputeLiveness();
+  void AllocateRegisters();
+
+  // Comparison that is used only by the following branch
+  bool IsFused(HIRInstruction* instr);
+
+  // Platform-specific code generation
+  void GeneratePrologue();
+  void GenerateBlock(HIRBlock* block);
+  void GenerateInstruction(HIRInstruction* instr);
+  void GenerateBinOp(HIRInstruction* instr);
+  void GenerateCall(HIRInstruction* instr);
+  void GenerateProperty(HIRInstruction* instr);
+  void GenerateBranch(HIRInstruction* instr);
+
+  // Assign values to successor's phis
+  void GenerateMoves(HIRBlock* from, HIRBlock* to);
+
+  void Load(Register dst, HIRInstruction* value);
+  void Store(HIRInstruction* instr, Register src);
+  void LoadInterval(Register dst, LInterval* interval);
+  void StoreInterval(LInterval* interval, Register src);
+  void LoadConstant(Register dst, HIRInstruction* value);
+
+  // Context that holds variables of given depth
+  void LoadContext(Register dst, int32_t depth);
+
+  // Preserve registers with values that are live across instruction
+  int SaveLive(int pos, Register* saved);
+  void RestoreLive(Register* saved, int count);
+  void ClearStale(bool keep_rbx);
+  void CallStub(HIRInstruction* instr, char* stub, bool uses_rbx);
+
+  char* GetBinOpStub(BinOp::BinOpType type);
+  Label* label(HIRBlock* block);
+
+  HIRGen* hir_;
+  LIntervalList intervals_;
+  int stack_slots_;
+  SourceMap* source_map_;
+
+  Label** labels_;
+  int label_count_;
+  uint32_t used_registers_;
+};
+
+} // namespace internal
+} // namespace candor
+
+#endif // _SRC_LIR_H_
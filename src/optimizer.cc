@@ -0,0 +1,254 @@
+#include "optimizer.h"
+#include "code-space.h" // CodeSpace
+#include "heap.h" // Heap
+#include "heap-inl.h"
+#include "parser.h" // Parser
+#include "scope.h" // Scope
+#include "visitor.h" // Visitor
+#include "ast.h" // AstNode, FunctionLiteral
+#include "hir.h" // HIRGen
+#include "lir.h" // LGen
+#include "source-map.h" // SourceMap
+#include "zone.h" // Zone
+#include "utils.h" // List
+
+#include "macroassembler.h" // Masm
+
+#include <stdint.h> // uint32_t, uint64_t
+#include <stdlib.h> // NULL
+#include <string.h> // memcpy, strlen
+
+namespace candor {
+namespace internal {
+
+// Finds function literal (and its loop) by position in source
+class FunctionFinder : public Visitor {
+ public:
+  FunctionFinder(int32_t offset, uint32_t length, int32_t loop_offset)
+      : Visitor(kPreorder),
+        offset_(offset),
+        length_(length),
+        loop_offset_(loop_offset),
+        result_(NULL),
+        loop_(NULL) {
+  }
+
+  AstNode* VisitFunction(AstNode* node) {
+    if (node->offset() == offset_ && node->length() == length_) {
+      result_ = FunctionLiteral::Cast(node);
+    }
+
+    VisitChildren(node);
+    return node;
+  }
+
+  // Functions may be passed as arguments
+  AstNode* VisitCall(AstNode* node) {
+    FunctionLiteral* fn = FunctionLiteral::Cast(node);
+
+    if (fn->variable() != NULL) Visit(fn->variable());
+
+    AstList::Item* item = fn->args()->head();
+    for (; item != NULL; item = item->next()) Visit(item->value());
+
+    VisitChildren(node);
+    return node;
+  }
+
+  AstNode* VisitWhile(AstNode* node) {
+    if (loop_offset_ != -1 && node->offset() == loop_offset_) loop_ = node;
+
+    VisitChildren(node);
+    return node;
+  }
+
+  inline FunctionLiteral* result() { return result_; }
+  inline AstNode* loop() { return loop_; }
+
+ private:
+  int32_t offset_;
+  uint32_t length_;
+  int32_t loop_offset_;
+  FunctionLiteral* result_;
+  AstNode* loop_;
+};
+
+
+FunctionProfile::FunctionProfile(int32_t offset,
+                                 uint32_t length,
+                                 int32_t loop_offset,
+                                 uint32_t code_offset)
+    : calls_(0),
+      loop_code_(NULL),
+      state_(kCounting),
+      offset_(offset),
+      length_(length),
+      loop_offset_(loop_offset),
+      code_offset_(code_offset),
+      code_(NULL),
+      source_(NULL) {
+}
+
+
+Optimizer::Optimizer(CodeSpace* space) : space_(space),
+                                         threshold_(kDefaultThreshold) {
+  profiles_.allocated = true;
+  cells_.allocated = true;
+}
+
+
+Optimizer::~Optimizer() {
+  FunctionProfile::Source* source;
+  while ((source = sources_.Shift()) != NULL) {
+    delete[] source->filename;
+    delete[] source->source;
+    delete source;
+  }
+}
+
+
+FunctionProfile* Optimizer::New(FunctionLiteral* fn, uint32_t code_offset) {
+  if (threshold_ == 0 || fn->is_root()) return NULL;
+
+  // Optimizing compiler works only with on-stack variables
+  if (fn->context_slots() != 0) return NULL;
+
+  AstList::Item* item = fn->args()->head();
+  for (; item != NULL; item = item->next()) {
+    if (!item->value()->is(AstNode::kValue)) return NULL;
+  }
+
+  FunctionProfile* profile = new FunctionProfile(fn->offset(),
+                                                 fn->length(),
+                                                 -1,
+                                                 code_offset);
+  profiles_.Push(profile);
+  pending_.Push(profile);
+
+  return profile;
+}
+
+
+FunctionProfile* Optimizer::NewLoop(FunctionLiteral* fn, AstNode* loop) {
+  // Loops are compiled without function's entry, so closures and
+  // varargs are fine here
+  if (threshold_ == 0) return NULL;
+
+  FunctionProfile* profile = new FunctionProfile(fn->offset(),
+                                                 fn->length(),
+                                                 loop->offset(),
+                                                 0);
+  profiles_.Push(profile);
+  pending_.Push(profile);
+
+  return profile;
+}
+
+
+void Optimizer::Commit(const char* filename,
+                       const char* source,
+                       uint32_t length,
+                       char* code) {
+  if (pending_.length() == 0) return;
+
+  FunctionProfile::Source* copy = NULL;
+  if (code != NULL) {
+    // Script's source may be freed after compilation
+    uint32_t filename_length = strlen(filename);
+
+    copy = new FunctionProfile::Source();
+    copy->filename = new char[filename_length + 1];
+    memcpy(copy->filename, filename, filename_length + 1);
+    copy->source = new char[length];
+    memcpy(copy->source, source, length);
+    copy->length = length;
+
+    sources_.Push(copy);
+  }
+
+  FunctionProfile* profile;
+  while ((profile = pending_.Shift()) != NULL) {
+    if (code == NULL) {
+      profile->state(FunctionProfile::kFailed);
+      continue;
+    }
+
+    profile->source(copy);
+    if (!profile->is_loop()) profile->code(code + profile->code_offset());
+  }
+}
+
+
+void Optimizer::Optimize(FunctionProfile* profile) {
+  if (profile->state() != FunctionProfile::kCounting) return;
+
+  char* code = Compile(profile);
+  if (code == NULL) return;
+
+  // Every call of non-optimized code is going to jump into optimized one
+  Masm redirect(space_);
+  redirect.movq(scratch, Immediate(reinterpret_cast<uint64_t>(code)));
+  redirect.jmp(scratch);
+  memcpy(profile->code(), redirect.buffer(), redirect.offset());
+}
+
+
+char* Optimizer::OptimizeLoop(FunctionProfile* profile) {
+  if (profile->state() == FunctionProfile::kCounting) {
+    profile->loop_code(Compile(profile));
+  }
+
+  return profile->loop_code();
+}
+
+
+char* Optimizer::Compile(FunctionProfile* profile) {
+  // Assume failure, in case if function isn't supported
+  profile->state(FunctionProfile::kFailed);
+
+  FunctionProfile::Source* source = profile->source();
+  Zone zone;
+  Parser p(source->source, source->length);
+
+  AstNode* ast = p.Execute();
+  if (p.has_error()) return NULL;
+
+  Scope::Analyze(ast);
+
+  FunctionFinder finder(profile->offset(),
+                        profile->length(),
+                        profile->loop_offset());
+  finder.Visit(ast);
+  if (finder.result() == NULL) return NULL;
+  if (profile->is_loop() && finder.loop() == NULL) return NULL;
+
+  HIRGen hir(finder.result(), finder.loop());
+  if (!hir.Build()) return NULL;
+
+  SourceMap* map = space_->heap()->source_map();
+  LGen lir(&hir, space_, map);
+  lir.Generate();
+
+  char* code = space_->Put(&lir);
+  map->Commit(source->filename, source->source, source->length, code);
+
+  profile->state(FunctionProfile::kOptimized);
+
+  return code;
+}
+
+
+char** Optimizer::NewCell(char* value) {
+  char** cell = new char*;
+  *cell = value;
+
+  space_->heap()->Reference(Heap::kRefPersistent,
+                            reinterpret_cast<HValue**>(cell),
+                            HValue::Cast(value));
+  cells_.Push(cell);
+
+  return cell;
+}
+
+} // namespace internal
+} // namespace candor
@@ -0,0 +1,137 @@
+#ifndef _SRC_OPTIMIZER_H_
+#define _SRC_OPTIMIZER_H_
+
+#include "utils.h" // List
+
+#include <stdint.h> // int32_t, uint32_t, uint64_t
+
+namespace candor {
+namespace internal {
+
+// Forward declarations
+class CodeSpace;
+class FunctionLiteral;
+class AstNode;
+
+// Non-optimized code of function increments the counter of its profile on
+// every call and asks optimizer to recompile function once the counter
+// reaches threshold. Profiles of `while` loops are counting iterations
+// instead, loop's code is compiled on its own and entered in the middle
+// of non-optimized function (on-stack replacement).
+class FunctionProfile {
+ public:
+  enum State {
+    kCounting,
+    kOptimized,
+    kFailed
+  };
+
+  // Copy of script's source, shared by profiles of all its functions
+  // (functions are parsed again when they're getting hot)
+  struct Source {
+    char* filename;
+    char* source;
+    uint32_t length;
+  };
+
+  // Generated code is incrementing counter and reading loop's code,
+  // keep them at the start
+  static const int kCallsOffset = 0;
+  static const int kLoopCodeOffset = 8;
+
+  FunctionProfile(int32_t offset,
+                  uint32_t length,
+                  int32_t loop_offset,
+                  uint32_t code_offset);
+
+  inline uint64_t calls() { return calls_; }
+  inline State state() { return state_; }
+  inline void state(State state) { state_ = state; }
+
+  // Function is found by its position in source
+  inline int32_t offset() { return offset_; }
+  inline uint32_t length() { return length_; }
+
+  // Loop is found by position of its `while` (-1 for function's profile)
+  inline int32_t loop_offset() { return loop_offset_; }
+  inline bool is_loop() { return loop_offset_ != -1; }
+
+  // Optimized code of loop (called by non-optimized function's code)
+  inline char* loop_code() { return loop_code_; }
+  inline void loop_code(char* loop_code) { loop_code_ = loop_code; }
+
+  // Entry of non-optimized code (known only after compilation)
+  inline uint32_t code_offset() { return code_offset_; }
+  inline char* code() { return code_; }
+  inline void code(char* code) { code_ = code; }
+
+  inline Source* source() { return source_; }
+  inline void source(Source* source) { source_ = source; }
+
+ protected:
+  uint64_t calls_;
+  char* loop_code_;
+  State state_;
+
+  int32_t offset_;
+  uint32_t length_;
+  int32_t loop_offset_;
+  uint32_t code_offset_;
+  char* code_;
+  Source* source_;
+};
+
+class Optimizer {
+ public:
+  static const uint32_t kDefaultThreshold = 1000;
+
+  Optimizer(CodeSpace* space);
+  ~Optimizer();
+
+  // Create profile for function which code is going to be generated at
+  // `code_offset`, NULL is returned if function can't be optimized
+  FunctionProfile* New(FunctionLiteral* fn, uint32_t code_offset);
+
+  // Create profile for `while` loop of function, NULL is returned if
+  // optimization is disabled
+  FunctionProfile* NewLoop(FunctionLiteral* fn, AstNode* loop);
+
+  // Set source and code addresses of profiles created since last commit
+  // (code is NULL if compilation has failed)
+  void Commit(const char* filename,
+              const char* source,
+              uint32_t length,
+              char* code);
+
+  // Recompile function and redirect its non-optimized code to the result
+  void Optimize(FunctionProfile* profile);
+
+  // Compile loop, returns its code or NULL if loop can't be optimized
+  char* OptimizeLoop(FunctionProfile* profile);
+
+  // Persistent slot for heap value referenced by optimized code
+  // (values may be moved by GC)
+  char** NewCell(char* value);
+
+  // Number of calls (iterations) after which function (loop) is
+  // optimized (0 - never)
+  inline uint32_t threshold() { return threshold_; }
+  inline void threshold(uint32_t threshold) { threshold_ = threshold; }
+
+ protected:
+  // Reparse function and generate optimized code for it (or its loop)
+  char* Compile(FunctionProfile* profile);
+
+  CodeSpace* space_;
+  uint32_t threshold_;
+
+  List<FunctionProfile*, EmptyClass> profiles_;
+  List<FunctionProfile*, EmptyClass> pending_;
+  List<FunctionProfile::Source*, EmptyClass> sources_;
+  List<char**, EmptyClass> cells_;
+};
+
+} // namespace internal
+} // namespace candor
+
+#endif // _SRC_OPTIMIZER_H_
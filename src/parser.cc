@@ -107,8 +107,10 @@ AstNode* Parser::ParseStatement(ParseStatementType type) {
     }
     break;
    case kWhile:
-    Skip();
     {
+      Lexer::Token* while_tok = Peek();
+
+      Skip();
       if (!Peek()->is(kParenOpen)) {
         SetError("Expected '(' before while's condition");
         return NULL;
@@ -132,7 +134,9 @@ AstNode* Parser::ParseStatement(ParseStatementType type) {
         return NULL;
       }
 
+      // Loop is found by its position when it's getting hot
       result = new AstNode(AstNode::kWhile);
+      result->offset(while_tok->offset());
       result->children()->Push(cond);
       result->children()->Push(body);
     }
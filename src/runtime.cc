@@ -1,15 +1,15 @@
 #include "runtime.h"
 #include "heap.h" // Heap
 #include "heap-inl.h"
+#include "code-space.h" // CodeSpace
+#include "optimizer.h" // Optimizer
 #include "utils.h" // ComputeHash, etc
 
-#define __STDC_FORMAT_MACROS
-#include <inttypes.h> // printf formats for big integers
 #include <stdint.h> // uint32_t
 #include <assert.h> // assert
-#include <string.h> // strncmp
-#include <stdio.h> // snprintf
+#include <string.h> // strncmp, memcpy
 #include <sys/types.h> // size_t
+#include <emmintrin.h> // _mm_cmpeq_epi8, _mm_movemask_epi8
 
 namespace candor {
 namespace internal {
@@ -54,12 +54,52 @@ char* RuntimeAllocate(Heap* heap,
 }
 
 
+char* RuntimeAllocateTagged(Heap* heap, off_t qtag, uint32_t bytes) {
+  int generation_shift = (HValue::kGenerationOffset -
+                          HValue::interior_offset(0)) << 3;
+  int site_shift = (HValue::kAllocationSiteOffset -
+                    HValue::interior_offset(0)) << 3;
+
+  // Pretenured sites are passing old generation
+  uint8_t generation = (qtag >> generation_shift) & 0xff;
+  char* result = heap->AllocateTagged(
+      static_cast<Heap::HeapTag>(qtag & 0xff),
+      generation == 0 ? Heap::kTenureNew : Heap::kTenureOld,
+      bytes - HValue::kPointerSize);
+
+  *reinterpret_cast<uint16_t*>(result + HValue::kAllocationSiteOffset) =
+      (qtag >> site_shift) & 0xffff;
+
+  return result;
+}
+
+
 void RuntimeCollectGarbage(Heap* heap, char* stack_top) {
   Zone gc_zone;
   heap->gc()->CollectGarbage(stack_top);
 }
 
 
+void RuntimeOptimize(CodeSpace* space, FunctionProfile* profile) {
+  space->optimizer()->Optimize(profile);
+}
+
+
+char* RuntimeOptimizeLoop(CodeSpace* space, FunctionProfile* profile) {
+  return space->optimizer()->OptimizeLoop(profile);
+}
+
+
+void RuntimeWriteBarrier(Heap* heap, char* old_value) {
+  heap->WriteBarrier(old_value);
+}
+
+
+void RuntimeCompactRememberedSet(Heap* heap) {
+  heap->remembered_set()->Compact();
+}
+
+
 off_t RuntimeGetHash(Heap* heap, char* value) {
   Heap::HeapTag tag = HValue::GetTag(value);
 
@@ -83,7 +123,7 @@ off_t RuntimeGetHash(Heap* heap, char* value) {
     {
       int64_t intval;
 
-      if (HValue::IsUnboxed(value)) {
+      if (HNumber::IsIntegral(value)) {
         intval = HNumber::IntegralValue(value);
       } else {
         intval = HNumber::DoubleValue(value);
@@ -100,6 +140,245 @@ off_t RuntimeGetHash(Heap* heap, char* value) {
 }
 
 
+static void ReplaceMap(Heap* heap, char* obj, char* new_map) {
+  char** map_addr = HObject::MapSlot(obj);
+  heap->WriteBarrier(*map_addr);
+  *map_addr = new_map;
+  heap->RecordSlot(obj, map_addr);
+}
+
+
+// Map of object with shape contains only values, copy them to the bigger one
+static void GrowShapedObject(Heap* heap, char* obj) {
+  HMap* map = HValue::As<HMap>(HObject::Map(obj));
+  uint32_t size = map->size();
+
+  char* new_map = HMap::NewEmpty(heap, size << 1);
+  char** space = reinterpret_cast<char**>(new_map + HMap::kSpaceOffset);
+  memcpy(space, map->space(), (size << 1) * HValue::kPointerSize);
+
+  // Big map is allocated in large space and is old already
+  if (HValue::Cast(new_map)->IsLarge()) {
+    for (uint32_t i = 0; i < size << 1; i++) {
+      heap->RecordSlot(new_map, space + i);
+    }
+  }
+
+  ReplaceMap(heap, obj, new_map);
+}
+
+
+// Turn object with shape into dictionary mode
+static void NormalizeObject(Heap* heap, char* obj) {
+  Shape* shape = HObject::GetShape(obj);
+  char* values = HObject::Map(obj);
+
+  // Leave place for one more key, map is filled by half at maximum
+  uint32_t size = PowerOfTwo((shape->length() + 1) << 1);
+  ReplaceMap(heap, obj, HMap::NewDictionary(heap, size));
+  *HObject::MaskSlot(obj) = (size - 1) * HValue::kPointerSize;
+  *HObject::ShapeSlot(obj) = NULL;
+
+  for (uint32_t i = 0; i < shape->table_size(); i++) {
+    Shape::Entry* entry = &shape->table()[i];
+    if (entry->key == NULL) continue;
+
+    char** slot = HObject::LookupProperty(heap, obj, entry->key, 1);
+    *slot = *reinterpret_cast<char**>(values + entry->offset);
+    heap->RecordSlot(HObject::Map(obj), slot);
+  }
+}
+
+
+// Dense array's elements are staying at the same offsets, copy them into
+// the bigger map
+static void GrowElements(Heap* heap, char* obj, uint32_t min_capacity) {
+  HMap* map = HValue::As<HMap>(HObject::Map(obj));
+  uint32_t capacity = HArray::Capacity(obj);
+  uint32_t new_capacity = capacity << 1;
+
+  if (min_capacity > new_capacity) {
+    new_capacity = PowerOfTwo(min_capacity);
+  }
+
+  bool doubles = HArray::Kind(obj) == HArray::kDoubleElements;
+  char* new_map = doubles ? HMap::NewDoubles(heap, new_capacity >> 1) :
+                            HMap::NewEmpty(heap, new_capacity >> 1);
+  char** space = reinterpret_cast<char**>(new_map + HMap::kSpaceOffset);
+  memcpy(space, map->space(), capacity * HValue::kPointerSize);
+
+  // Big map is allocated in large space and is old already
+  if (!doubles && HValue::Cast(new_map)->IsLarge()) {
+    for (uint32_t i = 0; i < capacity; i++) {
+      heap->RecordSlot(new_map, space + i);
+    }
+  }
+
+  ReplaceMap(heap, obj, new_map);
+  *HObject::MaskSlot(obj) = (new_capacity - 1) * HValue::kPointerSize;
+}
+
+
+// Elements are converted into a new map of the same capacity: integers into
+// raw doubles, or raw doubles into boxed numbers. Integer elements are
+// valid values of any kind.
+static void TransitionElements(Heap* heap,
+                               char* obj,
+                               HArray::Representation kind) {
+  HMap* map = HValue::As<HMap>(HObject::Map(obj));
+  uint32_t capacity = HArray::Capacity(obj);
+
+  if (kind == HArray::kDoubleElements) {
+    assert(HArray::Kind(obj) == HArray::kSmiElements);
+
+    char* new_map = HMap::NewDoubles(heap, capacity >> 1);
+    double* space = reinterpret_cast<double*>(new_map + HMap::kSpaceOffset);
+    for (uint32_t i = 0; i < capacity; i++) {
+      char* value = *map->GetSlotAddress(i);
+      if (value == HNil::New()) continue;
+
+      space[i] = HNumber::DoubleValue(value);
+    }
+
+    ReplaceMap(heap, obj, new_map);
+  } else if (HArray::Kind(obj) == HArray::kDoubleElements) {
+    char* new_map = HMap::NewEmpty(heap, capacity >> 1);
+    char** space = reinterpret_cast<char**>(new_map + HMap::kSpaceOffset);
+    uint64_t* raw = reinterpret_cast<uint64_t*>(map->space());
+    for (uint32_t i = 0; i < capacity; i++) {
+      if (raw[i] == HArray::kHoleNaN) continue;
+
+      double value;
+      memcpy(&value, &raw[i], sizeof(value));
+      space[i] = HNumber::New(heap, Heap::kTenureNew, value);
+      heap->RecordSlot(new_map, space + i);
+    }
+
+    ReplaceMap(heap, obj, new_map);
+  }
+
+  HValue::SetRepresentation(obj, kind);
+}
+
+
+static void GrowObject(Heap* heap, char* obj, uint32_t min_size, bool dense) {
+  char** map_addr = HObject::MapSlot(obj);
+  HMap* map = HValue::As<HMap>(*map_addr);
+  uint32_t size = map->size() << 1;
+
+  if (min_size > size) {
+    size = PowerOfTwo(min_size);
+  }
+
+  // Create a new map
+  char* new_map = HMap::NewDictionary(heap, size);
+
+  // Replace old map with a new
+  ReplaceMap(heap, obj, new_map);
+
+  // Update mask
+  uint32_t mask = (size - 1) * HValue::kPointerSize;
+  *HObject::MaskSlot(obj) = mask;
+
+  // And rehash properties to new map
+  uint32_t original_size = map->size();
+  if (dense) {
+    // Dense array's map doesn't contain key pointers, iterate values
+    original_size = original_size << 1;
+    for (uint32_t i = 0; i < original_size; i++) {
+      char* value = *map->GetSlotAddress(i);
+      if (value == HNil::New()) continue;
+
+      // Big map is allocated in large space and is old already
+      char* key = HNumber::ToPointer(i);
+      char** slot = HObject::LookupProperty(heap, obj, key, 1);
+      *slot = value;
+      heap->RecordSlot(new_map, slot);
+    }
+  } else {
+    // Object and non-dense arrays contains both keys and pointers
+    for (uint32_t i = 0; i < original_size; i++) {
+      char* key = *map->GetSlotAddress(i);
+      if (key == HNil::New()) continue;
+
+      char* value = *map->GetSlotAddress(i + original_size);
+
+      char** slot = HObject::LookupProperty(heap, obj, key, 1);
+      *slot = value;
+      heap->RecordSlot(new_map, slot);
+    }
+  }
+}
+
+
+// Dictionary maps are probed by groups of slots: control bytes of a group are
+// compared with key's hash bits at once, and key is absent if the group has
+// an empty slot
+static off_t LookupDictionary(Heap* heap,
+                              char* obj,
+                              char* key,
+                              uint32_t hash,
+                              off_t insert) {
+  char* map = HObject::Map(obj);
+  HMap* hmap = HValue::As<HMap>(map);
+  assert(hmap->IsDictionary());
+
+  uint32_t size = hmap->size();
+  uint32_t mask = size - 1;
+  uint8_t* control = hmap->control();
+  char** keys = reinterpret_cast<char**>(hmap->space());
+
+  __m128i fragment = _mm_set1_epi8(HMap::HashFragment(hash));
+  __m128i empty = _mm_set1_epi8(static_cast<char>(HMap::kEmptySlot));
+
+  uint32_t pos = HMap::HashIndex(hash, size);
+  int64_t free_index = -1;
+  while (true) {
+    __m128i group = _mm_loadu_si128(
+        reinterpret_cast<__m128i*>(control + pos));
+
+    uint32_t matches = _mm_movemask_epi8(_mm_cmpeq_epi8(group, fragment));
+    for (; matches != 0; matches &= matches - 1) {
+      uint32_t index = (pos + __builtin_ctz(matches)) & mask;
+      if (keys[index] == key ||
+          RuntimeStrictCompare(heap, keys[index], key) == 0) {
+        return HMap::kSpaceOffset + (size + index) * HValue::kPointerSize;
+      }
+    }
+
+    // Both empty and deleted slots have the high bit set
+    uint32_t available = _mm_movemask_epi8(group);
+    if (free_index == -1 && available != 0) {
+      free_index = (pos + __builtin_ctz(available)) & mask;
+    }
+
+    if (_mm_movemask_epi8(_mm_cmpeq_epi8(group, empty)) != 0) break;
+
+    pos = (pos + HMap::kGroupSize) & mask;
+  }
+
+  // get missing property == nil
+  if (!insert) return Heap::kTagNil;
+
+  // Deleted slots may be reused, but empty ones are limited to keep probe
+  // sequences short - rehash into a bigger map when they're over
+  if (control[free_index] == HMap::kEmptySlot) {
+    if (hmap->growth_left() == 0) {
+      RuntimeGrowObject(heap, obj, 0);
+
+      return RuntimeLookupProperty(heap, obj, key, insert);
+    }
+    hmap->growth_left(hmap->growth_left() - 1);
+  }
+
+  hmap->SetControl(free_index, HMap::HashFragment(hash));
+  keys[free_index] = key;
+  heap->RecordSlot(map, &keys[free_index]);
+
+  return HMap::kSpaceOffset + (size + free_index) * HValue::kPointerSize;
+}
+
+
 off_t RuntimeLookupProperty(Heap* heap,
                             char* obj,
                             char* key,
@@ -108,9 +387,6 @@ off_t RuntimeLookupProperty(Heap* heap,
   assert(!HValue::Cast(obj)->IsSoftGCMarked());
 
   char* map = HObject::Map(obj);
-  char* space = HValue::As<HMap>(map)->space();
-  uint32_t mask = HObject::Mask(obj);
-
   bool is_array = HValue::GetTag(obj) == Heap::kTagArray;
 
   char* keyptr = NULL;
@@ -125,110 +401,218 @@ off_t RuntimeLookupProperty(Heap* heap,
     // Negative lookups are prohibited
     if (numkey < 0) return Heap::kTagNil;
 
+    // Slot may receive any value, and raw doubles have no slots at all
+    if (HArray::Kind(obj) == HArray::kDoubleElements ||
+        (insert && HArray::Kind(obj) == HArray::kSmiElements)) {
+      TransitionElements(heap, obj, HArray::kDense);
+    }
+
     // Update array's length on insertion (if increased)
     if (insert && HArray::Length(obj, false) <= numkey) {
       HArray::SetLength(obj, numkey + 1);
     }
   } else {
     assert(HValue::GetTag(obj) == Heap::kTagObject);
+
+    // String keys of objects are internalized, if there's no such string
+    // no object has this property
+    if (HValue::GetTag(key) == Heap::kTagString) {
+      if (insert) {
+        key = heap->strings()->Intern(heap, key);
+      } else {
+        key = heap->strings()->Lookup(heap, key);
+        if (key == NULL) return Heap::kTagNil;
+      }
+    }
+
+    Shape* shape = HObject::GetShape(obj);
+    if (shape != NULL) {
+      off_t offset = shape->Lookup(heap, key);
+      if (offset != -1) return offset;
+
+      // get missing property == nil
+      if (!insert) return Heap::kTagNil;
+
+      Shape* child = shape->Transition(heap, key);
+      if (child == NULL) {
+        NormalizeObject(heap, obj);
+        return RuntimeLookupProperty(heap, obj, key, insert);
+      }
+
+      offset = shape->NextOffset();
+      if (child->length() > HValue::As<HMap>(map)->size() << 1) {
+        GrowShapedObject(heap, obj);
+      }
+      *HObject::ShapeSlot(obj) = child;
+
+      return offset;
+    }
+
     keyptr = key;
     hash = RuntimeGetHash(heap, key);
   }
 
   if (is_array && HArray::IsDense(obj)) {
     // Dense arrays use another lookup mechanism
-    uint32_t index = numkey * HValue::kPointerSize;
+    int64_t capacity = HArray::Capacity(obj);
 
-    if (index > mask) {
-      if (insert) {
-        RuntimeGrowObject(heap, obj, numkey);
+    if (numkey >= capacity) {
+      // get a[length + x] == nil
+      if (!insert) return Heap::kTagNil;
 
-        return RuntimeLookupProperty(heap, obj, keyptr, insert);
+      if (numkey - capacity < HArray::kMaxDenseGap) {
+        GrowElements(heap, obj, numkey + 1);
       } else {
-        // get a[length + x] == nil
-        return Heap::kTagNil;
+        // Too many holes - rehash values with keys, leaving enough place
+        // for every element of the full map
+        HValue::SetRepresentation(obj, HArray::kSparse);
+        GrowObject(heap, obj, capacity << 1, true);
       }
-    }
 
-    return HMap::kSpaceOffset + (index & mask);
-  } else {
-    // Dive into space and walk it in circular manner
-    uint32_t start = hash & mask;
-
-    uint32_t index = start;
-    char* key_slot = NULL;
-    bool needs_grow = true;
-    do {
-      key_slot = *reinterpret_cast<char**>(space + index);
-      if (key_slot == HNil::New() ||
-          (is_array && key_slot == keyptr) ||
-          RuntimeStrictCompare(heap, key_slot, key) == 0) {
-        needs_grow = false;
-        break;
-      }
+      return RuntimeLookupProperty(heap, obj, keyptr, insert);
+    }
 
-      index += HValue::kPointerSize;
-      index = index & mask;
-    } while (index != start);
+    return HMap::kSpaceOffset + numkey * HValue::kPointerSize;
+  }
 
-    if (insert) {
-      // All key slots are filled - rehash and lookup again
-      if (needs_grow) {
-        RuntimeGrowObject(heap, obj, 0);
+  return LookupDictionary(heap, obj, keyptr, hash, insert);
+}
 
-        return RuntimeLookupProperty(heap, obj, keyptr, insert);
-      }
 
-      *reinterpret_cast<char**>(space + index) = keyptr;
-    }
+off_t RuntimeLookupPropertyIC(Heap* heap,
+                              char* obj,
+                              char* key,
+                              off_t insert,
+                              InlineCache* ic) {
+  off_t offset = RuntimeLookupProperty(heap, obj, key, insert);
 
-    return HMap::kSpaceOffset + index + (mask + HValue::kPointerSize);
+  // Cached offset should point to an existing key, shape is taken after
+  // insertion
+  if (offset != Heap::kTagNil) {
+    ic->Update(reinterpret_cast<char*>(HObject::GetShape(obj)), offset);
   }
+
+  return offset;
 }
 
 
-char* RuntimeGrowObject(Heap* heap, char* obj, uint32_t min_size) {
-  char** map_addr = HObject::MapSlot(obj);
-  HMap* map = HValue::As<HMap>(*map_addr);
-  uint32_t size = map->size() << 1;
+char* RuntimeLoadElement(Heap* heap, char* obj, char* key) {
+  if (HValue::GetTag(obj) != Heap::kTagArray &&
+      HValue::GetTag(obj) != Heap::kTagObject) {
+    return HNil::New();
+  }
 
-  if (min_size > size) {
-    size = PowerOfTwo(min_size);
+  // Raw doubles are boxed on every load
+  if (HValue::GetTag(obj) == Heap::kTagArray &&
+      HArray::Kind(obj) == HArray::kDoubleElements) {
+    int64_t numkey = HNumber::IntegralValue(RuntimeToNumber(heap, key));
+    if (numkey < 0 || numkey >= HArray::Capacity(obj)) return HNil::New();
+
+    uint64_t* raw = reinterpret_cast<uint64_t*>(HObject::Map(obj) +
+                                                HMap::kSpaceOffset);
+    if (raw[numkey] == HArray::kHoleNaN) return HNil::New();
+
+    double value;
+    memcpy(&value, &raw[numkey], sizeof(value));
+    return HNumber::New(heap, Heap::kTenureNew, value);
   }
 
-  // Create a new map
-  char* new_map = HMap::NewEmpty(heap, size);
+  off_t offset = RuntimeLookupProperty(heap, obj, key, 0);
+  if (offset == Heap::kTagNil) return HNil::New();
 
-  // Replace old map with a new
-  *map_addr = new_map;
+  return *reinterpret_cast<char**>(HObject::Map(obj) + offset);
+}
 
-  // Update mask
-  uint32_t mask = (size - 1) * HValue::kPointerSize;
-  *HObject::MaskSlot(obj) = mask;
 
-  // And rehash properties to new map
-  uint32_t original_size = map->size();
-  if (HValue::GetTag(obj) == Heap::kTagArray && HArray::IsDense(obj)) {
-    // Dense array's map doesn't contain key pointers, iterate values
-    original_size = original_size << 1;
-    for (uint32_t i = 0; i < original_size; i++) {
-      char* value = *map->GetSlotAddress(i);
-      if (value == HNil::New()) continue;
+char* RuntimeStoreElement(Heap* heap, char* obj, char* key, char* value) {
+  if (HValue::GetTag(obj) != Heap::kTagArray &&
+      HValue::GetTag(obj) != Heap::kTagObject) {
+    return value;
+  }
 
-      *HObject::LookupProperty(heap, obj, HNumber::ToPointer(i), 1) = value;
+  // Integer and double elements are stored without slot lookup, other
+  // values are generalizing the kind
+  if (HValue::GetTag(obj) == Heap::kTagArray &&
+      (HArray::Kind(obj) == HArray::kSmiElements ||
+       HArray::Kind(obj) == HArray::kDoubleElements)) {
+    bool is_number = HValue::GetTag(value) == Heap::kTagNumber;
+    if (value != HNil::New() && !HNumber::IsIntegral(value)) {
+      if (!is_number) {
+        TransitionElements(heap, obj, HArray::kDense);
+      } else if (HArray::Kind(obj) == HArray::kSmiElements) {
+        TransitionElements(heap, obj, HArray::kDoubleElements);
+      }
     }
-  } else {
-    // Object and non-dense arrays contains both keys and pointers
-    for (uint32_t i = 0; i < original_size; i++) {
-      char* key = *map->GetSlotAddress(i);
-      if (key == HNil::New()) continue;
 
-      char* value = *map->GetSlotAddress(i + original_size);
+    int64_t numkey = HNumber::IntegralValue(RuntimeToNumber(heap, key));
+    if (numkey < 0) return value;
 
-      *HObject::LookupProperty(heap, obj, key, 1) = value;
+    // Elements far behind the end are stored sparsely, as any values
+    if (numkey >= HArray::Capacity(obj)) {
+      if (numkey - HArray::Capacity(obj) < HArray::kMaxDenseGap) {
+        GrowElements(heap, obj, numkey + 1);
+      } else {
+        TransitionElements(heap, obj, HArray::kDense);
+      }
     }
+
+    if (HArray::Kind(obj) != HArray::kDense) {
+      if (HArray::Length(obj, false) <= numkey) {
+        HArray::SetLength(obj, numkey + 1);
+      }
+
+      char* space = HObject::Map(obj) + HMap::kSpaceOffset;
+      if (HArray::Kind(obj) == HArray::kSmiElements) {
+        // Neither integers nor nil are needing barrier or remembering
+        reinterpret_cast<char**>(space)[numkey] = value;
+      } else if (value == HNil::New()) {
+        reinterpret_cast<uint64_t*>(space)[numkey] = HArray::kHoleNaN;
+      } else {
+        reinterpret_cast<double*>(space)[numkey] = HNumber::DoubleValue(value);
+      }
+
+      return value;
+    }
+  }
+
+  off_t offset = RuntimeLookupProperty(heap, obj, key, 1);
+  if (offset == Heap::kTagNil) return value;
+
+  char** slot = reinterpret_cast<char**>(HObject::Map(obj) + offset);
+  heap->WriteBarrier(*slot);
+  *slot = value;
+  heap->RecordSlot(HObject::Map(obj), slot);
+
+  return value;
+}
+
+
+void RuntimeUpdateCallIC(Heap* heap,
+                         char* fn,
+                         InlineCache* ic,
+                         char** target) {
+  ic->Update(fn, reinterpret_cast<off_t>(HFunction::Code(fn)));
+
+  // Site calls the first function directly, code space never moves
+  if (ic->length() != 0 && ic->entries()[0].key == fn) {
+    *target = HFunction::Code(fn);
   }
+}
 
+
+char* RuntimeGrowObject(Heap* heap, char* obj, uint32_t min_size) {
+  if (HValue::GetTag(obj) == Heap::kTagObject &&
+      HObject::GetShape(obj) != NULL) {
+    GrowShapedObject(heap, obj);
+    return 0;
+  }
+
+  if (HValue::GetTag(obj) == Heap::kTagArray && HArray::IsDense(obj)) {
+    GrowElements(heap, obj, min_size);
+    return 0;
+  }
+
+  GrowObject(heap, obj, min_size, false);
   return 0;
 }
 
@@ -244,29 +628,33 @@ char* RuntimeToString(Heap* heap, char* value) {
    case Heap::kTagArray:
    case Heap::kTagCData:
    case Heap::kTagNil:
-    return HString::New(heap, Heap::kTenureNew, "", 0);
+    return heap->strings()->Intern(heap, "", 0);
    case Heap::kTagBoolean:
+    // Constant results are shared
     if (HBoolean::Value(value)) {
-      return HString::New(heap, Heap::kTenureNew, "true", 4);
+      return heap->strings()->Intern(heap, "true", 4);
     } else {
-      return HString::New(heap, Heap::kTenureNew, "false", 5);
+      return heap->strings()->Intern(heap, "false", 5);
     }
    case Heap::kTagNumber:
     {
-      char str[128];
+      char* result = heap->number_strings()->Get(value);
+      if (result != NULL) return result;
+
+      char str[32];
       uint32_t len;
 
-      if (HValue::IsUnboxed(value)) {
-        int64_t num = HNumber::IntegralValue(value);
-        // Maximum int64 value may contain only 20 chars, last one for '\0'
-        len = snprintf(str, sizeof(str), "%" PRIi64, num);
+      if (HNumber::IsIntegral(value)) {
+        len = IntToString(HNumber::IntegralValue(value), str);
       } else {
-        double num = HNumber::DoubleValue(value);
-        len = snprintf(str, sizeof(str), "%g", num);
+        len = DoubleToString(HNumber::DoubleValue(value), str);
       }
 
       // And create new string
-      return HString::New(heap, Heap::kTenureNew, str, len);
+      result = HString::New(heap, Heap::kTenureNew, str, len);
+      heap->number_strings()->Set(value, result);
+
+      return result;
     }
    default:
     UNEXPECTED
@@ -290,14 +678,14 @@ char* RuntimeToNumber(Heap* heap, char* value) {
    case Heap::kTagBoolean:
     {
       int64_t val = HBoolean::Value(value) ? 1 : 0;
-      return HNumber::New(heap, Heap::kTenureNew, val);
+      return HNumber::New(heap, val);
     }
    case Heap::kTagFunction:
    case Heap::kTagObject:
    case Heap::kTagArray:
    case Heap::kTagCData:
    case Heap::kTagNil:
-    return HNumber::New(heap, Heap::kTenureNew, static_cast<int64_t>(0));
+    return HNumber::New(heap, 0);
    case Heap::kTagNumber:
     return value;
    default:
@@ -313,23 +701,23 @@ char* RuntimeToBoolean(Heap* heap, char* value) {
 
   switch (tag) {
    case Heap::kTagString:
-    return HBoolean::New(heap, Heap::kTenureNew, HString::Length(value) > 0);
+    return HBoolean::New(heap, HString::Length(value) > 0);
    case Heap::kTagBoolean:
     return value;
    case Heap::kTagFunction:
    case Heap::kTagObject:
    case Heap::kTagArray:
    case Heap::kTagCData:
-    return HBoolean::New(heap, Heap::kTenureNew, true);
+    return HBoolean::New(heap, true);
    case Heap::kTagNil:
-    return HBoolean::New(heap, Heap::kTenureNew, false);
+    return HBoolean::New(heap, false);
    case Heap::kTagNumber:
-    if (HValue::IsUnboxed(value)) {
+    if (HNumber::IsIntegral(value)) {
       int64_t num = HNumber::IntegralValue(value);
-      return HBoolean::New(heap, Heap::kTenureNew, num != 0);
+      return HBoolean::New(heap, num != 0);
     } else {
       double num = HNumber::DoubleValue(value);
-      return HBoolean::New(heap, Heap::kTenureNew, num != 0);
+      return HBoolean::New(heap, num != 0);
     }
    default:
     UNEXPECTED
@@ -351,6 +739,10 @@ size_t RuntimeStrictCompare(Heap* heap, char* lhs, char* rhs) {
 
   switch (tag) {
    case Heap::kTagString:
+    // Internalized strings with the same contents are the same value
+    if (HString::IsInternalized(lhs) && HString::IsInternalized(rhs)) {
+      return -1;
+    }
     return RuntimeStringCompare(heap, lhs, rhs);
    case Heap::kTagFunction:
    case Heap::kTagObject:
@@ -459,9 +851,7 @@ char* RuntimeBinOp(Heap* heap, char* lhs, char* rhs) {
       // nil == nil = true
       // nil === nil = true
       // nil (+) nil = false
-      return HBoolean::New(heap,
-                           Heap::kTenureNew,
-                           !BinOp::is_negative_eq(type));
+      return HBoolean::New(heap, !BinOp::is_negative_eq(type));
     }
   }
 
@@ -476,9 +866,7 @@ char* RuntimeBinOp(Heap* heap, char* lhs, char* rhs) {
 
       // When strictly comparing - tags should be equal
       if (lhs_tag != rhs_tag) {
-        return HBoolean::New(heap,
-                             Heap::kTenureNew,
-                             BinOp::is_negative_eq(type));
+        return HBoolean::New(heap, BinOp::is_negative_eq(type));
       }
     } else {
       lhs_tag = RuntimeCoerceType(heap, type, lhs, rhs);
@@ -515,7 +903,7 @@ char* RuntimeBinOp(Heap* heap, char* lhs, char* rhs) {
       }
       break;
      case Heap::kTagNumber:
-      if (HValue::IsUnboxed(lhs)) {
+      if (HNumber::IsIntegral(lhs) && HNumber::IsIntegral(rhs)) {
         int64_t lnum = HNumber::IntegralValue(lhs);
         int64_t rnum = HNumber::IntegralValue(rhs);
 
@@ -550,7 +938,7 @@ char* RuntimeBinOp(Heap* heap, char* lhs, char* rhs) {
 
     if (BinOp::is_negative_eq(type)) result = !result;
 
-    return HBoolean::New(heap, Heap::kTenureNew, result);
+    return HBoolean::New(heap, result);
   } else if (BinOp::is_bool_logic(type)) {
     lhs = RuntimeToBoolean(heap, lhs);
     rhs = RuntimeToBoolean(heap, rhs);
@@ -564,7 +952,7 @@ char* RuntimeBinOp(Heap* heap, char* lhs, char* rhs) {
       UNEXPECTED
     }
 
-    return HBoolean::New(heap, Heap::kTenureNew, result);
+    return HBoolean::New(heap, result);
   } else if (type == BinOp::kAdd &&
              (HValue::GetTag(lhs) == Heap::kTagString ||
               HValue::GetTag(rhs) == Heap::kTagString)) {
@@ -663,6 +1051,48 @@ char* RuntimeKeysof(Heap* heap, char* value) {
   // Fast-case - return empty array
   if (tag != Heap::kTagArray && tag != Heap::kTagObject) return result;
 
+  // Shape knows keys and their order
+  if (tag == Heap::kTagObject && HObject::GetShape(value) != NULL) {
+    Shape* shape = HObject::GetShape(value);
+    for (uint32_t i = 0; i < shape->table_size(); i++) {
+      Shape::Entry* entry = &shape->table()[i];
+      if (entry->key == NULL) continue;
+
+      off_t index = (entry->offset - HMap::kSpaceOffset) /
+                    HValue::kPointerSize;
+      char** slot = HObject::LookupProperty(heap,
+                                            result,
+                                            HNumber::ToPointer(index),
+                                            1);
+      *slot = entry->key;
+      heap->RecordSlot(HObject::Map(result), slot);
+    }
+
+    return result;
+  }
+
+  // Dense array has no keys, return indexes of present elements
+  if (tag == Heap::kTagArray && HArray::IsDense(value)) {
+    HMap* map = HValue::As<HMap>(HObject::Map(value));
+    uint64_t* raw = reinterpret_cast<uint64_t*>(map->space());
+    bool doubles = HArray::Kind(value) == HArray::kDoubleElements;
+
+    uint32_t capacity = HArray::Capacity(value);
+    uint32_t index = 0;
+    for (uint32_t i = 0; i < capacity; i++) {
+      if (doubles ? raw[i] == HArray::kHoleNaN : map->IsEmptySlot(i)) continue;
+
+      char** slot = HObject::LookupProperty(heap,
+                                            result,
+                                            HNumber::ToPointer(index),
+                                            1);
+      *slot = HNumber::ToPointer(i);
+      index++;
+    }
+
+    return result;
+  }
+
   // Slow-case visit all map's slots and put them into array
   HMap* map = HValue::As<HMap>(HObject::Map(value));
 
@@ -675,6 +1105,7 @@ char* RuntimeKeysof(Heap* heap, char* value) {
                                             HNumber::ToPointer(index),
                                             1);
       *slot = map->GetSlot(i)->addr();
+      heap->RecordSlot(HObject::Map(result), slot);
       index++;
     }
   }
@@ -689,12 +1120,16 @@ char* RuntimeCloneObject(Heap* heap, char* obj) {
 
   char* result = heap->AllocateTagged(Heap::kTagObject,
                                       Heap::kTenureNew,
-                                      2 * HValue::kPointerSize);
+                                      3 * HValue::kPointerSize);
 
+  // Dictionary is copied together with its control bytes
   char* map = heap->AllocateTagged(
       Heap::kTagMap,
       Heap::kTenureNew,
-      ((source_map->size() << 1) + 1) * HValue::kPointerSize);
+      source_map->Size() - HValue::kPointerSize);
+  HValue::SetRepresentation(
+      map,
+      HValue::GetRepresentation<HMap::Representation>(source_map->addr()));
 
   // Set mask
   *reinterpret_cast<off_t*>(result + HObject::kMaskOffset) =
@@ -703,29 +1138,60 @@ char* RuntimeCloneObject(Heap* heap, char* obj) {
   // Set map
   *reinterpret_cast<char**>(result + HObject::kMapOffset) = map;
 
+  // Set shape, clone will have the same layout
+  *HObject::ShapeSlot(result) = HObject::GetShape(obj);
+
   // Set map's size
   *reinterpret_cast<off_t*>(map + HMap::kSizeOffset) = source_map->size();
 
-  // Nullify all map's slots (both keys and values)
-  uint32_t size = (source_map->size() << 1) * HValue::kPointerSize;
+  // Copy all map's slots (both keys and values)
+  uint32_t size = source_map->Size() - HMap::kSpaceOffset +
+                  HValue::interior_offset(0);
   memcpy(map + HMap::kSpaceOffset, source_map->space(), size);
 
+  // Big map is allocated in large space and is old already
+  if (HValue::Cast(map)->IsLarge()) {
+    char** space = reinterpret_cast<char**>(map + HMap::kSpaceOffset);
+    for (uint32_t i = 0; i < source_map->size() << 1; i++) {
+      heap->RecordSlot(map, space + i);
+    }
+  }
+
   return result;
 }
 
 
 void RuntimeDeleteProperty(Heap* heap, char* obj, char* property) {
+  // Shapes are only adding keys
+  if (HValue::GetTag(obj) == Heap::kTagObject &&
+      HObject::GetShape(obj) != NULL) {
+    if (RuntimeLookupProperty(heap, obj, property, 0) == Heap::kTagNil) {
+      return;
+    }
+    NormalizeObject(heap, obj);
+  }
+
   off_t offset = RuntimeLookupProperty(heap, obj, property, 0);
+  if (offset == Heap::kTagNil) return;
 
   // Dense arrays doesn't have keys
   if (HValue::GetTag(obj) != Heap::kTagArray || !HArray::IsDense(obj)) {
     // Nil property
     off_t keyoffset = offset - HObject::Mask(obj) - HValue::kPointerSize;
-    *reinterpret_cast<off_t*>(HObject::Map(obj) + keyoffset) = Heap::kTagNil;
+    char** key_slot = reinterpret_cast<char**>(HObject::Map(obj) + keyoffset);
+    heap->WriteBarrier(*key_slot);
+    *key_slot = HNil::New();
+
+    // Probing should continue past the slot
+    HValue::As<HMap>(HObject::Map(obj))->SetControl(
+        (keyoffset - HMap::kSpaceOffset) / HValue::kPointerSize,
+        HMap::kDeletedSlot);
   }
 
   // Nil value
-  *reinterpret_cast<off_t*>(HObject::Map(obj) + offset) = Heap::kTagNil;
+  char** value_slot = reinterpret_cast<char**>(HObject::Map(obj) + offset);
+  heap->WriteBarrier(*value_slot);
+  *value_slot = HNil::New();
 }
 
 
@@ -4,6 +4,7 @@
 #include "heap.h" // Heap, Heap::HeapTag
 #include "heap-inl.h"
 #include "ast.h" // BinOp
+#include "ic.h" // InlineCache
 
 #include <stdint.h> // uint32_t
 #include <sys/types.h> // size_t
@@ -11,14 +12,47 @@
 namespace candor {
 namespace internal {
 
+// Forward declarations
+class CodeSpace;
+class FunctionProfile;
+
 // Wrapper for heap()->new_space()->Allocate()
 typedef char* (*RuntimeAllocateCallback)(Heap* heap,
                                          uint32_t bytes);
 char* RuntimeAllocate(Heap* heap, uint32_t bytes);
 
+// Wrapper for heap()->AllocateTagged(), used when new space page is
+// exhausted, object is too big for it or its site is pretenured.
+// `qtag` is the whole tag word (with generation and allocation site),
+// `bytes` includes tag.
+typedef char* (*RuntimeAllocateTaggedCallback)(Heap* heap,
+                                               off_t qtag,
+                                               uint32_t bytes);
+char* RuntimeAllocateTagged(Heap* heap, off_t qtag, uint32_t bytes);
+
 typedef void (*RuntimeCollectGarbageCallback)(Heap* heap, char* stack_top);
 void RuntimeCollectGarbage(Heap* heap, char* stack_top);
 
+// Called from non-optimized code once function's call counter reaches
+// optimization threshold
+typedef void (*RuntimeOptimizeCallback)(CodeSpace* space,
+                                        FunctionProfile* profile);
+void RuntimeOptimize(CodeSpace* space, FunctionProfile* profile);
+
+// Called from non-optimized code once loop's iteration counter reaches
+// optimization threshold, returns loop's optimized code (or NULL)
+typedef char* (*RuntimeOptimizeLoopCallback)(CodeSpace* space,
+                                             FunctionProfile* profile);
+char* RuntimeOptimizeLoop(CodeSpace* space, FunctionProfile* profile);
+
+// Called from generated code while old space is being marked incrementally
+typedef void (*RuntimeWriteBarrierCallback)(Heap* heap, char* old_value);
+void RuntimeWriteBarrier(Heap* heap, char* old_value);
+
+// Called from generated code when remembered set is full
+typedef void (*RuntimeCompactRememberedSetCallback)(Heap* heap);
+void RuntimeCompactRememberedSet(Heap* heap);
+
 typedef off_t (*RuntimeGetHashCallback)(Heap* heap, char* value);
 off_t RuntimeGetHash(Heap* heap, char* value);
 
@@ -33,6 +67,38 @@ off_t RuntimeLookupProperty(Heap* heap,
                             char* key,
                             off_t insert);
 
+// Called on inline cache miss, does the same lookup and remembers
+// offset for object's shape
+typedef off_t (*RuntimeLookupPropertyICCallback)(Heap* heap,
+                                                 char* obj,
+                                                 char* key,
+                                                 off_t insert,
+                                                 InlineCache* ic);
+off_t RuntimeLookupPropertyIC(Heap* heap,
+                              char* obj,
+                              char* key,
+                              off_t insert,
+                              InlineCache* ic);
+
+// Elements of arrays are loaded and stored according to array's kind
+// (raw doubles are boxed on load), properties of objects are looked up
+typedef char* (*RuntimeLoadElementCallback)(Heap* heap, char* obj, char* key);
+char* RuntimeLoadElement(Heap* heap, char* obj, char* key);
+
+typedef char* (*RuntimeStoreElementCallback)(Heap* heap,
+                                             char* obj,
+                                             char* key,
+                                             char* value);
+char* RuntimeStoreElement(Heap* heap, char* obj, char* key, char* value);
+
+// Called on call inline cache miss, remembers function and its code
+// (code of the first remembered function is put into site's `target`)
+typedef void (*RuntimeUpdateCallICCallback)(Heap* heap,
+                                            char* fn,
+                                            InlineCache* ic,
+                                            char** target);
+void RuntimeUpdateCallIC(Heap* heap, char* fn, InlineCache* ic, char** target);
+
 typedef char* (*RuntimeGrowObjectCallback)(Heap* heap,
                                            char* obj,
                                            uint32_t min_size);
@@ -64,6 +130,7 @@ char* RuntimeSizeof(Heap* heap, char* value);
 typedef char* (*RuntimeKeysofCallback)(Heap* heap, char* value);
 char* RuntimeKeysof(Heap* heap, char* value);
 
+typedef char* (*RuntimeCloneObjectCallback)(Heap* heap, char* obj);
 char* RuntimeCloneObject(Heap* heap, char* obj);
 
 typedef void (*RuntimeDeletePropertyCallback)(Heap* heap,
@@ -19,11 +19,19 @@ namespace internal {
     V(VarArg)\
     V(PutVarArg)\
     V(CollectGarbage)\
+    V(Optimize)\
+    V(OptimizeLoop)\
+    V(WriteBarrier)\
+    V(RecordSlot)\
     V(Throw)\
     V(Typeof)\
     V(Sizeof)\
     V(Keysof)\
     V(LookupProperty)\
+    V(LoadElement)\
+    V(StoreElement)\
+    V(PropertyIC)\
+    V(CallIC)\
     V(CoerceToBoolean)\
     V(CloneObject)\
     V(DeleteProperty)\
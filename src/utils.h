@@ -1,14 +1,16 @@
 #ifndef _SRC_UTILS_H_
 #define _SRC_UTILS_H_
 
-#include <stdlib.h> // NULL
+#include <stdlib.h> // NULL, strtod
 #include <stdarg.h> // va_list
 #include <stdint.h> // uint32_t
 #include <sys/types.h> // off_t
-#include <stdio.h> // vsnprintf
-#include <string.h> // strncmp, memset
+#include <stdio.h> // vsnprintf, snprintf
+#include <string.h> // strncmp, memset, memcpy
 #include <unistd.h> // sysconf or getpagesize
+#include <sys/time.h> // gettimeofday
 #include <assert.h> // assert
+#include <math.h> // signbit
 
 namespace candor {
 namespace internal {
@@ -728,28 +730,169 @@ inline int64_t StringToInt(const char* value, uint32_t length) {
 }
 
 
+// Powers of ten up to 1e22 are exact doubles
+inline double ExactPowerOfTen(uint32_t exp) {
+  static const double powers[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+  };
+
+  assert(exp < sizeof(powers) / sizeof(powers[0]));
+  return powers[exp];
+}
+
+
+// Parse `[-]digits[.digits]` prefix of the string. Values with up to 19
+// significant digits and 22 fractional ones are exact doubles divided by an
+// exact power of ten - that's a single correctly rounded operation, only
+// longer numbers are handed to strtod.
 inline double StringToDouble(const char* value, uint32_t length) {
-  double integral = 0;
-  double floating = 0;
   bool sign = false;
+  uint32_t start = StringGetNumSign(value, length, &sign);
 
-  uint32_t index = StringGetNumSign(value, length, &sign);
+  uint64_t mantissa = 0;
+  uint32_t digits = 0;
+  uint32_t fraction = 0;
+  bool dot = false;
+
+  uint32_t index = start;
   for (; index < length; index++) {
-    if (value[index] == '.') break;
+    if (value[index] == '.' && !dot) {
+      dot = true;
+      continue;
+    }
     if (!is_num(value[index])) break;
-    integral *= 10;
-    integral += value[index] - '0';
+
+    // Leading zeroes are not significant
+    if (mantissa == 0 && value[index] == '0') {
+      if (dot) fraction++;
+      continue;
+    }
+
+    mantissa = mantissa * 10 + (value[index] - '0');
+    digits++;
+    if (dot) fraction++;
+    if (digits > 19) break;
+  }
+
+  double result;
+  if (digits <= 19 &&
+      fraction <= 22 &&
+      mantissa <= (static_cast<uint64_t>(1) << 53)) {
+    result = static_cast<double>(mantissa) / ExactPowerOfTen(fraction);
+  } else {
+    // Slow case: copy number and let libc round it
+    for (; index < length; index++) {
+      if (!is_num(value[index]) && value[index] != '.') break;
+    }
+
+    char buffer[128];
+    uint32_t size = index - start;
+    char* number = size < sizeof(buffer) ? buffer : new char[size + 1];
+    memcpy(number, value + start, size);
+    number[size] = 0;
+    result = strtod(number, NULL);
+    if (number != buffer) delete[] number;
+  }
+
+  return sign ? -result : result;
+}
+
+
+// Write decimal digits of the value, returns number of written chars
+// (at most 20)
+inline uint32_t IntToString(int64_t value, char* out) {
+  static const char pairs[] =
+      "00010203040506070809101112131415161718192021222324252627282930313233"
+      "34353637383940414243444546474849505152535455565758596061626364656667"
+      "6869707172737475767778798081828384858687888990919293949596979899";
+
+  uint64_t abs = value < 0 ? -static_cast<uint64_t>(value) : value;
+  char digits[20];
+  uint32_t pos = sizeof(digits);
+
+  // Two digits at a time
+  while (abs >= 100) {
+    uint32_t pair = (abs % 100) << 1;
+    abs /= 100;
+    digits[--pos] = pairs[pair + 1];
+    digits[--pos] = pairs[pair];
+  }
+  if (abs >= 10) {
+    uint32_t pair = abs << 1;
+    digits[--pos] = pairs[pair + 1];
+    digits[--pos] = pairs[pair];
+  } else {
+    digits[--pos] = '0' + abs;
   }
 
-  if (index < length && value[index] == '.') {
-    for (uint32_t i = length - 1; i > index; i--) {
-      if (!is_num(value[i])) break;
-      floating += value[i] - '0';
-      floating /= 10;
+  uint32_t len = 0;
+  if (value < 0) out[len++] = '-';
+  memcpy(out + len, digits + pos, sizeof(digits) - pos);
+
+  return len + sizeof(digits) - pos;
+}
+
+
+// Write shortest representation of the value that is parsed back into the
+// same double (at least 15 significant digits are written for values that
+// aren't short decimals), returns number of written chars (at most 32)
+inline uint32_t DoubleToString(double value, char* out) {
+  // Negative zero has no integer counterpart
+  if (value == 0 && signbit(value)) {
+    out[0] = '-';
+    out[1] = '0';
+    return 2;
+  }
+
+  // Integral values print like integers
+  if (value > -9007199254740992.0 &&
+      value < 9007199254740992.0 &&
+      value == static_cast<int64_t>(value)) {
+    return IntToString(static_cast<int64_t>(value), out);
+  }
+
+  // Values with a few fractional digits are integers divided by a power
+  // of ten, print the smallest such integer with a decimal point in it
+  for (uint32_t exp = 1; exp <= 15; exp++) {
+    double scaled = value * ExactPowerOfTen(exp);
+    if (scaled <= -9007199254740992.0 || scaled >= 9007199254740992.0) break;
+
+    int64_t integral = static_cast<int64_t>(scaled < 0 ?
+                                            scaled - 0.5 :
+                                            scaled + 0.5);
+    if (integral / ExactPowerOfTen(exp) != value) continue;
+
+    char digits[24];
+    uint32_t count = IntToString(integral < 0 ? -integral : integral, digits);
+    uint32_t len = 0;
+
+    if (value < 0) out[len++] = '-';
+    if (count <= exp) {
+      out[len++] = '0';
+      out[len++] = '.';
+      for (uint32_t i = count; i < exp; i++) out[len++] = '0';
+      memcpy(out + len, digits, count);
+      len += count;
+    } else {
+      memcpy(out + len, digits, count - exp);
+      len += count - exp;
+      out[len++] = '.';
+      memcpy(out + len, digits + count - exp, exp);
+      len += exp;
     }
+
+    return len;
   }
 
-  return sign ? -(integral + floating) : integral + floating;
+  // 17 digits are always enough, but most values need less
+  int len = 0;
+  for (int precision = 15; precision <= 17; precision++) {
+    len = snprintf(out, 32, "%.*g", precision, value);
+    if (value != value || strtod(out, NULL) == value) break;
+  }
+
+  return len;
 }
 
 
@@ -830,6 +973,12 @@ inline uint32_t GetPageSize() {
 #endif
 }
 
+inline uint64_t GetTimeMicroseconds() {
+  timeval tv;
+  gettimeofday(&tv, NULL);
+  return static_cast<uint64_t>(tv.tv_sec) * 1000000 + tv.tv_usec;
+}
+
 } // namespace internal
 } // namespace candor
 
@@ -47,7 +47,7 @@ inline void Assembler::emit_rexw(Register dst) {
 
 
 inline void Assembler::emit_rexw(Operand& dst) {
-  emitb(0x48 | dst.base().high() << 2);
+  emitb(0x48 | dst.base().high());
 }
 
 
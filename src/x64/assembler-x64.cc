@@ -147,7 +147,7 @@ void Assembler::cmpb(Register dst, Operand& src) {
 
 void Assembler::cmpb(Register dst, Immediate src) {
   emit_rexw(rax, dst);
-  emitb(0x3A);
+  emitb(0x80);
   emit_modrm(dst, 7);
   emitb(src.value());
 }
@@ -208,6 +208,13 @@ void Assembler::jmp(Condition cond, Label* label) {
 }
 
 
+void Assembler::jmp(Register dst) {
+  emit_rexw(rax, dst);
+  emitb(0xFF);
+  emit_modrm(dst, 4);
+}
+
+
 void Assembler::movq(Register dst, Register src) {
   emit_rexw(dst, src);
   emitb(0x8B);
@@ -332,6 +339,13 @@ void Assembler::subq(Register dst, Immediate src) {
 }
 
 
+void Assembler::subq(Operand& dst, Register src) {
+  emit_rexw(src, dst);
+  emitb(0x29);
+  emit_modrm(src, dst);
+}
+
+
 void Assembler::imulq(Register src) {
   emit_rexw(rax, src);
   emitb(0xF7);
@@ -339,6 +353,14 @@ void Assembler::imulq(Register src) {
 }
 
 
+void Assembler::imulq(Register dst, Register src) {
+  emit_rexw(dst, src);
+  emitb(0x0F);
+  emitb(0xAF);
+  emit_modrm(dst, src);
+}
+
+
 void Assembler::idivq(Register src) {
   emit_rexw(rax, src);
   emitb(0xF7);
@@ -388,6 +410,13 @@ void Assembler::inc(Register dst) {
 }
 
 
+void Assembler::inc(Operand& dst) {
+  emit_rexw(rax, dst);
+  emitb(0xFF);
+  emit_modrm(dst, 0x00);
+}
+
+
 void Assembler::dec(Register dst) {
   emit_rexw(rax, dst);
   emitb(0xFF);
@@ -455,6 +484,22 @@ void Assembler::sar(Register dst, Immediate src) {
 }
 
 
+void Assembler::rol(Register dst, Immediate src) {
+  emit_rexw(rax, dst);
+  emitb(0xC1);
+  emit_modrm(dst, 0x00);
+  emitb(src.value());
+}
+
+
+void Assembler::ror(Register dst, Immediate src) {
+  emit_rexw(rax, dst);
+  emitb(0xC1);
+  emit_modrm(dst, 0x01);
+  emitb(src.value());
+}
+
+
 void Assembler::sal(Register dst) {
   emit_rexw(rcx, dst);
   emitb(0xD3);
@@ -469,6 +514,14 @@ void Assembler::sar(Register dst) {
 }
 
 
+void Assembler::bsfq(Register dst, Register src) {
+  emit_rexw(dst, src);
+  emitb(0x0F);
+  emitb(0xBC);
+  emit_modrm(dst, src);
+}
+
+
 void Assembler::callq(Register dst) {
   emit_rexw(rax, dst);
   emitb(0xFF);
@@ -593,5 +646,44 @@ void Assembler::ucomisd(DoubleRegister dst, DoubleRegister src) {
   emit_modrm(dst, src);
 }
 
+
+void Assembler::movdqu(DoubleRegister dst, Operand& src) {
+  emitb(0xF3);
+  emit_rexw(dst, src);
+  emitb(0x0F);
+  emitb(0x6F);
+  emit_modrm(dst, src);
+}
+
+
+void Assembler::pcmpeqb(DoubleRegister dst, DoubleRegister src) {
+  emitb(0x66);
+  emit_rexw(dst, src);
+  emitb(0x0F);
+  emitb(0x74);
+  emit_modrm(dst, src);
+}
+
+
+void Assembler::pmovmskb(Register dst, DoubleRegister src) {
+  emitb(0x66);
+  emit_rexw(dst, src);
+  emitb(0x0F);
+  emitb(0xD7);
+  emit_modrm(dst, src);
+}
+
+
+void Assembler::pshufd(DoubleRegister dst,
+                       DoubleRegister src,
+                       Immediate order) {
+  emitb(0x66);
+  emit_rexw(dst, src);
+  emitb(0x0F);
+  emitb(0x70);
+  emit_modrm(dst, src);
+  emitb(order.value());
+}
+
 } // namespace internal
 } // namespace candor
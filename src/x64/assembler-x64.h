@@ -248,6 +248,7 @@ class Assembler {
   void bind(Label* label);
   void jmp(Label* label);
   void jmp(Condition cond, Label* label);
+  void jmp(Register dst);
 
   void cmpq(Register dst, Register src);
   void cmpq(Register dst, Operand& src);
@@ -279,7 +280,9 @@ class Assembler {
   void addq(Register dst, Immediate src);
   void subq(Register dst, Register src);
   void subq(Register dst, Immediate src);
+  void subq(Operand& dst, Register src);
   void imulq(Register src);
+  void imulq(Register dst, Register src);
   void idivq(Register src);
 
   void andq(Register dst, Register src);
@@ -289,6 +292,7 @@ class Assembler {
   void xorl(Register dst, Register src);
 
   void inc(Register dst);
+  void inc(Operand& dst);
   void dec(Register dst);
   void shl(Register dst, Immediate src);
   void shr(Register dst, Immediate src);
@@ -300,6 +304,9 @@ class Assembler {
   void sar(Register dst, Immediate src);
   void sal(Register dst);
   void sar(Register dst);
+  void rol(Register dst, Immediate src);
+  void ror(Register dst, Immediate src);
+  void bsfq(Register dst, Register src);
 
   void callq(Register dst);
   void callq(Operand& dst);
@@ -319,6 +326,12 @@ class Assembler {
   void roundsd(DoubleRegister dst, DoubleRegister src, RoundMode mode);
   void ucomisd(DoubleRegister dst, DoubleRegister src);
 
+  // Packed byte instructions
+  void movdqu(DoubleRegister dst, Operand& src);
+  void pcmpeqb(DoubleRegister dst, DoubleRegister src);
+  void pmovmskb(Register dst, DoubleRegister src);
+  void pshufd(DoubleRegister dst, DoubleRegister src, Immediate order);
+
   // Routines
   inline void emit_rex_if_high(Register src);
   inline void emit_rexw(Register dst);
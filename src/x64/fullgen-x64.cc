@@ -7,6 +7,7 @@
 #include "ast.h" // AstNode
 #include "zone.h" // ZoneObject
 #include "stubs.h" // Stubs
+#include "optimizer.h" // Optimizer, FunctionProfile
 #include "utils.h" // List
 
 #include <assert.h>
@@ -60,8 +61,8 @@ void Fullgen::InitRoots() {
   root_context()->Push(HObject::NewEmpty(heap()));
 
   // Place some root values
-  root_context()->Push(HBoolean::New(heap(), Heap::kTenureOld, true));
-  root_context()->Push(HBoolean::New(heap(), Heap::kTenureOld, false));
+  root_context()->Push(HBoolean::New(heap(), true));
+  root_context()->Push(HBoolean::New(heap(), false));
 
   // Place types
   root_context()->Push(HString::New(heap(), Heap::kTenureOld, "nil", 3));
@@ -80,6 +81,10 @@ void Fullgen::CandorFunction::Generate() {
     fullgen()->source_map()->Push(fullgen()->offset(), fn()->offset());
   }
 
+  // Types seen by function's sites
+  feedback_ = fullgen()->heap()->feedback()->New(fn()->offset(),
+                                                 fullgen()->offset());
+
   // Generate function's body
   fullgen()->GeneratePrologue(fn());
   fullgen()->VisitChildren(fn());
@@ -122,9 +127,28 @@ void Fullgen::Generate(AstNode* ast) {
 void Fullgen::GeneratePrologue(AstNode* stmt) {
   // rdi <- reference to parent context (zero for main)
   // rsi <- unboxed arguments count (tagged)
+  FunctionProfile* profile = space_->optimizer()->New(
+      FunctionLiteral::Cast(stmt),
+      offset());
+
   push(rbp);
   movq(rbp, rsp);
 
+  // Count calls and recompile function once it's hot
+  // (entry will be overwritten with jump to optimized code)
+  if (profile != NULL) {
+    Label cold(this);
+    Operand calls(rax, FunctionProfile::kCallsOffset);
+
+    movq(rax, Immediate(reinterpret_cast<uint64_t>(profile)));
+    inc(calls);
+    cmpq(calls, Immediate(space_->optimizer()->threshold()));
+    jmp(kNe, &cold);
+    Call(stubs()->GetOptimizeStub());
+    bind(&cold);
+    xorq(rax, rax);
+  }
+
   // Allocate space for spill slots and on-stack variables
   AllocateSpills(stmt->stack_slots());
 
@@ -369,10 +393,51 @@ AstNode* Fullgen::VisitCall(AstNode* stmt) {
 
   Spill rax_s(this, rax);
 
+  // Functions that were already called here are known to be callable,
+  // everything else is checked and then remembered by the stub
+  InlineCache* ic = heap()->ics()->New(InlineCache::kCall, stmt->offset());
+  FeedbackSlot* feedback = current_function()->feedback()->New(
+      FeedbackSlot::kCall,
+      stmt->offset());
+  feedback->ic(ic);
+  Label known(this), checked(this), miss(this);
+
+  IsUnboxed(rax, NULL, &miss);
+
+  movq(scratch, Immediate(reinterpret_cast<uint64_t>(ic)));
+  for (uint32_t i = 0; i < InlineCache::kMaxEntries; i++) {
+    Operand key(scratch,
+                InlineCache::kEntriesOffset + i * sizeof(InlineCache::Entry));
+    cmpq(rax, key);
+    jmp(kEq, &known);
+  }
+  xorq(scratch, scratch);
+
+  // Known callees were recorded on their first miss
+  bind(&miss);
+  RecordTypes(feedback, rax, reg_nil);
+
   IsUnboxed(rax, NULL, &not_function);
   IsNil(rax, NULL, &not_function);
   IsHeapObject(Heap::kTagFunction, rax, &not_function, NULL);
 
+  // rcx <- address of direct call's target (it is emitted below)
+  movq(rbx, Immediate(reinterpret_cast<uint64_t>(ic)));
+  movq(rcx, Immediate(0));
+  RelocationInfo* target = new RelocationInfo(RelocationInfo::kAbsolute,
+                                              RelocationInfo::kQuad,
+                                              offset() - 8);
+  relocation_info_.Push(target);
+  Call(stubs()->GetCallICStub());
+  jmp(&checked);
+
+  bind(&known);
+  Operand qhits(scratch, InlineCache::kHitsOffset);
+  inc(qhits);
+  xorq(scratch, scratch);
+
+  bind(&checked);
+
   Spill rsi_s(this, rsi), rdi_s(this, rdi), root_s(this, root_reg);
 
   Spill stack_s(this, rsp);
@@ -445,7 +510,29 @@ AstNode* Fullgen::VisitCall(AstNode* stmt) {
 
     // Generate calling code
     rax_s.Unspill();
+
+    // The first cached function is called directly, its code is put into
+    // the site when it's remembered (everything else, including
+    // bindings, goes through function's code slot)
+    Label generic(this), called(this);
+    Operand first(scratch, InlineCache::kEntriesOffset);
+    Operand context_slot(rax, HFunction::kParentOffset);
+    Operand root_slot(rax, HFunction::kRootOffset);
+
+    movq(scratch, Immediate(reinterpret_cast<uint64_t>(ic)));
+    cmpq(rax, first);
+    jmp(kNe, &generic);
+
+    movq(rdi, context_slot);
+    movq(root_reg, root_slot);
+    movq(scratch, Immediate(0));
+    target->target(offset() - 8);
+    Call(scratch);
+    jmp(&called);
+
+    bind(&generic);
     CallFunction(rax);
+    bind(&called);
   }
 
   // Unwind stack
@@ -472,8 +559,70 @@ AstNode* Fullgen::VisitCall(AstNode* stmt) {
 
 
 AstNode* Fullgen::VisitAssign(AstNode* stmt) {
+  AstNode* member = stmt->lhs();
+
   Label done(this);
 
+  // Array elements are stored by stub, it keeps kind of elements
+  if (member->is(AstNode::kMember) &&
+      !member->rhs()->is(AstNode::kString) &&
+      !member->rhs()->is(AstNode::kProperty)) {
+    Label property(this);
+
+    VisitFor(kValue, stmt->rhs());
+    Spill value_s(this, rax);
+
+    VisitFor(kValue, member->lhs());
+    Spill object_s(this, rax);
+
+    VisitFor(kValue, member->rhs());
+    movq(rbx, rax);
+    object_s.Unspill(rax);
+
+    int32_t offset = member->offset() == -1 ? member->rhs()->offset() :
+                                              member->offset();
+    FeedbackSlot* feedback = current_function()->feedback()->New(
+        FeedbackSlot::kProperty,
+        offset);
+    RecordTypes(feedback, rax, rbx);
+
+    IsUnboxed(rax, NULL, &property);
+    IsNil(rax, NULL, &property);
+    IsHeapObject(Heap::kTagArray, rax, &property, NULL);
+
+    value_s.Unspill(rcx);
+    Call(stubs()->GetStoreElementStub());
+    CheckGC();
+    jmp(&done);
+
+    // Properties of objects are stored into slots
+    bind(&property);
+    movq(rcx, Immediate(1));
+    Call(stubs()->GetLookupPropertyStub());
+
+    // Make rax look like unboxed number to GC
+    dec(rax);
+    CheckGC();
+    inc(rax);
+
+    IsNil(rax, NULL, &done);
+
+    Operand slot(rax, 0);
+    object_s.Unspill(rbx);
+    Operand qmap(rbx, HObject::kMapOffset);
+    addq(rax, qmap);
+
+    WriteBarrier(slot);
+    value_s.Unspill(scratch);
+    movq(slot, scratch);
+    RecordSlot(slot, scratch);
+
+    bind(&done);
+    value_s.Unspill(rax);
+
+    return stmt;
+  }
+
   // Get value of right-hand side expression in rbx
   VisitFor(kValue, stmt->rhs());
   Spill rax_s(this, rax);
@@ -486,11 +635,20 @@ AstNode* Fullgen::VisitAssign(AstNode* stmt) {
   // If slot's base is nil - just return value
   if (!slot().base().is(rbp)) {
     IsNil(slot().base(), NULL, &done);
+
+    // Stack slots are scanned as roots, all others need barrier
+    WriteBarrier(slot());
+    rax_s.Unspill(scratch);
   }
 
   // Put value into slot
   movq(slot(), scratch);
 
+  if (!slot().base().is(rbp)) {
+    RecordSlot(slot(), scratch);
+    rax_s.Unspill(scratch);
+  }
+
   // Propagate result of assign operation
   bind(&done);
   movq(rax, scratch);
@@ -576,16 +734,89 @@ AstNode* Fullgen::VisitMember(AstNode* node) {
   movq(rbx, rax);
   rax_s.Unspill(rax);
 
-  movq(rcx, Immediate(visiting_for_slot()));
-  Call(stubs()->GetLookupPropertyStub());
+  // Members of object literals have no position - use key's one
+  int32_t offset = node->offset() == -1 ? node->rhs()->offset() :
+                                          node->offset();
+  Label done(this);
+
+  if (node->rhs()->is(AstNode::kString) ||
+      node->rhs()->is(AstNode::kProperty)) {
+    // Key is constant, cache offsets for shapes of objects
+    InlineCache* ic = heap()->ics()->New(InlineCache::kProperty, offset);
+    FeedbackSlot* feedback = current_function()->feedback()->New(
+        FeedbackSlot::kProperty,
+        offset);
+    feedback->ic(ic);
+    Label miss(this), hit(this), lookup_done(this);
+
+    IsUnboxed(rax, NULL, &miss);
+    IsNil(rax, NULL, &miss);
+    IsHeapObject(Heap::kTagObject, rax, &miss, NULL);
+
+    Operand qshape(rax, HObject::kShapeOffset);
+    movq(rcx, qshape);
+    cmpq(rcx, Immediate(0));
+    jmp(kEq, &miss);
+
+    movq(scratch, Immediate(reinterpret_cast<uint64_t>(ic)));
+    for (uint32_t i = 0; i < InlineCache::kMaxEntries; i++) {
+      Label next(this);
+      int disp = InlineCache::kEntriesOffset + i * sizeof(InlineCache::Entry);
+      Operand key(scratch, disp);
+      Operand value(scratch, disp + HValue::kPointerSize);
+
+      cmpq(rcx, key);
+      jmp(kNe, &next);
+      movq(rax, value);
+      jmp(&hit);
+      bind(&next);
+    }
+
+    // Shapes that hit were recorded on their first miss
+    bind(&miss);
+    RecordTypes(feedback, rax, rbx);
+    movq(rcx, Immediate(visiting_for_slot()));
+    movq(rdx, Immediate(reinterpret_cast<uint64_t>(ic)));
+    Call(stubs()->GetPropertyICStub());
+    jmp(&lookup_done);
+
+    bind(&hit);
+    Operand qhits(scratch, InlineCache::kHitsOffset);
+    inc(qhits);
+    xorq(scratch, scratch);
+
+    bind(&lookup_done);
+    xorq(rcx, rcx);
+  } else {
+    FeedbackSlot* feedback = current_function()->feedback()->New(
+        FeedbackSlot::kProperty,
+        offset);
+    RecordTypes(feedback, rax, rbx);
+
+    // Array elements are loaded by stub, raw doubles are boxed
+    if (visiting_for_value()) {
+      Label property(this);
+
+      IsUnboxed(rax, NULL, &property);
+      IsNil(rax, NULL, &property);
+      IsHeapObject(Heap::kTagArray, rax, &property, NULL);
+
+      Call(stubs()->GetLoadElementStub());
+      CheckGC();
+      jmp(&done);
+
+      bind(&property);
+    }
+
+    movq(rcx, Immediate(visiting_for_slot()));
+    Call(stubs()->GetLookupPropertyStub());
+  }
 
   // Make rax look like unboxed number to GC
   dec(rax);
   CheckGC();
   inc(rax);
 
-  Label done(this);
-
   IsNil(rax, NULL, &done);
 
   rax_s.Unspill(rbx);
@@ -642,7 +873,9 @@ AstNode* Fullgen::VisitString(AstNode* node) {
   uint32_t length;
   const char* unescaped = Unescape(node->value(), node->length(), &length);
 
-  PlaceInRoot(HString::New(heap(), Heap::kTenureOld, unescaped, length));
+  // Literals are deduplicated, property names among them are compared
+  // by pointers
+  PlaceInRoot(heap()->strings()->Intern(heap(), unescaped, length));
 
   delete unescaped;
 
@@ -656,6 +889,141 @@ AstNode* Fullgen::VisitProperty(AstNode* node) {
 }
 
 
+// Binary operations have no position, use the first one of their operands
+static int32_t BinOpOffset(AstNode* node) {
+  if (node->offset() != -1) return node->offset();
+
+  AstList::Item* item = node->children()->head();
+  for (; item != NULL; item = item->next()) {
+    int32_t offset = BinOpOffset(item->value());
+    if (offset != -1) return offset;
+  }
+
+  return -1;
+}
+
+
+// Condition that is true when comparison isn't
+static BinOp::BinOpType NegateComparison(BinOp::BinOpType type) {
+  switch (type) {
+   case BinOp::kStrictEq: return BinOp::kStrictNe;
+   case BinOp::kEq: return BinOp::kNe;
+   case BinOp::kStrictNe: return BinOp::kStrictEq;
+   case BinOp::kNe: return BinOp::kEq;
+   case BinOp::kLt: return BinOp::kGe;
+   case BinOp::kGt: return BinOp::kLe;
+   case BinOp::kLe: return BinOp::kGt;
+   case BinOp::kGe: return BinOp::kLt;
+   default: UNEXPECTED
+  }
+
+  // Just to shut up compiler
+  return type;
+}
+
+
+void Fullgen::VisitCondition(AstNode* expr, Label* fail) {
+  if (!expr->is(AstNode::kBinOp) ||
+      !BinOp::is_logic(BinOp::Cast(expr)->subtype())) {
+    Label coerce(this), done(this);
+    Operand truev(root_reg, HContext::GetIndexDisp(Heap::kRootTrueIndex));
+    Operand falsev(root_reg, HContext::GetIndexDisp(Heap::kRootFalseIndex));
+
+    VisitFor(kValue, expr);
+
+    // Booleans are canonical, integers are true unless zero
+    cmpq(rax, truev);
+    jmp(kEq, &done);
+    cmpq(rax, falsev);
+    jmp(kEq, fail);
+
+    IsUnboxed(rax, &coerce, NULL);
+    cmpq(rax, Immediate(HNumber::Tag(0)));
+    jmp(kEq, fail);
+    jmp(&done);
+
+    bind(&coerce);
+    Call(stubs()->GetCoerceToBooleanStub());
+
+    IsTrue(rax, fail, NULL);
+
+    bind(&done);
+    return;
+  }
+
+  // Unboxed integers are compared inline (tagging keeps their order),
+  // everything else is compared by stub which returns boolean
+  BinOp* op = BinOp::Cast(expr);
+  AstNode* rhs = op->rhs();
+  Condition failed = BinOpToCondition(NegateComparison(op->subtype()),
+                                      kIntegral);
+  Label call_stub(this), done(this);
+
+  FeedbackSlot* feedback = current_function()->feedback()->New(
+      FeedbackSlot::kBinOp,
+      BinOpOffset(expr));
+  feedback->op(op->subtype());
+
+  Operand flag(scratch, 0);
+  uint64_t flag_addr = reinterpret_cast<uint64_t>(feedback) +
+                       FeedbackSlot::kTypesOffset;
+
+  VisitFor(kValue, op->lhs());
+
+  int64_t num = 0;
+  bool is_const = rhs->is(AstNode::kNumber) &&
+                  !StringIsDouble(rhs->value(), rhs->length());
+  if (is_const) {
+    num = HNumber::Tag(StringToInt(rhs->value(), rhs->length()));
+
+    // cmpq supports only long immediate (not quad)
+    is_const = num >= -0x7fffffff && num <= 0x7fffffff;
+  }
+
+  if (is_const) {
+    IsUnboxed(rax, &call_stub, NULL);
+
+    // Both operands are integers
+    movq(scratch, Immediate(flag_addr));
+    movb(flag, Immediate(1));
+    xorq(scratch, scratch);
+
+    cmpq(rax, Immediate(num));
+    jmp(failed, fail);
+    jmp(&done);
+
+    bind(&call_stub);
+    movq(rbx, Immediate(num));
+  } else {
+    Spill rax_s(this, rax);
+    VisitFor(kValue, rhs);
+    movq(rbx, rax);
+    rax_s.Unspill(rax);
+
+    movq(scratch, rax);
+    orq(scratch, rbx);
+    IsUnboxed(scratch, &call_stub, NULL);
+
+    movq(scratch, Immediate(flag_addr));
+    movb(flag, Immediate(1));
+    xorq(scratch, scratch);
+
+    cmpq(rax, rbx);
+    jmp(failed, fail);
+    jmp(&done);
+
+    bind(&call_stub);
+  }
+
+  RecordTypes(feedback, rax, rbx);
+  Call(GetBinOpStub(op->subtype()));
+
+  IsTrue(rax, fail, NULL);
+
+  bind(&done);
+}
+
+
 AstNode* Fullgen::VisitIf(AstNode* node) {
   Label fail_body(this), done(this);
 
@@ -665,11 +1033,7 @@ AstNode* Fullgen::VisitIf(AstNode* node) {
   AstNode* fail = NULL;
   if (fail_item != NULL) fail = fail_item->value();
 
-  VisitFor(kValue, expr);
-
-  Call(stubs()->GetCoerceToBooleanStub());
-
-  IsTrue(rax, &fail_body, NULL);
+  VisitCondition(expr, &fail_body);
 
   VisitFor(kValue, success);
 
@@ -692,13 +1056,45 @@ AstNode* Fullgen::VisitWhile(AstNode* node) {
 
   LoopVisitor visitor(this, &loop_start, &loop_end);
 
-  bind(&loop_start);
+  FunctionProfile* profile = space_->optimizer()->NewLoop(
+      current_function()->fn(),
+      node);
 
-  VisitFor(kValue, expr);
+  bind(&loop_start);
 
-  Call(stubs()->GetCoerceToBooleanStub());
+  // Count iterations and switch to optimized code of loop once it's hot
+  // (on-stack replacement), next runs of loop are entering it at once
+  if (profile != NULL) {
+    Label cold(this), enter(this), call(this);
+    Operand iterations(rax, FunctionProfile::kCallsOffset);
+    Operand loop_code(rax, FunctionProfile::kLoopCodeOffset);
+
+    movq(rax, Immediate(reinterpret_cast<uint64_t>(profile)));
+    cmpq(loop_code, Immediate(0));
+    jmp(kNe, &enter);
+    inc(iterations);
+    cmpq(iterations, Immediate(space_->optimizer()->threshold()));
+    jmp(kNe, &cold);
+
+    // rax <- loop's code (zero if loop can't be optimized)
+    Call(stubs()->GetOptimizeLoopStub());
+    cmpq(rax, Immediate(0));
+    jmp(kEq, &cold);
+    jmp(&call);
+
+    bind(&enter);
+    movq(rax, loop_code);
+
+    // Optimized loop takes variables from the frame and puts them back
+    bind(&call);
+    Call(rax);
+    jmp(&loop_end);
+
+    bind(&cold);
+    xorq(rax, rax);
+  }
 
-  IsTrue(rax, &loop_end, NULL);
+  VisitCondition(expr, &loop_end);
 
   VisitFor(kValue, body);
 
@@ -756,10 +1152,14 @@ AstNode* Fullgen::VisitObjectLiteral(AstNode* node) {
 
   ObjectLiteral* obj = ObjectLiteral::Cast(node);
 
-  // Ensure that map will be filled only by half at maximum
-  movq(rbx,
-       Immediate(HNumber::Tag(PowerOfTwo(node->children()->length() << 1))));
-  AllocateObjectLiteral(Heap::kTagObject, rbx, rdx);
+  // Map will contain only values (two per unit of size)
+  uint32_t size = (obj->keys()->length() + 1) >> 1;
+  if (size < HObject::kInitialSize) size = HObject::kInitialSize;
+  movq(rbx, Immediate(HNumber::Tag(size)));
+  AllocateObjectLiteral(Heap::kTagObject,
+                        rbx,
+                        rdx,
+                        heap()->NewAllocationSite());
 
   Spill rdx_s(this, rdx);
 
@@ -794,10 +1194,14 @@ AstNode* Fullgen::VisitArrayLiteral(AstNode* node) {
     return node;
   }
 
-  // Ensure that map will be filled only by half at maximum
+  // Elements are occupying the whole map (keys and values), ensure that
+  // it will be filled only by half at maximum
   movq(rbx,
-       Immediate(HNumber::Tag(PowerOfTwo(node->children()->length() << 1))));
-  AllocateObjectLiteral(Heap::kTagArray, rbx, rdx);
+       Immediate(HNumber::Tag(PowerOfTwo(node->children()->length()))));
+  AllocateObjectLiteral(Heap::kTagArray,
+                        rbx,
+                        rdx,
+                        heap()->NewAllocationSite());
 
   Spill rdx_s(this, rdx);
 
@@ -1058,50 +1462,157 @@ AstNode* Fullgen::VisitUnOp(AstNode* node) {
 
 AstNode* Fullgen::VisitBinOp(AstNode* node) {
   BinOp* op = BinOp::Cast(node);
+  BinOp::BinOpType type = op->subtype();
 
   if (visiting_for_slot()) {
     Throw(Heap::kErrorIncorrectLhs);
     return node;
   }
 
-  VisitFor(kValue, op->lhs());
-
   Label call_stub(this), done(this);
 
   AstNode* rhs = op->rhs();
 
-  // Fast case : unboxed +/- const
-  if (rhs->is(AstNode::kNumber) &&
-      !StringIsDouble(rhs->value(), rhs->length()) &&
-      (op->subtype() == BinOp::kAdd || op->subtype() == BinOp::kSub)) {
+  FeedbackSlot* feedback = current_function()->feedback()->New(
+      FeedbackSlot::kBinOp,
+      BinOpOffset(node));
+  feedback->op(type);
 
-    IsUnboxed(rax, &call_stub, NULL);
+  // Integer arithmetic is inlined, everything else is done by stub
+  bool is_unboxed = type == BinOp::kAdd || type == BinOp::kSub ||
+                    type == BinOp::kMul || BinOp::is_binary(type);
 
-    int64_t num = HNumber::Tag(StringToInt(rhs->value(), rhs->length()));
+  // Integer constant on the right side doesn't need checks
+  bool is_const = is_unboxed &&
+                  rhs->is(AstNode::kNumber) &&
+                  !StringIsDouble(rhs->value(), rhs->length());
+  int64_t num = 0;
 
-    // addq and subq supports only long immediate (not quad)
-    if (num >= -0x7fffffff && num <= 0x7fffffff) {
-      switch (op->subtype()) {
-       case BinOp::kAdd: addq(rax, Immediate(num)); break;
-       case BinOp::kSub: subq(rax, Immediate(num)); break;
-       default:
-        UNEXPECTED
-        break;
-      }
+  VisitFor(kValue, op->lhs());
 
-      jmp(kNoOverflow, &done);
+  // rax <- lhs, rbx <- rhs
+  if (is_const) {
+    num = HNumber::Tag(StringToInt(rhs->value(), rhs->length()));
+    movq(rbx, Immediate(num));
+  } else {
+    Spill rax_s(this, rax);
+    VisitFor(kValue, rhs);
+    movq(rbx, rax);
+    rax_s.Unspill(rax);
+  }
+
+  // Fast case: both are unboxed, results that don't fit (and operations
+  // with results that aren't integers) are going to stub
+  if (is_unboxed) {
+    if (is_const) {
+      IsUnboxed(rax, &call_stub, NULL);
+    } else {
+      movq(scratch, rax);
+      orq(scratch, rbx);
+      IsUnboxed(scratch, &call_stub, NULL);
+    }
 
-      // Restore on overflow
-      switch (op->subtype()) {
-       case BinOp::kAdd: subq(rax, Immediate(num)); break;
-       case BinOp::kSub: addq(rax, Immediate(num)); break;
-       default:
-        UNEXPECTED
-        break;
+    // Both operands are integers
+    Operand flag(scratch, 0);
+    movq(scratch, Immediate(reinterpret_cast<uint64_t>(feedback) +
+                            FeedbackSlot::kTypesOffset));
+    movb(flag, Immediate(1));
+    xorq(scratch, scratch);
+
+    switch (type) {
+     case BinOp::kAdd:
+      addq(rax, rbx);
+      jmp(kNoOverflow, &done);
+      subq(rax, rbx);
+      jmp(&call_stub);
+      break;
+     case BinOp::kSub:
+      subq(rax, rbx);
+      jmp(kNoOverflow, &done);
+      addq(rax, rbx);
+      jmp(&call_stub);
+      break;
+     case BinOp::kMul:
+      movq(scratch, rbx);
+      Untag(scratch);
+      imulq(scratch, rax);
+      jmp(kOverflow, &call_stub);
+      movq(rax, scratch);
+      break;
+     case BinOp::kBAnd: andq(rax, rbx); break;
+     case BinOp::kBOr: orq(rax, rbx); break;
+     case BinOp::kBXor: xorq(rax, rbx); break;
+     case BinOp::kMod:
+      // Sign of remainder is left to stub
+      cmpq(rax, Immediate(0));
+      jmp(kLt, &call_stub);
+
+      if (is_const && num >= 2 && (num & (num - 1)) == 0) {
+        // Power of two: (2 * a) % (2 * b) = (2 * a) & (2 * b - 2)
+        movq(scratch, Immediate(num - 2));
+        andq(rax, scratch);
+        xorq(scratch, scratch);
+      } else {
+        cmpq(rbx, Immediate(0));
+        jmp(kLe, &call_stub);
+
+        // Both are tagged, so is the remainder
+        xorq(rdx, rdx);
+        idivq(rbx);
+        movq(rax, rdx);
+        xorq(rdx, rdx);
+      }
+      break;
+     case BinOp::kShl:
+     case BinOp::kShr:
+     case BinOp::kUShr:
+      if (is_const) {
+        // Shift count is masked by CPU the same way
+        uint8_t count = (num >> 1) & 0x3f;
+
+        switch (type) {
+         case BinOp::kShl: sal(rax, Immediate(count)); break;
+         case BinOp::kShr: sar(rax, Immediate(count)); break;
+         case BinOp::kUShr: shr(rax, Immediate(count)); break;
+         default: UNEXPECTED break;
+        }
+      } else {
+        movq(rcx, rbx);
+        shr(rcx, Immediate(1));
+
+        switch (type) {
+         case BinOp::kShl: sal(rax); break;
+         case BinOp::kShr: sar(rax); break;
+         case BinOp::kUShr: shr(rax); break;
+         default: UNEXPECTED break;
+        }
+        xorq(rcx, rcx);
       }
+
+      // Cleanup last bit
+      shr(rax, Immediate(1));
+      shl(rax, Immediate(1));
+      break;
+     default:
+      UNEXPECTED
+      break;
     }
+
+    jmp(&done);
   }
 
+  bind(&call_stub);
+
+  RecordTypes(feedback, rax, rbx);
+  Call(GetBinOpStub(type));
+
+  bind(&done);
+
+  return node;
+}
+
+
+char* Fullgen::GetBinOpStub(BinOp::BinOpType type) {
   char* stub = NULL;
 
 #define BINARY_SUB_TYPES(V)\
@@ -1130,28 +1641,15 @@ AstNode* Fullgen::VisitBinOp(AstNode* node) {
 #define BINARY_SUB_ENUM(V)\
     case BinOp::k##V: stub = stubs()->GetBinary##V##Stub(); break;
 
-
-  switch (op->subtype()) {
+  switch (type) {
    BINARY_SUB_TYPES(BINARY_SUB_ENUM)
-   default: emitb(0xcc); break;
+   default: UNEXPECTED break;
   }
 #undef BINARY_SUB_ENUM
 #undef BINARY_SUB_TYPES
 
   assert(stub != NULL);
-
-  bind(&call_stub);
-
-  Spill rax_s(this, rax);
-  VisitFor(kValue, op->rhs());
-  movq(rbx, rax);
-  rax_s.Unspill(rax);
-
-  Call(stub);
-
-  bind(&done);
-
-  return node;
+  return stub;
 }
 
 } // namespace internal
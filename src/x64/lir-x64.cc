@@ -0,0 +1,810 @@
+#include "lir.h"
+#include "hir.h" // HIRGen, HIRBlock, HIRInstruction
+#include "macroassembler.h"
+#include "code-space.h" // CodeSpace
+#include "optimizer.h" // Optimizer
+#include "heap.h" // Heap
+#include "heap-inl.h"
+#include "source-map.h" // SourceMap
+#include "stubs.h" // Stubs
+#include "ast.h" // BinOp
+#include "utils.h" // List, Unescape, StringToDouble
+
+#include <assert.h> // assert
+#include <stdint.h> // int64_t, uint64_t
+
+namespace candor {
+namespace internal {
+
+// rax and rbx are holding arguments of stubs, r11 is scratch, r10 is root
+// and rsi/rdi are argc and context
+static const Register kRegisters[] = { rcx, rdx, r8, r9, r12, r13, r14, r15 };
+const int LGen::kRegisterCount = 8;
+
+// Registers that are saved by Pushad (and scanned by GC then)
+static const int kPushadRegisterCount = 5;
+
+
+static inline Register ToRegister(LInterval* interval) {
+  assert(interval->is_register());
+  return kRegisters[interval->index()];
+}
+
+
+static inline void ToOperand(LInterval* interval, Operand& op) {
+  assert(interval->is_stack());
+  op.base(rbp);
+  op.disp(-8 * (interval->index() + 1));
+}
+
+
+Label* LGen::label(HIRBlock* block) {
+  return labels_[block->id()];
+}
+
+
+void LGen::GeneratePrologue() {
+  FunctionLiteral* fn = hir()->fn();
+  if (fn->offset() != -1) source_map()->Push(offset(), fn->offset());
+
+  // rdi <- reference to parent context
+  // rsi <- unboxed arguments count (tagged)
+  push(rbp);
+  movq(rbp, rsp);
+
+  // Values that didn't fit into registers are living in frame
+  AllocateSpills(stack_slots());
+  FillStackSlots();
+
+  // Find out registers that may contain stale values
+  used_registers_ = 0;
+  LIntervalList::Item* item = intervals()->head();
+  for (; item != NULL; item = item->next()) {
+    if (!item->value()->is_register()) continue;
+    used_registers_ |= 1 << item->value()->index();
+  }
+}
+
+
+void LGen::GenerateBlock(HIRBlock* block) {
+  bind(label(block));
+
+  HIRInstructionList::Item* item = block->instructions()->head();
+  for (; item != NULL; item = item->next()) {
+    GenerateInstruction(item->value());
+  }
+}
+
+
+void LGen::GenerateInstruction(HIRInstruction* instr) {
+  Operand truev(root_reg, HContext::GetIndexDisp(Heap::kRootTrueIndex));
+  Operand falsev(root_reg, HContext::GetIndexDisp(Heap::kRootFalseIndex));
+
+  switch (instr->type()) {
+   case HIRInstruction::kParameter:
+    {
+      Label done(this);
+      Operand arg(rbp, 2 * 8 + instr->value() * 8);
+
+      // Missing arguments are nil
+      movq(rax, Immediate(Heap::kTagNil));
+      cmpq(rsi, Immediate(HNumber::Tag(instr->value())));
+      jmp(kLe, &done);
+      movq(rax, arg);
+      bind(&done);
+
+      Store(instr, rax);
+    }
+    break;
+   case HIRInstruction::kLoadContext:
+    if (instr->depth() == -1) {
+      Operand global(root_reg,
+                     HContext::GetIndexDisp(Heap::kRootGlobalIndex));
+      movq(rax, global);
+    } else {
+      Operand slot(rax, HContext::GetIndexDisp(instr->value()));
+
+      LoadContext(rax, instr->depth());
+      movq(rax, slot);
+    }
+    Store(instr, rax);
+    break;
+   case HIRInstruction::kStoreContext:
+    {
+      Operand slot(rax, HContext::GetIndexDisp(instr->value()));
+
+      LoadContext(rax, instr->depth());
+      Load(rbx, instr->arg(0));
+      WriteBarrier(slot);
+      movq(slot, rbx);
+      RecordSlot(slot, rbx);
+      xorq(rbx, rbx);
+    }
+    break;
+   case HIRInstruction::kLoadStack:
+    {
+      // OSR frame is on top of non-optimized function's one
+      Operand frame(rbp, 0);
+      Operand slot(rax, -8 * (instr->value() + 1));
+
+      movq(rax, frame);
+      movq(rax, slot);
+      Store(instr, rax);
+    }
+    break;
+   case HIRInstruction::kStoreStack:
+    {
+      Operand frame(rbp, 0);
+      Operand slot(scratch, -8 * (instr->value() + 1));
+
+      Load(rax, instr->arg(0));
+      movq(scratch, frame);
+      movq(slot, rax);
+      xorq(scratch, scratch);
+    }
+    break;
+   case HIRInstruction::kBinOp:
+    // Comparison is generated together with branch
+    if (IsFused(instr)) break;
+    GenerateBinOp(instr);
+    break;
+   case HIRInstruction::kNot:
+    {
+      Label is_true(this), done(this);
+
+      Load(rax, instr->arg(0));
+      CallStub(instr, stubs()->GetCoerceToBooleanStub(), false);
+
+      IsTrue(rax, NULL, &is_true);
+      movq(rax, truev);
+      jmp(&done);
+      bind(&is_true);
+      movq(rax, falsev);
+      bind(&done);
+
+      Store(instr, rax);
+    }
+    break;
+   case HIRInstruction::kTypeof:
+    Load(rax, instr->arg(0));
+    CallStub(instr, stubs()->GetTypeofStub(), false);
+    Store(instr, rax);
+    break;
+   case HIRInstruction::kSizeof:
+    Load(rax, instr->arg(0));
+    CallStub(instr, stubs()->GetSizeofStub(), false);
+    Store(instr, rax);
+    break;
+   case HIRInstruction::kKeysof:
+    Load(rax, instr->arg(0));
+    CallStub(instr, stubs()->GetKeysofStub(), false);
+    Store(instr, rax);
+    break;
+   case HIRInstruction::kClone:
+    Load(rax, instr->arg(0));
+    CallStub(instr, stubs()->GetCloneObjectStub(), false);
+    Store(instr, rax);
+    break;
+   case HIRInstruction::kNewObject:
+   case HIRInstruction::kNewArray:
+    {
+      Register saved[kRegisterCount];
+      int count = SaveLive(instr->id(), saved);
+
+      ClearStale(false);
+      movq(rbx, Immediate(HNumber::Tag(instr->value())));
+      AllocateObjectLiteral(instr->is(HIRInstruction::kNewObject) ?
+                                Heap::kTagObject : Heap::kTagArray,
+                            rbx,
+                            rdx,
+                            heap()->NewAllocationSite());
+      movq(rax, rdx);
+      xorq(rbx, rbx);
+      xorq(rdx, rdx);
+
+      RestoreLive(saved, count);
+      Store(instr, rax);
+    }
+    break;
+   case HIRInstruction::kLoadProperty:
+   case HIRInstruction::kStoreProperty:
+    GenerateProperty(instr);
+    break;
+   case HIRInstruction::kCall:
+    GenerateCall(instr);
+    break;
+   case HIRInstruction::kGoto:
+    {
+      HIRBlock* succ = instr->block()->succ(0);
+      GenerateMoves(instr->block(), succ);
+      if (succ->id() != instr->block()->id() + 1) jmp(label(succ));
+    }
+    break;
+   case HIRInstruction::kBranch:
+    GenerateBranch(instr);
+    break;
+   case HIRInstruction::kReturn:
+    Load(rax, instr->arg(0));
+    movq(rsp, rbp);
+    pop(rbp);
+
+    // Loop returns from non-optimized function's frame too
+    if (hir()->is_osr()) {
+      movq(rsp, rbp);
+      pop(rbp);
+    }
+    ret(0);
+    break;
+   case HIRInstruction::kExit:
+    // Non-optimized code continues after the loop
+    movq(rsp, rbp);
+    pop(rbp);
+    ret(0);
+    break;
+   default:
+    // Constants are loaded at uses, phis are resolved by moves
+    break;
+  }
+}
+
+
+void LGen::GenerateBinOp(HIRInstruction* instr) {
+  Label call_stub(this), done(this);
+  BinOp::BinOpType type = instr->binop();
+
+  Load(rax, instr->arg(0));
+  Load(rbx, instr->arg(1));
+
+  // Fast case: both are unboxed
+  if (type == BinOp::kAdd || type == BinOp::kSub || type == BinOp::kMul ||
+      BinOp::is_logic(type) ||
+      type == BinOp::kBAnd || type == BinOp::kBOr || type == BinOp::kBXor) {
+    movq(scratch, rax);
+    orq(scratch, rbx);
+    IsUnboxed(scratch, &call_stub, NULL);
+
+    switch (type) {
+     case BinOp::kAdd:
+      addq(rax, rbx);
+      jmp(kNoOverflow, &done);
+      subq(rax, rbx);
+      break;
+     case BinOp::kSub:
+      subq(rax, rbx);
+      jmp(kNoOverflow, &done);
+      addq(rax, rbx);
+      break;
+     case BinOp::kMul:
+      movq(scratch, rbx);
+      Untag(scratch);
+      imulq(scratch, rax);
+      jmp(kOverflow, &call_stub);
+      movq(rax, scratch);
+      jmp(&done);
+      break;
+     case BinOp::kBAnd: andq(rax, rbx); jmp(&done); break;
+     case BinOp::kBOr: orq(rax, rbx); jmp(&done); break;
+     case BinOp::kBXor: xorq(rax, rbx); jmp(&done); break;
+     default:
+      {
+        Operand truev(root_reg, HContext::GetIndexDisp(Heap::kRootTrueIndex));
+        Operand falsev(root_reg,
+                       HContext::GetIndexDisp(Heap::kRootFalseIndex));
+
+        // Note: compare boxed values, so negative numbers are fine
+        cmpq(rax, rbx);
+        movq(rax, truev);
+        jmp(BinOpToCondition(type, kIntegral), &done);
+        movq(rax, falsev);
+        jmp(&done);
+      }
+      break;
+    }
+  }
+
+  bind(&call_stub);
+  CallStub(instr, GetBinOpStub(type), true);
+
+  bind(&done);
+  Store(instr, rax);
+}
+
+
+void LGen::GenerateCall(HIRInstruction* instr) {
+  Label not_function(this), done(this);
+  Register saved[kRegisterCount];
+  int count = SaveLive(instr->id(), saved);
+
+  // Calling anything except functions results in nil
+  Load(rax, instr->arg(0));
+  IsUnboxed(rax, NULL, &not_function);
+  IsNil(rax, NULL, &not_function);
+  IsHeapObject(Heap::kTagFunction, rax, &not_function, NULL);
+
+  // Arguments count survives calls as in non-optimized code: it is read
+  // by EntryStub after return, and by fullgen once OSR'd loop exits
+  push(rsi);
+  push(rdi);
+  push(root_reg);
+  push(Immediate(Heap::kTagNil));
+
+  // Arguments are going in order: [top] [1] ... [n]
+  int argc = instr->args()->length() - 1;
+  if (argc & 1) push(Immediate(Heap::kTagNil));
+
+  HIRInstructionList::Item* item = instr->args()->tail();
+  for (int i = argc; i > 0; i--, item = item->prev()) {
+    Load(rbx, item->value());
+    push(rbx);
+  }
+
+  ClearStale(false);
+  movq(rsi, Immediate(HNumber::Tag(argc)));
+  if (instr->ast()->offset() != -1) {
+    source_map()->Push(offset(), instr->ast()->offset());
+  }
+  CallFunction(rax);
+
+  addq(rsp, Immediate((RoundUp(argc, 2) + 1) * 8));
+  pop(root_reg);
+  pop(rdi);
+  pop(rsi);
+  jmp(&done);
+
+  bind(&not_function);
+  movq(rax, Immediate(Heap::kTagNil));
+
+  bind(&done);
+  RestoreLive(saved, count);
+  Store(instr, rax);
+}
+
+
+void LGen::GenerateProperty(HIRInstruction* instr) {
+  bool store = instr->is(HIRInstruction::kStoreProperty);
+  Label done(this);
+  Register saved[kRegisterCount];
+  int count = SaveLive(instr->id(), saved);
+
+  // Array elements are loaded and stored by stubs keeping their kind
+  // (raw doubles are boxed on load), constant keys are properties
+  if (!instr->arg(1)->is(HIRInstruction::kString)) {
+    Label property(this);
+
+    Load(rax, instr->arg(0));
+    IsUnboxed(rax, NULL, &property);
+    IsNil(rax, NULL, &property);
+    IsHeapObject(Heap::kTagArray, rax, &property, NULL);
+
+    // Stored value may be in a stale register, keep it in frame
+    if (store) {
+      Load(rbx, instr->arg(2));
+      push(rbx);
+      push(rbx);
+    }
+
+    Load(rbx, instr->arg(1));
+    ClearStale(true);
+    if (store) {
+      pop(rcx);
+      pop(rcx);
+    }
+    if (instr->ast()->offset() != -1) {
+      source_map()->Push(offset(), instr->ast()->offset());
+    }
+    if (store) {
+      Call(stubs()->GetStoreElementStub());
+    } else {
+      Call(stubs()->GetLoadElementStub());
+    }
+    CheckGC();
+    jmp(&done);
+
+    bind(&property);
+  }
+
+  // Object and stored value should survive GC, keep them in frame
+  Load(rbx, instr->arg(0));
+  push(rbx);
+  if (store) Load(rbx, instr->arg(2));
+  push(rbx);
+
+  Load(rax, instr->arg(0));
+  Load(rbx, instr->arg(1));
+  ClearStale(true);
+  movq(rcx, Immediate(store));
+  if (instr->ast()->offset() != -1) {
+    source_map()->Push(offset(), instr->ast()->offset());
+  }
+  Call(stubs()->GetLookupPropertyStub());
+
+  // Make rax look like unboxed number to GC
+  dec(rax);
+  CheckGC();
+  inc(rax);
+
+  // rcx <- value, rbx <- object
+  pop(rcx);
+  pop(rbx);
+
+  // Property of non-object is nil
+  IsNil(rax, NULL, &done);
+
+  Operand qmap(rbx, HObject::kMapOffset);
+  Operand slot(rax, 0);
+  movq(rbx, qmap);
+  addq(rax, rbx);
+
+  if (store) {
+    WriteBarrier(slot);
+    movq(slot, rcx);
+    RecordSlot(slot, rcx);
+  } else {
+    movq(rax, slot);
+  }
+
+  bind(&done);
+  xorq(rbx, rbx);
+  xorq(rcx, rcx);
+
+  RestoreLive(saved, count);
+  if (!store) Store(instr, rax);
+}
+
+
+void LGen::GenerateBranch(HIRInstruction* instr) {
+  HIRBlock* block = instr->block();
+  HIRBlock* t = block->succ(0);
+  HIRBlock* f = block->succ(1);
+  HIRInstruction* cond = instr->arg(0);
+
+  // Branch is always followed by one of its targets
+  bool t_next = t->id() == block->id() + 1;
+  bool f_next = f->id() == block->id() + 1;
+
+  Operand truev(root_reg, HContext::GetIndexDisp(Heap::kRootTrueIndex));
+  Operand falsev(root_reg, HContext::GetIndexDisp(Heap::kRootFalseIndex));
+
+  // Constant condition
+  if (cond->is(HIRInstruction::kTrue) || cond->is(HIRInstruction::kFalse) ||
+      cond->is(HIRInstruction::kNil) || cond->is(HIRInstruction::kInteger)) {
+    bool value = cond->is(HIRInstruction::kTrue) ||
+                 (cond->is(HIRInstruction::kInteger) && cond->value() != 0);
+    if (value && !t_next) jmp(label(t));
+    if (!value && !f_next) jmp(label(f));
+    return;
+  }
+
+  Label coerce(this);
+
+  if (IsFused(cond)) {
+    // Compare unboxed values and jump directly
+    Load(rax, cond->arg(0));
+    Load(rbx, cond->arg(1));
+    movq(scratch, rax);
+    orq(scratch, rbx);
+    IsUnboxed(scratch, &coerce, NULL);
+
+    cmpq(rax, rbx);
+    jmp(BinOpToCondition(cond->binop(), kIntegral), label(t));
+    jmp(label(f));
+
+    // Everything else is compared by stub
+    bind(&coerce);
+    CallStub(instr, GetBinOpStub(cond->binop()), true);
+  } else {
+    Label not_unboxed(this);
+
+    Load(rax, cond);
+
+    // Booleans are canonical
+    cmpq(rax, truev);
+    jmp(kEq, label(t));
+    cmpq(rax, falsev);
+    jmp(kEq, label(f));
+
+    IsUnboxed(rax, &not_unboxed, NULL);
+    cmpq(rax, Immediate(HNumber::Tag(0)));
+    jmp(kEq, label(f));
+    jmp(label(t));
+
+    bind(&not_unboxed);
+    IsNil(rax, NULL, label(f));
+
+    CallStub(instr, stubs()->GetCoerceToBooleanStub(), false);
+  }
+
+  if (f_next) {
+    IsTrue(rax, NULL, label(t));
+  } else {
+    IsTrue(rax, label(f), NULL);
+    if (!t_next) jmp(label(t));
+  }
+}
+
+
+void LGen::GenerateMoves(HIRBlock* from, HIRBlock* to) {
+  int count = to->phis()->length();
+  if (count == 0) return;
+
+  int index = to->PredecessorIndex(from);
+  HIRInstruction** src = reinterpret_cast<HIRInstruction**>(
+      Zone::current()->Allocate(sizeof(*src) * count));
+  LInterval** dst = reinterpret_cast<LInterval**>(
+      Zone::current()->Allocate(sizeof(*dst) * count));
+  bool* temp = reinterpret_cast<bool*>(
+      Zone::current()->Allocate(sizeof(*temp) * count));
+  bool* done = reinterpret_cast<bool*>(
+      Zone::current()->Allocate(sizeof(*done) * count));
+
+  int left = 0;
+  HIRInstructionList::Item* phi = to->phis()->head();
+  for (int i = 0; i < count; i++, phi = phi->next()) {
+    src[i] = phi->value()->arg(index);
+    dst[i] = phi->value()->interval();
+    temp[i] = false;
+
+    // Value is already in place
+    done[i] = dst[i] == NULL ||
+              (src[i]->interval() != NULL && src[i]->interval()->Is(dst[i]));
+    if (!done[i]) left++;
+  }
+
+  // Phis are assigned in parallel: move values whose destination isn't
+  // read by other moves, break cycles by saving one of values in rbx
+  while (left > 0) {
+    bool progress = false;
+
+    for (int i = 0; i < count; i++) {
+      if (done[i]) continue;
+
+      bool blocked = false;
+      for (int j = 0; j < count; j++) {
+        if (j == i || done[j] || temp[j]) continue;
+        if (src[j]->interval() != NULL && src[j]->interval()->Is(dst[i])) {
+          blocked = true;
+          break;
+        }
+      }
+      if (blocked) continue;
+
+      if (temp[i]) {
+        StoreInterval(dst[i], rbx);
+      } else if (src[i]->interval() == NULL && dst[i]->is_register()) {
+        LoadConstant(ToRegister(dst[i]), src[i]);
+      } else if (src[i]->interval() == NULL) {
+        LoadConstant(rax, src[i]);
+        StoreInterval(dst[i], rax);
+      } else if (dst[i]->is_register()) {
+        LoadInterval(ToRegister(dst[i]), src[i]->interval());
+      } else {
+        LoadInterval(rax, src[i]->interval());
+        StoreInterval(dst[i], rax);
+      }
+
+      done[i] = true;
+      left--;
+      progress = true;
+    }
+
+    if (progress) continue;
+
+    // Cycle
+    for (int i = 0; i < count; i++) {
+      if (done[i]) continue;
+
+      LoadInterval(rbx, dst[i]);
+      for (int j = 0; j < count; j++) {
+        if (done[j] || temp[j] || src[j]->interval() == NULL) continue;
+        if (src[j]->interval()->Is(dst[i])) temp[j] = true;
+      }
+      break;
+    }
+  }
+
+  xorq(rbx, rbx);
+}
+
+
+void LGen::Load(Register dst, HIRInstruction* value) {
+  if (value->interval() == NULL) {
+    LoadConstant(dst, value);
+  } else {
+    LoadInterval(dst, value->interval());
+  }
+}
+
+
+void LGen::Store(HIRInstruction* instr, Register src) {
+  // Value isn't used
+  if (instr->interval() == NULL) return;
+
+  StoreInterval(instr->interval(), src);
+}
+
+
+void LGen::LoadInterval(Register dst, LInterval* interval) {
+  if (interval->is_register()) {
+    if (!dst.is(ToRegister(interval))) movq(dst, ToRegister(interval));
+  } else {
+    Operand slot(rbp, 0);
+    ToOperand(interval, slot);
+    movq(dst, slot);
+  }
+}
+
+
+void LGen::StoreInterval(LInterval* interval, Register src) {
+  if (interval->is_register()) {
+    if (!src.is(ToRegister(interval))) movq(ToRegister(interval), src);
+  } else {
+    Operand slot(rbp, 0);
+    ToOperand(interval, slot);
+    movq(slot, src);
+  }
+}
+
+
+void LGen::LoadContext(Register dst, int32_t depth) {
+  // Optimized function has no context of its own (rdi is the parent one),
+  // OSR loop is running with non-optimized function's context
+  Operand parent(dst, HContext::kParentOffset);
+
+  movq(dst, rdi);
+  if (!hir()->is_osr()) depth--;
+  for (; depth > 0; depth--) movq(dst, parent);
+}
+
+
+void LGen::LoadConstant(Register dst, HIRInstruction* value) {
+  switch (value->type()) {
+   case HIRInstruction::kNil:
+    movq(dst, Immediate(Heap::kTagNil));
+    break;
+   case HIRInstruction::kTrue:
+    {
+      Operand truev(root_reg, HContext::GetIndexDisp(Heap::kRootTrueIndex));
+      movq(dst, truev);
+    }
+    break;
+   case HIRInstruction::kFalse:
+    {
+      Operand falsev(root_reg, HContext::GetIndexDisp(Heap::kRootFalseIndex));
+      movq(dst, falsev);
+    }
+    break;
+   case HIRInstruction::kInteger:
+    movq(dst, Immediate(HNumber::Tag(value->value())));
+    break;
+   case HIRInstruction::kDouble:
+   case HIRInstruction::kString:
+    {
+      // Heap values are allocated once and referenced through cells
+      if (value->value() == 0) {
+        AstNode* ast = value->ast();
+        char* result;
+
+        if (value->is(HIRInstruction::kDouble)) {
+          result = HNumber::New(heap(),
+                                Heap::kTenureOld,
+                                StringToDouble(ast->value(), ast->length()));
+        } else {
+          uint32_t length;
+          const char* unescaped = Unescape(ast->value(),
+                                           ast->length(),
+                                           &length);
+          result = heap()->strings()->Intern(heap(), unescaped, length);
+          delete unescaped;
+        }
+
+        char** cell = space_->optimizer()->NewCell(result);
+        value->value(reinterpret_cast<int64_t>(cell));
+      }
+
+      Operand cell(scratch, 0);
+      movq(scratch, Immediate(static_cast<uint64_t>(value->value())));
+      movq(dst, cell);
+      xorq(scratch, scratch);
+    }
+    break;
+   default:
+    UNEXPECTED
+    break;
+  }
+}
+
+
+int LGen::SaveLive(int pos, Register* saved) {
+  int count = 0;
+
+  LIntervalList::Item* item = intervals()->head();
+  for (; item != NULL; item = item->next()) {
+    LInterval* interval = item->value();
+    if (interval->start() >= pos) break;
+    if (!interval->is_register() || !interval->Covers(pos)) continue;
+
+    saved[count++] = ToRegister(interval);
+    push(saved[count - 1]);
+  }
+
+  // Keep stack aligned
+  if (count & 1) push(Immediate(Heap::kTagNil));
+
+  return count;
+}
+
+
+void LGen::RestoreLive(Register* saved, int count) {
+  if (count & 1) addq(rsp, Immediate(8));
+
+  for (int i = count - 1; i >= 0; i--) pop(saved[i]);
+}
+
+
+void LGen::ClearStale(bool keep_rbx) {
+  // GC is updating pointers in registers saved by stubs,
+  // dead values there should be cleared
+  for (int i = 0; i < kPushadRegisterCount; i++) {
+    if ((used_registers_ & (1 << i)) == 0) continue;
+    xorq(kRegisters[i], kRegisters[i]);
+  }
+  if (!keep_rbx) xorq(rbx, rbx);
+}
+
+
+void LGen::CallStub(HIRInstruction* instr, char* stub, bool uses_rbx) {
+  Register saved[kRegisterCount];
+  int count = SaveLive(instr->id(), saved);
+
+  ClearStale(uses_rbx);
+  if (instr->ast() != NULL && instr->ast()->offset() != -1) {
+    source_map()->Push(offset(), instr->ast()->offset());
+  }
+  Call(stub);
+
+  RestoreLive(saved, count);
+}
+
+
+char* LGen::GetBinOpStub(BinOp::BinOpType type) {
+  char* stub = NULL;
+
+#define BINARY_SUB_TYPES(V)\
+    V(Add)\
+    V(Sub)\
+    V(Mul)\
+    V(Div)\
+    V(Mod)\
+    V(BAnd)\
+    V(BOr)\
+    V(BXor)\
+    V(Shl)\
+    V(Shr)\
+    V(UShr)\
+    V(Eq)\
+    V(StrictEq)\
+    V(Ne)\
+    V(StrictNe)\
+    V(Lt)\
+    V(Gt)\
+    V(Le)\
+    V(Ge)\
+    V(LOr)\
+    V(LAnd)
+
+#define BINARY_SUB_ENUM(V)\
+    case BinOp::k##V: stub = stubs()->GetBinary##V##Stub(); break;
+
+  switch (type) {
+   BINARY_SUB_TYPES(BINARY_SUB_ENUM)
+   default: UNEXPECTED break;
+  }
+#undef BINARY_SUB_ENUM
+#undef BINARY_SUB_TYPES
+
+  assert(stub != NULL);
+  return stub;
+}
+
+} // namespace internal
+} // namespace candor
@@ -121,6 +121,8 @@ void Masm::Spill::Unspill() {
 
 void Masm::AllocateSpills(uint32_t stack_slots) {
   spill_offset_ = RoundUp((stack_slots + 1) * 8, 16);
+  spill_clear_ = NULL;
+  spill_cleared_ = NULL;
   spills_ = 0;
   spill_index_ = 0;
   subq(rsp, Immediate(0));
@@ -133,14 +135,31 @@ void Masm::AllocateSpills(uint32_t stack_slots) {
 
 
 void Masm::FinalizeSpills() {
-  spill_reloc_->target(spill_offset_ + RoundUp((spills_ + 1) << 3, 16));
+  uint32_t size = spill_offset_ + RoundUp((spills_ + 1) << 3, 16);
+  spill_reloc_->target(size);
+
+  if (spill_clear_ == NULL) return;
+
+  Label skip(this);
+  jmp(&skip);
+
+  // Put nil in every slot of frame
+  bind(spill_clear_);
+  for (int32_t i = 1; i <= static_cast<int32_t>(size >> 3); i++) {
+    Operand slot(rbp, -i * HValue::kPointerSize);
+    movq(slot, Immediate(Heap::kTagNil));
+  }
+  jmp(spill_cleared_);
+
+  bind(&skip);
 }
 
 
 void Masm::Allocate(Heap::HeapTag tag,
                     Register size_reg,
                     uint32_t size,
-                    Register result) {
+                    Register result,
+                    AllocationSite* site) {
   Spill rax_s(this, rax);
 
   // Two arguments
@@ -158,7 +177,29 @@ void Masm::Allocate(Heap::HeapTag tag,
       TagNumber(rax);
     }
     push(rax);
-    movq(rax, Immediate(HNumber::Tag(tag)));
+    if (site == NULL) {
+      movq(rax, Immediate(HNumber::Tag(tag)));
+    } else {
+      // Stub receives whole tag word: tag, site's generation and index.
+      // Map is accounted together with its object
+      off_t qtag = tag;
+      if (tag != Heap::kTagMap) {
+        qtag |= static_cast<off_t>(site->index()) <<
+            ((HValue::kAllocationSiteOffset - HValue::kTagOffset) << 3);
+      }
+
+      Immediate generation_addr(
+          reinterpret_cast<uint64_t>(site->generation_addr()));
+      Operand generation(rax, 0);
+      movq(rax, generation_addr);
+      movzxb(rax, generation);
+      shl(rax, Immediate(
+            (HValue::kGenerationOffset - HValue::kTagOffset) << 3));
+      movq(scratch, Immediate(qtag));
+      orq(rax, scratch);
+      xorq(scratch, scratch);
+      TagNumber(rax);
+    }
     push(rax);
 
     Call(stubs()->GetAllocateStub());
@@ -223,23 +264,72 @@ void Masm::AllocateFunction(Register addr, Register result, uint32_t argc) {
 
 
 void Masm::AllocateNumber(DoubleRegister value, Register result) {
+#ifdef CANDOR_FLONUMS
+  Label allocate(this), done(this);
+
+  // Bits 62..60 should be either 0b011 or 0b100 (see HNumber::FitsFlonum)
+  movqd(result, value);
+  movq(scratch, result);
+  shl(scratch, Immediate(1));
+  shr(scratch, Immediate(61));
+  subq(scratch, Immediate(3));
+  cmpq(scratch, Immediate(1));
+  jmp(kAbove, &allocate);
+
+  rol(result, Immediate(4));
+  orqb(result, Immediate(HNumber::kFlonumTag));
+  xorq(scratch, scratch);
+  jmp(&done);
+
+  // Raw bits shouldn't be visible to GC
+  bind(&allocate);
+  xorq(scratch, scratch);
+  xorq(result, result);
+#endif // CANDOR_FLONUMS
+
   Allocate(Heap::kTagNumber, reg_nil, HValue::kPointerSize, result);
 
   Operand qvalue(result, HNumber::kValueOffset);
   movqd(qvalue, value);
 
   CheckGC();
+
+#ifdef CANDOR_FLONUMS
+  bind(&done);
+#endif // CANDOR_FLONUMS
+}
+
+
+void Masm::DecodeFlonum(Register reference, DoubleRegister result) {
+  Label restored(this);
+
+  // Bits 61 and 60 are inverse of bit 62
+  testb(reference, Immediate(0x04));
+  jmp(kEq, &restored);
+  subq(reference, Immediate(HNumber::kFlonumTag));
+  bind(&restored);
+
+  ror(reference, Immediate(4));
+  movqd(result, reference);
 }
 
 
 void Masm::AllocateObjectLiteral(Heap::HeapTag tag,
                                  Register size,
-                                 Register result) {
-  // mask + map
-  Allocate(tag,
-           reg_nil,
-           (tag == Heap::kTagArray ? 3 : 2) * HValue::kPointerSize,
-           result);
+                                 Register result,
+                                 AllocationSite* site) {
+  // Site decides where to allocate by ratio of surviving values
+  if (site != NULL) {
+    Immediate allocated_addr(
+        reinterpret_cast<uint64_t>(site->allocated_addr()));
+    Operand allocated(scratch, 0);
+    movq(scratch, allocated_addr);
+    inc(allocated);
+    xorq(scratch, scratch);
+  }
+
+  // mask + map + length (or shape)
+  Allocate(tag, reg_nil, 3 * HValue::kPointerSize, result, site);
 
   Operand qmask(result, HObject::kMaskOffset);
   Operand qmap(result, HObject::kMapOffset);
@@ -247,11 +337,16 @@ void Masm::AllocateObjectLiteral(Heap::HeapTag tag,
   // Array only field
   Operand qlength(result, HArray::kLengthOffset);
 
+  // Object only field
+  Operand qshape(result, HObject::kShapeOffset);
+
   // Set mask
   movq(scratch, size);
 
   // mask (= (size - 1) << 3)
+  // dense array's elements are occupying both keys and values
   Untag(scratch);
+  if (tag == Heap::kTagArray) shl(scratch, Immediate(1));
   dec(scratch);
   shl(scratch, Immediate(3));
   movq(qmask, scratch);
@@ -267,7 +362,7 @@ void Masm::AllocateObjectLiteral(Heap::HeapTag tag,
   addq(size, Immediate(HValue::kPointerSize));
   TagNumber(size);
 
-  Allocate(Heap::kTagMap, size, 0, scratch);
+  Allocate(Heap::kTagMap, size, 0, scratch, site);
   movq(qmap, scratch);
 
   size_s.Unspill();
@@ -289,9 +384,17 @@ void Masm::AllocateObjectLiteral(Heap::HeapTag tag,
   result_s.Unspill();
   size_s.Unspill();
 
-  // Set length
+  // Set length, and the most specific kind of elements
   if (tag == Heap::kTagArray) {
+    Operand qrepr(result, HValue::kRepresentationOffset);
     movq(qlength, Immediate(0));
+    movb(qrepr, Immediate(HArray::kSmiElements));
+  } else {
+    // Objects are starting with an empty shape
+    Shape* root = heap()->shapes()->Root(heap());
+    movq(scratch, Immediate(reinterpret_cast<uint64_t>(root)));
+    movq(qshape, scratch);
+    xorq(scratch, scratch);
   }
 
   CheckGC();
@@ -367,6 +470,15 @@ void Masm::FillStackSlots() {
 }
 
 
+void Masm::ClearSpills() {
+  spill_clear_ = new Label(this);
+  spill_cleared_ = new Label(this);
+
+  jmp(spill_clear_);
+  bind(spill_cleared_);
+}
+
+
 void Masm::EnterFramePrologue() {
   Immediate last_stack(reinterpret_cast<uint64_t>(heap()->last_stack()));
   Immediate last_frame(reinterpret_cast<uint64_t>(heap()->last_frame()));
@@ -431,14 +543,14 @@ void Masm::StringHash(Register str, Register result) {
   Label call_runtime(this), done(this);
 
   // Check if hash was already calculated
-  movq(scratch, hash_field);
-  cmpq(scratch, Immediate(0));
+  movq(result, hash_field);
+  cmpq(result, Immediate(0));
   jmp(kNe, &done);
 
   // Check if string is a cons string
   movzxb(scratch, repr_field);
-  cmpb(scratch, Immediate(HString::kNormal));
-  jmp(kNe, &call_runtime);
+  cmpb(scratch, Immediate(HString::kCons));
+  jmp(kEq, &call_runtime);
 
   // Compute new hash
   assert(!str.is(rcx));
@@ -551,6 +663,56 @@ void Masm::CheckGC() {
 }
 
 
+void Masm::WriteBarrier(Operand& slot) {
+  Immediate marking(reinterpret_cast<uint64_t>(
+        heap()->incremental_marking_addr()));
+  Operand scratch_op(scratch, 0);
+
+  Label done(this);
+
+  // Check incremental marking flag
+  movq(scratch, marking);
+  cmpb(scratch_op, Immediate(0));
+  jmp(kEq, &done);
+
+  Spill rbx_s(this, rbx);
+  movq(rbx, slot);
+  {
+    Align a(this);
+    Call(stubs()->GetWriteBarrierStub());
+  }
+  rbx_s.Unspill();
+
+  bind(&done);
+}
+
+
+void Masm::RecordSlot(Operand& slot, Register value) {
+  Label done(this);
+
+  IsUnboxed(value, NULL, &done);
+  IsNil(value, NULL, &done);
+  IsFlonum(value, NULL, &done);
+
+  // Old values don't need to be remembered
+  Operand generation(value, HValue::kGenerationOffset);
+  cmpb(generation, Immediate(Heap::kMinOldSpaceGeneration));
+  jmp(kGe, &done);
+
+  // Stub will filter out slots that aren't in old space
+  Spill rbx_s(this, rbx);
+  movq(rbx, slot.base());
+  if (slot.disp() != 0) addq(rbx, Immediate(slot.disp()));
+  {
+    Align a(this);
+    Call(stubs()->GetRecordSlotStub());
+  }
+  rbx_s.Unspill();
+
+  bind(&done);
+}
+
+
 void Masm::IsNil(Register reference, Label* not_nil, Label* is_nil) {
   cmpq(reference, Immediate(Heap::kTagNil));
   if (is_nil != NULL) jmp(kEq, is_nil);
@@ -565,14 +727,32 @@ void Masm::IsUnboxed(Register reference, Label* not_unboxed, Label* unboxed) {
 }
 
 
+void Masm::IsFlonum(Register reference, Label* not_flonum, Label* flonum) {
+#ifdef CANDOR_FLONUMS
+  testb(reference, Immediate(0x02));
+  if (not_flonum != NULL) jmp(kEq, not_flonum);
+  if (flonum != NULL) jmp(kNe, flonum);
+#else
+  if (not_flonum != NULL) jmp(not_flonum);
+#endif // CANDOR_FLONUMS
+}
+
+
 void Masm::IsHeapObject(Heap::HeapTag tag,
                         Register reference,
                         Label* mismatch,
                         Label* match) {
+  Label done(this);
+
+  // Flonums have no tag to compare
+  IsFlonum(reference, NULL, mismatch == NULL ? &done : mismatch);
+
   Operand qtag(reference, HValue::kTagOffset);
   cmpb(qtag, Immediate(tag));
   if (mismatch != NULL) jmp(kNe, mismatch);
   if (match != NULL) jmp(kEq, match);
+
+  bind(&done);
 }
 
 
@@ -586,11 +766,45 @@ void Masm::IsTrue(Register reference, Label* is_false, Label* is_true) {
 }
 
 
-void Masm::IsDenseArray(Register reference, Label* non_dense, Label* dense) {
-  Operand qlength(reference, HArray::kLengthOffset);
-  cmpq(qlength, Immediate(HArray::kDenseLengthMax));
-  if (non_dense != NULL) jmp(kGt, non_dense);
-  if (dense != NULL) jmp(kLe, dense);
+void Masm::TypeIndex(Register reference, Register result) {
+  Label done(this);
+
+  // Unboxed integers are 0, flonums are numbers and others have tags
+  xorq(result, result);
+  IsUnboxed(reference, NULL, &done);
+  movq(result, Immediate(Heap::kTagNil));
+  IsNil(reference, NULL, &done);
+  movq(result, Immediate(Heap::kTagNumber));
+  IsFlonum(reference, NULL, &done);
+
+  Operand qtag(reference, HValue::kTagOffset);
+  movzxb(result, qtag);
+
+  bind(&done);
+}
+
+
+void Masm::RecordTypes(FeedbackSlot* slot, Register lhs, Register rhs) {
+  // scratch <- offset of combination's flag
+  TypeIndex(lhs, rcx);
+  movq(scratch, rcx);
+  if (!rhs.is(reg_nil)) {
+    // lhs * kTypeCount + rhs
+    shl(scratch, Immediate(2));
+    addq(scratch, rcx);
+    shl(scratch, Immediate(1));
+    TypeIndex(rhs, rcx);
+    addq(scratch, rcx);
+  }
+
+  movq(rcx, Immediate(reinterpret_cast<uint64_t>(slot) +
+                      FeedbackSlot::kTypesOffset));
+  addq(scratch, rcx);
+  Operand flag(scratch, 0);
+  movb(flag, Immediate(1));
+
+  xorq(rcx, rcx);
+  xorq(scratch, scratch);
 }
 
 
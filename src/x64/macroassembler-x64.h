@@ -65,21 +65,29 @@ class Masm : public Assembler {
   inline void ChangeAlign(int32_t slots) { align_ += slots; }
 
   // Allocate some space in heap's new space current page
-  // Jmp to runtime_allocate label on exhaust or fail
+  // Jmp to runtime_allocate label on exhaust or fail.
+  // Values of pretenured `site` are allocated in old space
   void Allocate(Heap::HeapTag tag,
                 Register size_reg,
                 uint32_t size,
-                Register result);
+                Register result,
+                AllocationSite* site = NULL);
 
   // Allocate context and function
   void AllocateContext(uint32_t slots);
   void AllocateFunction(Register addr, Register result, uint32_t argc);
 
-  // Allocate heap numbers
+  // Allocate heap numbers (or encode flonums, if enabled)
   void AllocateNumber(DoubleRegister value, Register result);
 
+  // Load double value of flonum, clobbers reference
+  void DecodeFlonum(Register reference, DoubleRegister result);
+
   // Allocate object&map
-  void AllocateObjectLiteral(Heap::HeapTag tag, Register size, Register result);
+  void AllocateObjectLiteral(Heap::HeapTag tag,
+                             Register size,
+                             Register result,
+                             AllocationSite* site = NULL);
 
   // VarArg
   void AllocateVarArgSlots(Spill* vararg, Register argc);
@@ -90,6 +98,11 @@ class Masm : public Assembler {
   // Fill stack slots with nil
   void FillStackSlots();
 
+  // Same as above, but preserves all registers (stubs are getting
+  // arguments in them). Number of spills is known only at the end of code,
+  // so clearing is emitted by FinalizeSpills.
+  void ClearSpills();
+
   // Generate enter/exit frame sequences
   void EnterFramePrologue();
   void EnterFrameEpilogue();
@@ -102,16 +115,33 @@ class Masm : public Assembler {
   // Perform garbage collection if needed (heap flag is set)
   void CheckGC();
 
+  // Record value of slot that is going to be overwritten
+  // (only while incremental marking is in progress)
+  void WriteBarrier(Operand& slot);
+
+  // Remember slot if new space value was stored into it
+  void RecordSlot(Operand& slot, Register value);
+
   void IsNil(Register reference, Label* not_nil, Label* is_nil);
   void IsUnboxed(Register reference, Label* not_unboxed, Label* unboxed);
 
+  // Reference should be neither unboxed integer, nor nil.
+  // Without CANDOR_FLONUMS nothing is a flonum
+  void IsFlonum(Register reference, Label* not_flonum, Label* flonum);
+
   // Checks if object has specific type
   void IsHeapObject(Heap::HeapTag tag,
                     Register reference,
                     Label* mismatch,
                     Label* match);
   void IsTrue(Register reference, Label* is_false, Label* is_true);
-  void IsDenseArray(Register reference, Label* non_dense, Label* dense);
+
+  // Index of value's type in feedback slot (see FeedbackSlot)
+  void TypeIndex(Register reference, Register result);
+
+  // Remember combination of value types in feedback slot, clobbers rcx
+  // (rhs is reg_nil for slots with a single type)
+  void RecordTypes(FeedbackSlot* slot, Register lhs, Register rhs);
 
   // Sets correct environment and calls function
   void Call(Register addr);
@@ -135,6 +165,7 @@ class Masm : public Assembler {
 
   // See VisitForSlot and VisitForValue in fullgen for disambiguation
   inline Operand& slot() { return slot_; }
+  inline CodeSpace* space() { return space_; }
   inline Heap* heap() { return space_->heap(); }
   inline Stubs* stubs() { return space_->stubs(); }
 
@@ -146,6 +177,8 @@ class Masm : public Assembler {
   int32_t align_;
 
   RelocationInfo* spill_reloc_;
+  Label* spill_clear_;
+  Label* spill_cleared_;
   uint32_t spill_offset_;
   int32_t spill_index_;
   int32_t spills_;
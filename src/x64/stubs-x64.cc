@@ -141,7 +141,7 @@ void AllocateStub::Generate() {
   Operand size(rbp, 24);
   Operand tag(rbp, 16);
 
-  Label runtime_allocate(masm()), done(masm());
+  Label runtime_allocate(masm()), done(masm()), tagged(masm());
 
   Heap* heap = masm()->heap();
   Immediate heapref(reinterpret_cast<uint64_t>(heap));
@@ -160,6 +160,23 @@ void AllocateStub::Generate() {
   __ movq(rbx, size);
   __ Untag(rbx);
 
+  // Big objects are placed in large space by runtime
+  __ cmpq(rbx, Immediate(LargeSpace::kMinObjectSize));
+  __ jmp(kGe, &runtime_allocate);
+
+  // And so are values of pretenured allocation sites
+  __ movq(scratch, tag);
+  __ Untag(scratch);
+  __ shr(scratch, Immediate((HValue::kGenerationOffset -
+                             HValue::kTagOffset) << 3));
+  __ testb(scratch, Immediate(0xff));
+  __ jmp(kNe, &runtime_allocate);
+
+  // Keep values aligned (see Space::kAlignment)
+  __ addq(rbx, Immediate(Space::kAlignment - 1));
+  __ movq(scratch, Immediate(~static_cast<uint64_t>(Space::kAlignment - 1)));
+  __ andq(rbx, scratch);
+
   // Add object size to the top
   __ addq(rbx, rax);
   __ jmp(kCarry, &runtime_allocate);
@@ -170,9 +187,6 @@ void AllocateStub::Generate() {
   __ cmpq(rbx, scratch_op);
   __ jmp(kGt, &runtime_allocate);
 
-  // We should allocate only even amount of bytes
-  __ orqb(rbx, Immediate(0x01));
-
   // Update top
   __ movq(scratch, top);
   __ movq(scratch, scratch_op);
@@ -187,15 +201,18 @@ void AllocateStub::Generate() {
   __ xorq(rax, rax);
   __ xorq(rbx, rbx);
 
-  RuntimeAllocateCallback allocate = &RuntimeAllocate;
+  RuntimeAllocateTaggedCallback allocate = &RuntimeAllocateTagged;
 
   {
     Masm::Align a(masm());
     __ Pushad();
 
-    // Two arguments: heap, size
+    // Three arguments: heap, tag, size
     __ movq(rdi, heapref);
-    __ movq(rsi, size);
+    __ movq(rsi, tag);
+    __ Untag(rsi);
+    __ movq(rdx, size);
+    __ Untag(rdx);
 
     __ movq(scratch, Immediate(*reinterpret_cast<uint64_t*>(&allocate)));
 
@@ -203,6 +220,9 @@ void AllocateStub::Generate() {
     __ Popad(rax);
   }
 
+  // Runtime has set tag and accounted marking budget
+  __ jmp(&tagged);
+
   // Voila result and result_end are pointers
   __ bind(&done);
 
@@ -212,6 +232,28 @@ void AllocateStub::Generate() {
   __ Untag(scratch);
   __ movq(qtag, scratch);
 
+  // Request incremental marking step if allocation budget was exhausted
+  Label step_done(masm());
+  Immediate budget(reinterpret_cast<uint64_t>(
+        heap->marking_step_budget_addr()));
+  Immediate gc_flag(reinterpret_cast<uint64_t>(heap->needs_gc_addr()));
+
+  __ movq(rbx, size);
+  __ Untag(rbx);
+  __ movq(scratch, budget);
+  __ subq(scratch_op, rbx);
+  __ jmp(kGe, &step_done);
+
+  // Do not override pending GC request
+  __ movq(scratch, gc_flag);
+  __ cmpb(scratch_op, Immediate(Heap::kGCNone));
+  __ jmp(kNe, &step_done);
+  __ movq(rbx, Immediate(Heap::kGCIncrementalStep));
+  __ movq(scratch_op, rbx);
+
+  __ bind(&step_done);
+  __ bind(&tagged);
+
   // Rax will hold resulting pointer
   __ pop(rbx);
   GenerateEpilogue(2);
@@ -264,6 +306,7 @@ void VarArgStub::Generate() {
   GeneratePrologue();
 
   __ AllocateSpills(0);
+  __ ClearSpills();
 
   // rax <- interior pointer to arguments
   // rdx <- arguments count (to put into array)
@@ -336,7 +379,9 @@ void VarArgStub::Generate() {
 void PutVarArgStub::Generate() {
   GeneratePrologue();
 
+  // Boxing of double elements may trigger GC
   __ AllocateSpills(0);
+  __ ClearSpills();
 
   // rax <- array
   // rbx <- stack offset
@@ -360,17 +405,10 @@ void PutVarArgStub::Generate() {
     Masm::Spill rbx_s(masm(), rbx);
 
     rax_s.Unspill();
-    __ movq(rcx, Immediate(0));
 
     // rax <- array
     // rbx <- index
-    // rcx <- flag(0)
-    __ Call(masm()->stubs()->GetLookupPropertyStub());
-    rax_s.Unspill(scratch);
-    Operand qmap(scratch, HObject::kMapOffset);
-    Operand qself(rax, 0);
-    __ addq(rax, qmap);
-    __ movq(rax, qself);
+    __ Call(masm()->stubs()->GetLoadElementStub());
 
     stack_s.Unspill(rdx);
     Operand slot(rdx, 0);
@@ -418,10 +456,128 @@ void CollectGarbageStub::Generate() {
 }
 
 
+void OptimizeStub::Generate() {
+  GeneratePrologue();
+
+  // rax <- function's profile
+  RuntimeOptimizeCallback optimize = &RuntimeOptimize;
+  __ Pushad();
+
+  {
+    Masm::Align a(masm());
+
+    // RuntimeOptimize(space, profile)
+    __ movq(rsi, rax);
+    __ movq(rdi, Immediate(reinterpret_cast<uint64_t>(masm()->space())));
+    __ movq(rax, Immediate(*reinterpret_cast<uint64_t*>(&optimize)));
+    __ Call(rax);
+  }
+
+  __ Popad(reg_nil);
+
+  GenerateEpilogue(0);
+}
+
+
+void OptimizeLoopStub::Generate() {
+  GeneratePrologue();
+
+  // rax <- loop's profile
+  RuntimeOptimizeLoopCallback optimize = &RuntimeOptimizeLoop;
+  __ Pushad();
+
+  {
+    Masm::Align a(masm());
+
+    // RuntimeOptimizeLoop(space, profile)
+    __ movq(rsi, rax);
+    __ movq(rdi, Immediate(reinterpret_cast<uint64_t>(masm()->space())));
+    __ movq(rax, Immediate(*reinterpret_cast<uint64_t*>(&optimize)));
+    __ Call(rax);
+  }
+
+  // rax <- loop's code
+  __ Popad(rax);
+
+  GenerateEpilogue(0);
+}
+
+
+void WriteBarrierStub::Generate() {
+  GeneratePrologue();
+
+  // rbx <- value that is going to be overwritten
+  Label done(masm());
+
+  __ IsNil(rbx, NULL, &done);
+  __ IsUnboxed(rbx, NULL, &done);
+  __ IsFlonum(rbx, NULL, &done);
+
+  RuntimeWriteBarrierCallback barrier = &RuntimeWriteBarrier;
+  __ Pushad();
+
+  // RuntimeWriteBarrier(heap, old_value)
+  __ movq(rdi, Immediate(reinterpret_cast<uint64_t>(masm()->heap())));
+  __ movq(rsi, rbx);
+  __ movq(rax, Immediate(*reinterpret_cast<uint64_t*>(&barrier)));
+  __ callq(rax);
+
+  __ Popad(reg_nil);
+
+  __ bind(&done);
+  GenerateEpilogue(0);
+}
+
+
+void RecordSlotStub::Generate() {
+  GeneratePrologue();
+  // Align stack
+  __ push(Immediate(0));
+  __ push(rax);
+
+  // rbx <- slot's address
+  Label done(masm());
+
+  Heap* heap = masm()->heap();
+  Immediate top(reinterpret_cast<uint64_t>(heap->remembered_set()->top()));
+  Immediate limit(reinterpret_cast<uint64_t>(
+        heap->remembered_set()->limit()));
+
+  Operand scratch_op(scratch, 0);
+  Operand rax_op(rax, 0);
+
+  // Append slot to the remembered set
+  __ movq(scratch, top);
+  __ movq(rax, scratch_op);
+  __ movq(rax_op, rbx);
+  __ addq(rax, Immediate(HValue::kPointerSize));
+  __ movq(scratch_op, rax);
+
+  // Compact set if it's full
+  __ movq(scratch, limit);
+  __ cmpq(rax, scratch_op);
+  __ jmp(kNe, &done);
+
+  RuntimeCompactRememberedSetCallback compact = &RuntimeCompactRememberedSet;
+  __ Pushad();
+
+  // RuntimeCompactRememberedSet(heap)
+  __ movq(rdi, Immediate(reinterpret_cast<uint64_t>(heap)));
+  __ movq(rax, Immediate(*reinterpret_cast<uint64_t*>(&compact)));
+  __ callq(rax);
+
+  __ Popad(reg_nil);
+
+  __ bind(&done);
+  __ pop(rax);
+  GenerateEpilogue(0);
+}
+
+
 void TypeofStub::Generate() {
   GeneratePrologue();
 
-  Label not_nil(masm()), not_unboxed(masm()), done(masm());
+  Label not_nil(masm()), not_unboxed(masm()), number(masm()), done(masm());
 
   Operand type(rax, 0);
 
@@ -432,10 +588,12 @@ void TypeofStub::Generate() {
   __ bind(&not_nil);
 
   __ IsUnboxed(rax, &not_unboxed, NULL);
+  __ bind(&number);
   __ movq(rax, Immediate(HContext::GetIndexDisp(Heap::kRootNumberTypeIndex)));
 
   __ jmp(&done);
   __ bind(&not_unboxed);
+  __ IsFlonum(rax, NULL, &number);
 
   Operand btag(rax, HValue::kTagOffset);
   __ movzxb(rax, btag);
@@ -512,62 +670,166 @@ void LookupPropertyStub::Generate() {
 
   __ bind(&is_object);
 
-  // Fast case: object and a string key
+  // Fast case: object and an internalized string key
   {
     __ IsUnboxed(rbx, NULL, &slow_case);
     __ IsNil(rbx, NULL, &slow_case);
     __ IsHeapObject(Heap::kTagString, rbx, &slow_case, NULL);
 
+    // Keys of objects are internalized, others should be looked up first
+    Operand repr(rbx, HValue::kRepresentationOffset);
+    __ cmpb(repr, Immediate(HString::kInternalized));
+    __ jmp(kNe, &slow_case);
+
     __ StringHash(rbx, rdx);
 
-    Operand qmask(rax, HObject::kMaskOffset);
-    __ movq(r15, qmask);
+    Label dictionary(masm());
 
-    // offset = hash & mask + kSpaceOffset
-    __ andq(rdx, r15);
-    __ addq(rdx, Immediate(HMap::kSpaceOffset));
+    Operand qshape(rax, HObject::kShapeOffset);
+    __ movq(r15, qshape);
+    __ cmpq(r15, Immediate(0));
+    __ jmp(kEq, &dictionary);
 
-    Operand qmap(rax, HObject::kMapOffset);
-    __ movq(scratch, qmap);
-    __ addq(scratch, rdx);
+    // Object with shape: take entry at hash & mask from shape's table,
+    // key in it should be the same string
+    Operand qshapemask(r15, Shape::kMaskOffset);
+    Operand qtable(r15, Shape::kTableOffset);
+    __ movq(scratch, qshapemask);
+    __ andq(rdx, scratch);
+    __ addq(rdx, qtable);
 
-    Label match(masm());
+    Operand entry_key(rdx, 0);
+    Operand entry_offset(rdx, HValue::kPointerSize);
+    __ cmpq(rbx, entry_key);
+    __ jmp(kNe, &cleanup);
 
-    // rdx now contains pointer to the key slot in map's space
-    // compare key's addresses
-    Operand slot(scratch, 0);
-    __ movq(scratch, slot);
+    // Offset of value is stored in entry
+    __ movq(rax, entry_offset);
 
-    // Slot should contain either key
-    __ cmpq(scratch, rbx);
-    __ jmp(kEq, &match);
+    // Cleanup
+    __ xorq(scratch, scratch);
+    __ xorq(r15, r15);
+    __ xorq(rdx, rdx);
 
-    // or nil
-    __ cmpq(scratch, Immediate(Heap::kTagNil));
-    __ jmp(kNe, &cleanup);
+    // Return value
+    GenerateEpilogue(0);
 
-    __ bind(&match);
+    __ bind(&dictionary);
 
-    Label fast_case_end(masm());
+    // Dictionary: compare control bytes of a group of slots with key's hash
+    // bits at once, key is absent if the group has an empty slot.
+    // Insertion is left to the runtime.
+    Label probe(masm()), next_match(masm()), group_end(masm());
+    Label found(masm()), missing(masm());
 
-    // Insert key if was asked
+    Operand qmap(rax, HObject::kMapOffset);
+    __ movq(r15, qmap);
+    Operand qsize(r15, HMap::kSizeOffset);
+
+    // xmm1 <- hash bits in every byte
+    __ movq(scratch, rdx);
+    __ shr(scratch, Immediate(25));
+    __ movq(rcx, scratch);
+    __ shl(rcx, Immediate(8));
+    __ orq(scratch, rcx);
+    __ movq(rcx, scratch);
+    __ shl(rcx, Immediate(16));
+    __ orq(scratch, rcx);
+    __ movqd(xmm1, scratch);
+    __ pshufd(xmm1, xmm1, Immediate(0));
+
+    // xmm2 <- empty marks
+    __ movq(scratch, Immediate(0x01010101U * HMap::kEmptySlot));
+    __ movqd(xmm2, scratch);
+    __ pshufd(xmm2, xmm2, Immediate(0));
+
+    // rax <- size - 1
+    // rdx <- index of the first slot in group
+    __ movq(rax, qsize);
+    __ dec(rax);
+    __ shr(rdx, Immediate(3));
+    __ andq(rdx, rax);
+
+    __ bind(&probe);
+
+    // Load group's control bytes (they're placed after keys, values and
+    // growth counter)
+    __ movq(scratch, qsize);
+    __ shl(scratch, Immediate(4));
+    __ addq(scratch, r15);
+    __ addq(scratch, rdx);
+    Operand group(scratch, HMap::kSpaceOffset + HValue::kPointerSize);
+    __ movdqu(xmm3, group);
+    __ movdqu(xmm4, group);
+
+    // rcx <- bit mask of matching control bytes
+    __ pcmpeqb(xmm3, xmm1);
+    __ pmovmskb(rcx, xmm3);
+
+    __ bind(&next_match);
     __ cmpq(rcx, Immediate(0));
-    __ jmp(kEq, &fast_case_end);
+    __ jmp(kEq, &group_end);
 
-    // Restore map's interior pointer
-    __ movq(scratch, qmap);
+    // scratch <- address of matching key slot
+    __ bsfq(scratch, rcx);
     __ addq(scratch, rdx);
+    __ andq(scratch, rax);
+    __ shl(scratch, Immediate(3));
+    __ addq(scratch, r15);
+
+    // Keys are internalized - compare addresses
+    Operand key_slot(scratch, HMap::kSpaceOffset);
+    __ cmpq(rbx, key_slot);
+    __ jmp(kEq, &found);
+
+    // Drop lowest bit and try next match
+    __ movq(scratch, rcx);
+    __ dec(scratch);
+    __ andq(rcx, scratch);
+    __ jmp(&next_match);
+
+    __ bind(&group_end);
+    __ pcmpeqb(xmm4, xmm2);
+    __ pmovmskb(rcx, xmm4);
+    __ cmpq(rcx, Immediate(0));
+    __ jmp(kNe, &missing);
 
-    // Put the key into slot
-    __ movq(slot, rbx);
+    // Move to the next group
+    __ addq(rdx, Immediate(HMap::kGroupSize));
+    __ andq(rdx, rax);
+    __ jmp(&probe);
 
-    __ bind(&fast_case_end);
+    __ bind(&found);
 
     // Compute value's address
-    // rax = key_offset + mask + 8
-    __ movq(rax, rdx);
-    __ addq(rax, r15);
-    __ addq(rax, Immediate(HValue::kPointerSize));
+    // rax = key_offset + size * 8
+    __ subq(scratch, r15);
+    __ movq(rax, qsize);
+    __ shl(rax, Immediate(3));
+    __ addq(rax, scratch);
+    __ addq(rax, Immediate(HMap::kSpaceOffset));
+
+    // Cleanup
+    change_s.Unspill();
+    __ xorq(scratch, scratch);
+    __ xorq(r15, r15);
+    __ xorq(rdx, rdx);
+
+    // Return value
+    GenerateEpilogue(0);
+
+    __ bind(&missing);
+
+    __ xorq(scratch, scratch);
+    change_s.Unspill();
+    object_s.Unspill();
+
+    // Key should be inserted by runtime
+    __ cmpq(rcx, Immediate(0));
+    __ jmp(kNe, &cleanup);
+
+    // get missing property == nil
+    __ movq(rax, Immediate(Heap::kTagNil));
 
     // Cleanup
     __ xorq(r15, r15);
@@ -584,7 +846,19 @@ void LookupPropertyStub::Generate() {
     __ IsNil(rbx, NULL, &slow_case);
     __ cmpq(rbx, Immediate(-1));
     __ jmp(kLe, &slow_case);
-    __ IsDenseArray(rax, &slow_case, NULL);
+
+    // Slots of integer elements may be read, but any value may be stored
+    // into the inserted one. Raw doubles have no slots.
+    Label tagged(masm());
+    Operand repr(rax, HValue::kRepresentationOffset);
+    __ cmpb(repr, Immediate(HArray::kDense));
+    __ jmp(kEq, &tagged);
+    __ cmpb(repr, Immediate(HArray::kSmiElements));
+    __ jmp(kNe, &slow_case);
+    __ cmpq(rcx, Immediate(0));
+    __ jmp(kEq, &tagged);
+    __ movb(repr, Immediate(HArray::kDense));
+    __ bind(&tagged);
 
     // Get mask
     Operand qmask(rax, HObject::kMaskOffset);
@@ -600,9 +874,12 @@ void LookupPropertyStub::Generate() {
     // Apply mask
     __ andq(r15, rdx);
 
-    // Check if length was increased
+    // Check if length was increased (only insertion changes it)
     Label length_set(masm());
 
+    __ cmpq(rcx, Immediate(0));
+    __ jmp(kEq, &length_set);
+
     Operand qlength(rax, HArray::kLengthOffset);
     __ movq(rdx, qlength);
     __ Untag(rbx);
@@ -665,6 +942,355 @@ void LookupPropertyStub::Generate() {
 }
 
 
+void LoadElementStub::Generate() {
+  GeneratePrologue();
+  __ AllocateSpills(0);
+
+  Label generic(masm()), runtime(masm()), doubles(masm());
+  Label missing(masm()), done(masm());
+
+  // rax <- object
+  // rbx <- property
+  __ IsUnboxed(rax, NULL, &missing);
+  __ IsNil(rax, NULL, &missing);
+  __ IsHeapObject(Heap::kTagArray, rax, &generic, NULL);
+
+  // Fast case: dense array and an unboxed key within its capacity
+  // (negative keys are above it, being unsigned)
+  Operand qmask(rax, HObject::kMaskOffset);
+  Operand qmap(rax, HObject::kMapOffset);
+  Operand repr(rax, HValue::kRepresentationOffset);
+  Operand element(rdx, HMap::kSpaceOffset);
+
+  __ IsUnboxed(rbx, &runtime, NULL);
+  __ movq(rdx, qmask);
+  __ shr(rdx, Immediate(2));
+  __ cmpq(rbx, rdx);
+  __ jmp(kAbove, &runtime);
+
+  __ cmpb(repr, Immediate(HArray::kSparse));
+  __ jmp(kEq, &runtime);
+
+  // rdx <- element's address
+  __ movq(rdx, rbx);
+  __ shl(rdx, Immediate(2));
+  __ addq(rdx, qmap);
+
+  __ cmpb(repr, Immediate(HArray::kDoubleElements));
+  __ jmp(kEq, &doubles);
+
+  __ movq(rax, element);
+  __ xorq(rdx, rdx);
+  __ jmp(&done);
+
+  // Raw double is boxed, holes are missing elements
+  __ bind(&doubles);
+  __ movq(rcx, element);
+  __ xorq(rdx, rdx);
+  __ movq(scratch, Immediate(HArray::kHoleNaN));
+  __ cmpq(rcx, scratch);
+  __ jmp(kEq, &missing);
+
+  __ movqd(xmm1, rcx);
+  __ xorq(rcx, rcx);
+  __ xorq(scratch, scratch);
+  __ ClearSpills();
+  __ AllocateNumber(xmm1, rax);
+  __ jmp(&done);
+
+  // Objects are using generic lookup
+  __ bind(&generic);
+  __ push(rax);
+  __ push(rax);
+  __ movq(rcx, Immediate(0));
+  __ Call(masm()->stubs()->GetLookupPropertyStub());
+  __ pop(rbx);
+  __ pop(rbx);
+
+  __ IsNil(rax, NULL, &done);
+
+  Operand qobjmap(rbx, HObject::kMapOffset);
+  Operand slot(rax, 0);
+  __ addq(rax, qobjmap);
+  __ movq(rax, slot);
+  __ xorq(rbx, rbx);
+  __ xorq(rcx, rcx);
+  __ jmp(&done);
+
+  // Other arrays and keys are handled by runtime
+  __ bind(&runtime);
+  __ xorq(rdx, rdx);
+  __ Pushad();
+
+  RuntimeLoadElementCallback load = &RuntimeLoadElement;
+
+  // RuntimeLoadElement(heap, obj, key)
+  __ movq(rdi, Immediate(reinterpret_cast<uint64_t>(masm()->heap())));
+  __ movq(rsi, rax);
+  __ movq(rdx, rbx);
+  __ movq(rax, Immediate(*reinterpret_cast<uint64_t*>(&load)));
+  __ callq(rax);
+
+  __ Popad(rax);
+  __ jmp(&done);
+
+  __ bind(&missing);
+  __ xorq(rcx, rcx);
+  __ xorq(scratch, scratch);
+  __ movq(rax, Immediate(Heap::kTagNil));
+
+  __ bind(&done);
+
+  __ FinalizeSpills();
+  GenerateEpilogue(0);
+}
+
+
+void StoreElementStub::Generate() {
+  GeneratePrologue();
+  __ AllocateSpills(0);
+
+  Label generic(masm()), runtime(masm()), smis(masm()), doubles(masm());
+  Label stored(masm()), store_double(masm()), done(masm());
+
+  // rax <- object
+  // rbx <- property
+  // rcx <- value
+  __ IsUnboxed(rax, NULL, &done);
+  __ IsNil(rax, NULL, &done);
+  __ IsHeapObject(Heap::kTagArray, rax, &generic, NULL);
+
+  // Fast case: dense array and an unboxed key within its capacity
+  // (negative keys are above it, being unsigned)
+  Operand qmask(rax, HObject::kMaskOffset);
+  Operand qmap(rax, HObject::kMapOffset);
+  Operand qlength(rax, HArray::kLengthOffset);
+  Operand repr(rax, HValue::kRepresentationOffset);
+  Operand element(rdx, HMap::kSpaceOffset);
+
+  __ IsUnboxed(rbx, &runtime, NULL);
+  __ movq(rdx, qmask);
+  __ shr(rdx, Immediate(2));
+  __ cmpq(rbx, rdx);
+  __ jmp(kAbove, &runtime);
+
+  __ cmpb(repr, Immediate(HArray::kSparse));
+  __ jmp(kEq, &runtime);
+
+  // rdx <- element's address
+  __ movq(rdx, rbx);
+  __ shl(rdx, Immediate(2));
+  __ addq(rdx, qmap);
+
+  __ cmpb(repr, Immediate(HArray::kSmiElements));
+  __ jmp(kEq, &smis);
+  __ cmpb(repr, Immediate(HArray::kDoubleElements));
+  __ jmp(kEq, &doubles);
+
+  // Any values are stored as into other slots
+  __ WriteBarrier(element);
+  __ movq(element, rcx);
+  __ RecordSlot(element, rcx);
+  __ jmp(&stored);
+
+  // Integers and nils are replacing integers, no barrier is needed
+  __ bind(&smis);
+  {
+    Label store_smi(masm());
+
+    __ IsNil(rcx, NULL, &store_smi);
+    __ IsUnboxed(rcx, &runtime, NULL);
+    __ bind(&store_smi);
+    __ movq(element, rcx);
+    __ jmp(&stored);
+  }
+
+  // Numbers are unboxed into doubles, nil is a hole
+  __ bind(&doubles);
+  {
+    Label not_unboxed(masm()), not_nil(masm()), not_flonum(masm());
+
+    __ IsUnboxed(rcx, &not_unboxed, NULL);
+    __ movq(scratch, rcx);
+    __ Untag(scratch);
+    __ cvtsi2sd(xmm1, scratch);
+    __ jmp(&store_double);
+
+    __ bind(&not_unboxed);
+    __ IsNil(rcx, &not_nil, NULL);
+    __ movq(scratch, Immediate(HArray::kHoleNaN));
+    __ movq(element, scratch);
+    __ jmp(&stored);
+
+    __ bind(&not_nil);
+    __ IsFlonum(rcx, &not_flonum, NULL);
+    __ movq(scratch, rcx);
+    __ DecodeFlonum(scratch, xmm1);
+    __ jmp(&store_double);
+
+    __ bind(&not_flonum);
+    __ IsHeapObject(Heap::kTagNumber, rcx, &runtime, NULL);
+    Operand qvalue(rcx, HNumber::kValueOffset);
+    __ movq(scratch, qvalue);
+    __ movq(element, scratch);
+    __ jmp(&stored);
+
+    __ bind(&store_double);
+    __ movqd(element, xmm1);
+  }
+
+  // Stores past the end are increasing length
+  __ bind(&stored);
+  __ xorq(scratch, scratch);
+  __ movq(rdx, rbx);
+  __ Untag(rdx);
+  __ inc(rdx);
+  __ cmpq(rdx, qlength);
+  __ jmp(kLe, &done);
+  __ movq(qlength, rdx);
+  __ jmp(&done);
+
+  // Objects are using generic lookup
+  __ bind(&generic);
+  __ push(rcx);
+  __ push(rax);
+  __ movq(rcx, Immediate(1));
+  __ Call(masm()->stubs()->GetLookupPropertyStub());
+  __ pop(rdx);
+  __ pop(rcx);
+
+  __ IsNil(rax, NULL, &done);
+
+  Operand qobjmap(rdx, HObject::kMapOffset);
+  Operand slot(rax, 0);
+  __ addq(rax, qobjmap);
+  __ WriteBarrier(slot);
+  __ movq(slot, rcx);
+  __ RecordSlot(slot, rcx);
+  __ jmp(&done);
+
+  // Growth, transitions and other keys are handled by runtime
+  __ bind(&runtime);
+  __ xorq(rdx, rdx);
+  __ xorq(scratch, scratch);
+  __ Pushad();
+
+  RuntimeStoreElementCallback store = &RuntimeStoreElement;
+
+  // RuntimeStoreElement(heap, obj, key, value)
+  __ movq(rdi, Immediate(reinterpret_cast<uint64_t>(masm()->heap())));
+  __ movq(rsi, rax);
+  __ movq(rdx, rbx);
+  // rcx already contains value
+  __ movq(rax, Immediate(*reinterpret_cast<uint64_t*>(&store)));
+  __ callq(rax);
+
+  __ Popad(rax);
+
+  __ bind(&done);
+
+  // Value is the result of assignment
+  __ movq(rax, rcx);
+  __ xorq(rdx, rdx);
+
+  __ FinalizeSpills();
+  GenerateEpilogue(0);
+}
+
+
+void PropertyICStub::Generate() {
+  GeneratePrologue();
+
+  Label generic(masm());
+
+  // rax <- object
+  // rbx <- property
+  // rcx <- change flag
+  // rdx <- inline cache
+  Operand qmisses(rdx, InlineCache::kMissesOffset);
+  Operand qstate(rdx, InlineCache::kStateOffset);
+  __ inc(qmisses);
+
+  // Megamorphic sites and objects without shape are using generic lookup
+  __ cmpq(qstate, Immediate(InlineCache::kMegamorphic));
+  __ jmp(kEq, &generic);
+
+  __ IsUnboxed(rax, NULL, &generic);
+  __ IsNil(rax, NULL, &generic);
+  __ IsHeapObject(Heap::kTagObject, rax, &generic, NULL);
+
+  Operand qshape(rax, HObject::kShapeOffset);
+  __ cmpq(qshape, Immediate(0));
+  __ jmp(kEq, &generic);
+
+  __ Pushad();
+
+  RuntimeLookupPropertyICCallback lookup = &RuntimeLookupPropertyIC;
+
+  // RuntimeLookupPropertyIC(heap, obj, key, change, ic)
+  __ movq(r8, rdx);
+  __ movq(rdi, Immediate(reinterpret_cast<uint64_t>(masm()->heap())));
+  __ movq(rsi, rax);
+  __ movq(rdx, rbx);
+  // rcx already contains change flag
+  __ movq(rax, Immediate(*reinterpret_cast<uint64_t*>(&lookup)));
+  __ callq(rax);
+
+  __ Popad(rax);
+
+  __ xorq(rdx, rdx);
+  GenerateEpilogue(0);
+
+  __ bind(&generic);
+
+  __ xorq(rdx, rdx);
+  __ Call(masm()->stubs()->GetLookupPropertyStub());
+
+  GenerateEpilogue(0);
+}
+
+
+void CallICStub::Generate() {
+  GeneratePrologue();
+
+  Label done(masm());
+
+  // rax <- function
+  // rbx <- inline cache
+  // rcx <- address of site's direct call target
+  Operand qmisses(rbx, InlineCache::kMissesOffset);
+  Operand qstate(rbx, InlineCache::kStateOffset);
+  __ inc(qmisses);
+
+  __ cmpq(qstate, Immediate(InlineCache::kMegamorphic));
+  __ jmp(kEq, &done);
+
+  // Bindings are called through the stub, don't remember them
+  Operand qparent(rax, HFunction::kParentOffset);
+  __ cmpq(qparent, Immediate(Heap::kBindingContextTag));
+  __ jmp(kEq, &done);
+
+  __ Pushad();
+
+  RuntimeUpdateCallICCallback update = &RuntimeUpdateCallIC;
+
+  // RuntimeUpdateCallIC(heap, fn, ic, target)
+  __ movq(rdi, Immediate(reinterpret_cast<uint64_t>(masm()->heap())));
+  __ movq(rsi, rax);
+  __ movq(rdx, rbx);
+  __ movq(rax, Immediate(*reinterpret_cast<uint64_t*>(&update)));
+  __ callq(rax);
+
+  __ Popad(reg_nil);
+
+  __ bind(&done);
+  __ xorq(rbx, rbx);
+  __ xorq(rcx, rcx);
+
+  GenerateEpilogue(0);
+}
+
+
 void CoerceToBooleanStub::Generate() {
   GeneratePrologue();
 
@@ -673,6 +1299,9 @@ void CoerceToBooleanStub::Generate() {
   // Check type and coerce if not boolean
   __ IsUnboxed(rax, NULL, &unboxed);
   __ IsNil(rax, NULL, &not_bool);
+
+  // Zero is never encoded as flonum
+  __ IsFlonum(rax, NULL, &truel);
   __ IsHeapObject(Heap::kTagBoolean, rax, &not_bool, NULL);
 
   __ jmp(&coerced_type);
@@ -718,14 +1347,23 @@ void CloneObjectStub::Generate() {
   GeneratePrologue();
 
   __ AllocateSpills(0);
+  __ ClearSpills();
 
-  Label non_object(masm()), done(masm());
+  Label non_object(masm()), dictionary(masm()), done(masm());
 
   // rax <- object
   __ IsUnboxed(rax, NULL, &non_object);
   __ IsNil(rax, NULL, &non_object);
   __ IsHeapObject(Heap::kTagObject, rax, &non_object, NULL);
 
+  // Get shape (it isn't a heap pointer)
+  Operand qshape(rax, HObject::kShapeOffset);
+  __ movq(rbx, qshape);
+
+  // Dictionary maps are cloned by runtime with their control bytes
+  __ cmpq(rbx, Immediate(0));
+  __ jmp(kEq, &dictionary);
+
   // Get map
   Operand qmap(rax, HObject::kMapOffset);
   __ movq(rax, qmap);
@@ -739,6 +1377,10 @@ void CloneObjectStub::Generate() {
   // Allocate new object
   __ AllocateObjectLiteral(Heap::kTagObject, rcx, rdx);
 
+  // Clone will have the same layout
+  qshape.base(rdx);
+  __ movq(qshape, rbx);
+
   __ movq(rbx, rdx);
 
   // Get new object's map
@@ -773,6 +1415,21 @@ void CloneObjectStub::Generate() {
 
   __ movq(rax, rdx);
 
+  __ jmp(&done);
+  __ bind(&dictionary);
+
+  __ Pushad();
+
+  RuntimeCloneObjectCallback clonec = &RuntimeCloneObject;
+
+  // RuntimeCloneObject(heap, obj)
+  __ movq(rdi, Immediate(reinterpret_cast<uint64_t>(masm()->heap())));
+  __ movq(rsi, rax);
+  __ movq(rax, Immediate(*reinterpret_cast<uint64_t*>(&clonec)));
+  __ callq(rax);
+
+  __ Popad(rax);
+
   __ jmp(&done);
   __ bind(&non_object);
 
@@ -981,60 +1638,109 @@ void BinOpStub::Generate() {
     }
 
     __ jmp(&done);
-  }
+  } else {
+    // Exact division of unboxed numbers results in unboxed number
+    Label divide(masm()), inexact(masm());
 
-  __ bind(&not_unboxed);
-
-  Label box_rhs(masm()), both_boxed(masm());
-  Label call_runtime(masm()), nil_result(masm());
-
-  __ IsNil(rax, NULL, &call_runtime);
-  __ IsNil(rbx, NULL, &call_runtime);
-
-  // Convert lhs to heap number if needed
-  __ IsUnboxed(rax, &box_rhs, NULL);
-
-  __ Untag(rax);
+    __ IsUnboxed(rax, &not_unboxed, NULL);
+    __ IsUnboxed(rbx, &not_unboxed, NULL);
 
-  __ xorqd(xmm1, xmm1);
-  __ cvtsi2sd(xmm1, rax);
-  __ xorq(rax, rax);
-  __ AllocateNumber(xmm1, rax);
+    // Division by zero is infinite, 0 / -b is -0 and quotient of
+    // min / -1 doesn't fit
+    __ cmpq(rbx, Immediate(0));
+    __ jmp(kEq, &not_unboxed);
+    __ jmp(kGt, &divide);
+    __ cmpq(rax, Immediate(0));
+    __ jmp(kEq, &not_unboxed);
+    __ cmpq(rbx, Immediate(HNumber::Tag(-1)));
+    __ jmp(kEq, &not_unboxed);
+
+    // Both are tagged: quotient is untagged and remainder is tagged
+    __ bind(&divide);
+    __ movq(rcx, rax);
+    __ movq(rdx, rax);
+    __ sar(rdx, Immediate(63));
+    __ idivq(rbx);
+    __ cmpq(rdx, Immediate(0));
+    __ jmp(kNe, &inexact);
 
-  __ bind(&box_rhs);
+    __ TagNumber(rax);
+    __ xorq(rcx, rcx);
+    __ jmp(&done);
 
-  // Convert rhs to heap number if needed
-  __ IsUnboxed(rbx, &both_boxed, NULL);
+    __ bind(&inexact);
+    __ movq(rax, rcx);
+    __ xorq(rcx, rcx);
+    __ xorq(rdx, rdx);
+  }
 
-  __ Untag(rbx);
+  __ bind(&not_unboxed);
 
-  __ xorqd(xmm1, xmm1);
-  __ cvtsi2sd(xmm1, rbx);
-  __ xorq(rbx, rbx);
+  // Unboxed fast case doesn't call anything, so slots are cleared only here
+  __ ClearSpills();
 
-  __ AllocateNumber(xmm1, rbx);
+  Label lhs_number(masm()), rhs_number(masm());
+  Label call_runtime(masm()), nil_result(masm());
 
-  // Both lhs and rhs are heap values (not-unboxed)
-  __ bind(&both_boxed);
+  __ IsNil(rax, NULL, &call_runtime);
+  __ IsNil(rbx, NULL, &call_runtime);
 
   if (BinOp::is_bool_logic(type())) {
     // Call runtime w/o any checks
     __ jmp(&call_runtime);
   }
 
-  __ IsNil(rax, NULL, &call_runtime);
-  __ IsNil(rbx, NULL, &call_runtime);
-
+  // Both lhs and rhs should be numbers (unboxed or heap ones)
+  __ IsUnboxed(rax, NULL, &lhs_number);
+  __ IsFlonum(rax, NULL, &lhs_number);
   __ IsHeapObject(Heap::kTagNumber, rax, &call_runtime, NULL);
+  __ bind(&lhs_number);
+
+  __ IsUnboxed(rbx, NULL, &rhs_number);
+  __ IsFlonum(rbx, NULL, &rhs_number);
   __ IsHeapObject(Heap::kTagNumber, rbx, &call_runtime, NULL);
+  __ bind(&rhs_number);
 
-  // We're adding two heap numbers
+  // Load values into xmm1 and xmm2, unboxed numbers and flonums are converted
+  // in place (without allocating heap numbers for them)
+  Label lhs_boxed(masm()), lhs_heap(masm()), lhs_loaded(masm());
+  Label rhs_boxed(masm()), rhs_heap(masm()), rhs_loaded(masm());
   Operand lvalue(rax, HNumber::kValueOffset);
   Operand rvalue(rbx, HNumber::kValueOffset);
+
+  __ IsUnboxed(rax, &lhs_boxed, NULL);
+  __ Untag(rax);
+  __ xorqd(xmm1, xmm1);
+  __ cvtsi2sd(xmm1, rax);
+  __ jmp(&lhs_loaded);
+
+  __ bind(&lhs_boxed);
+  __ IsFlonum(rax, &lhs_heap, NULL);
+  __ DecodeFlonum(rax, xmm1);
+  __ jmp(&lhs_loaded);
+
+  __ bind(&lhs_heap);
   __ movq(rax, lvalue);
-  __ movq(rbx, rvalue);
   __ movqd(xmm1, rax);
+  __ bind(&lhs_loaded);
+
+  __ IsUnboxed(rbx, &rhs_boxed, NULL);
+  __ Untag(rbx);
+  __ xorqd(xmm2, xmm2);
+  __ cvtsi2sd(xmm2, rbx);
+  __ jmp(&rhs_loaded);
+
+  __ bind(&rhs_boxed);
+  __ IsFlonum(rbx, &rhs_heap, NULL);
+  __ DecodeFlonum(rbx, xmm2);
+  __ jmp(&rhs_loaded);
+
+  __ bind(&rhs_heap);
+  __ movq(rbx, rvalue);
   __ movqd(xmm2, rbx);
+  __ bind(&rhs_loaded);
+
+  __ xorq(rax, rax);
   __ xorq(rbx, rbx);
 
   if (BinOp::is_math(type())) {
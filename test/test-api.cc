@@ -26,8 +26,11 @@ static Value* ObjectCallback(uint32_t argc, Value* argv[]) {
 static Value* ArrayCallback(uint32_t argc, Value* argv[]) {
   Array* arr = Array::New();
   arr->Set(3, Number::NewIntegral(4));
+  arr->Set(1, Number::NewDouble(1.5));
 
   assert(arr->Length() == 4);
+  assert(arr->Get(1)->As<Number>()->Value() == 1.5);
+  assert(arr->Get(2)->Is<Nil>());
 
   return arr;
 }
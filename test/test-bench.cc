@@ -0,0 +1,87 @@
+#include "test.h"
+#include <utils.h>
+
+#define __STDC_FORMAT_MACROS
+#include <inttypes.h> // printf formats for big integers
+
+TEST_START(bench)
+  // Number to string conversion: formatters vs snprintf
+  {
+    const int num = 2000000;
+    char str[32];
+    uint32_t total = 0;
+
+    BENCH_START(snprintf_int, num)
+    for (int64_t i = 0; i < num; i++) {
+      total += snprintf(str, sizeof(str), "%" PRIi64, i * 7919 - num);
+    }
+    BENCH_END(snprintf_int, num)
+
+    BENCH_START(int_to_string, num)
+    for (int64_t i = 0; i < num; i++) {
+      total -= IntToString(i * 7919 - num, str);
+    }
+    BENCH_END(int_to_string, num)
+    assert(total == 0);
+
+    BENCH_START(snprintf_double, num)
+    for (int64_t i = 0; i < num; i++) {
+      total += snprintf(str, sizeof(str), "%g", i / 64.0);
+    }
+    BENCH_END(snprintf_double, num)
+
+    BENCH_START(double_to_string, num)
+    for (int64_t i = 0; i < num; i++) {
+      total += DoubleToString(i / 64.0, str);
+    }
+    BENCH_END(double_to_string, num)
+  }
+
+  // String to number conversion: parser vs strtod
+  {
+    const int num = 2000000;
+    char str[32];
+    double total = 0;
+
+    BENCH_START(strtod, num)
+    for (int64_t i = 0; i < num; i++) {
+      snprintf(str, sizeof(str), "%" PRIi64 ".125", i);
+      total += strtod(str, NULL);
+    }
+    BENCH_END(strtod, num)
+
+    BENCH_START(string_to_double, num)
+    for (int64_t i = 0; i < num; i++) {
+      uint32_t len = snprintf(str, sizeof(str), "%" PRIi64 ".125", i);
+      total -= StringToDouble(str, len);
+    }
+    BENCH_END(string_to_double, num)
+    assert(total == 0);
+  }
+
+  // Runtime conversions in generated code (with number string cache)
+  FUN_TEST("s = 0\ni = 0\n"
+           "while (i < 1000000) {\n"
+           "  s = s + sizeof ('' + (i % 1000) + ((i % 1000) + 0.5))\n"
+           "  i++\n"
+           "}\n"
+           "return s", {
+    assert(result->ToNumber()->Value() > 0);
+  })
+
+  // Double arithmetic, compare with build using flonums (FLONUMS=true)
+  {
+    const int num = 10000000;
+
+    BENCH_START(double_loop, num)
+    FUN_TEST("s = 0.25\ni = 10000000.5\n"
+             "while (i > 1) {\n"
+             "  s = s + i * 0.5\n"
+             "  i = i - 1\n"
+             "}\n"
+             "return s", {
+      assert(result->ToNumber()->Value() > 0);
+    })
+    BENCH_END(double_loop, num)
+  }
+TEST_END(bench)
@@ -135,4 +135,26 @@ TEST_START(binary)
   FUN_TEST("return '5' & 3", {
     assert(result->As<Number>()->Value() == 1);
   })
+
+  // Unboxed operands
+
+  FUN_TEST("b = -25\nc = 3\nreturn (b * c) + (b << c) + (b >> c) + (b % c)", {
+    assert(result->As<Number>()->Value() == -278);
+  })
+
+  FUN_TEST("b = 9\nc = 4\nreturn (b % c) + ((b % 4) * 10) + ((c % b) * 100)", {
+    assert(result->As<Number>()->Value() == 411);
+  })
+
+  FUN_TEST("b = 9\nc = -3\nreturn b / c === -3", {
+    assert(result->As<Boolean>()->IsTrue());
+  })
+
+  FUN_TEST("b = 7\nc = 2\nreturn b / c", {
+    assert(result->As<Number>()->Value() == 3.5);
+  })
+
+  FUN_TEST("b = 4611686018427387903\nreturn b + 1", {
+    assert(result->As<Number>()->Value() == 4611686018427387904.0);
+  })
 TEST_END(binary)
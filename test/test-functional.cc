@@ -119,6 +119,17 @@ TEST_START(functional)
     assert(result->As<Number>()->Value() == 1);
   })
 
+  FUN_TEST("a(x) { return x + 1 }\n"
+           "mk(n) { return (x) { return x + n } }\n"
+           "call(f, x) { return f(x) }\n"
+           "r = call(a, 1)\n__$gc()\nr = r + call(a, 1)\n"
+           "i = 0\nwhile (i < 10) { r = r + call(mk(i), 0)\ni++ }\n"
+           "__$gc()\n"
+           "if (call(nil, 1) == nil) { r = r + call(a, 1) }\n"
+           "return r", {
+    assert(result->As<Number>()->Value() == 51);
+  })
+
   // Context slots
   FUN_TEST("b = 13589\na() { b }\nreturn b", {
     assert(result->As<Number>()->Value() == 13589);
@@ -223,6 +234,67 @@ TEST_START(functional)
     assert(result->As<Number>()->Value() == 5);
   });
 
+  // Shapes
+  FUN_TEST("a = { x: 1, y: 2 }\nb = { x: 3, y: 4 }\nb.z = 5\n"
+           "c = clone b\nk = keysof c\n"
+           "return k[0] + k[1] + k[2] + (a.x + a.y + c.x + c.y + c.z)", {
+    String* str = result->As<String>();
+    assert(str->Length() == 5);
+    assert(strncmp(str->Value(), "xyz15", str->Length()) == 0);
+  })
+
+  FUN_TEST("a = { x: 1, y: 2, z: 3 }\ndelete a.y\n"
+           "return a.x + a.z + sizeof keysof a", {
+    assert(result->As<Number>()->Value() == 6);
+  })
+
+  FUN_TEST("a = {}\ni = 0\nwhile (i < 100) { a['k' + i] = i\ni++ }\n"
+           "return a.k0 + a.k63 + a.k64 + a.k99 + sizeof keysof a", {
+    assert(result->As<Number>()->Value() == 326);
+  })
+
+  // Internalized keys
+  FUN_TEST("a = { key1: 1 }\nb = {}\ni = 0\n"
+           "while (i < 100) { b['key' + i] = i\ni++ }\n__$gc()\n"
+           "k = keysof b\n"
+           "return a['key' + 1] + b.key2 + (k[3] == 'key' + b[k[3]]) + "
+           "b['key' + 99] + (b['nokey'] == nil) + ('key' + 5 == 'key5')", {
+    assert(result->ToNumber()->Value() == 1 + 2 + 1 + 99 + 1 + 1);
+  })
+
+  // Dictionary mode objects
+  FUN_TEST("o = {}\ni = 0\nwhile (i < 500) { o['k' + i] = i\ni++ }\n"
+           "i = 0\nwhile (i < 500) { delete o['k' + i]\ni = i + 2 }\n"
+           "o.k4 = 4\nc = clone o\nc.k5 = 0\nc.z = 1\n__$gc()\n"
+           "return o.k1 + (o.k2 == nil) + o.k4 + o.k5 + c.k5 + c.z + "
+           "(o.z == nil) + c.k499 + sizeof keysof o + sizeof keysof c", {
+    assert(result->ToNumber()->Value() ==
+           1 + 1 + 4 + 5 + 0 + 1 + 1 + 499 + 251 + 252);
+  })
+
+  // Inline caches
+  FUN_TEST("get(o) { return o.x }\n"
+           "a = { x: 1 }\nb = { y: 0, x: 2 }\nc = { z: 0, x: 3 }\n"
+           "d = { w: 0, x: 4 }\ne = { v: 0, x: 5 }\n"
+           "return get(a) + get(b) + get(c) + get(d) + get(e) + "
+           "get(a) + get(e) + get({}) + get([])", {
+    assert(result->ToNumber()->Value() == 21);
+  })
+
+  FUN_TEST("set(o, v) { o.x = v }\n"
+           "a = { y: 1 }\nset(a, 2)\nb = { y: 3 }\nset(b, 4)\nset(a, 5)\n"
+           "return a.x + a.y + b.x + b.y", {
+    assert(result->As<Number>()->Value() == 13);
+  })
+
+  // Type feedback
+  FUN_TEST("add(x, y) { return x + y }\n"
+           "o = { x: 1 }\nk = 'x'\na = [ 3 ]\ni = 0\ng = nil\n"
+           "return add(1, 2) + add(1.5, 1) + add(nil, 1) + "
+           "(sizeof add('a', 'b')) + o[k] + a[i] + g()", {
+    assert(result->ToNumber()->Value() == 3 + 2.5 + 1 + 2 + 1 + 3);
+  })
+
   // Arrays
   FUN_TEST("a = [ 1, 2, 3, 4 ]\nreturn a[0] + a[1] + a[2] + a[3]", {
     assert(result->As<Number>()->Value() == 10);
@@ -232,6 +304,30 @@ TEST_START(functional)
     assert(result->As<Number>()->Value() == 4);
   })
 
+  FUN_TEST("a = []\ni = 0\nwhile (i < 1000) { a[i] = i\ni++ }\n"
+           "a[1500] = 1\nb = [ 1, 2 ]\nb[5] = 3\nb[1000000] = 4\n"
+           "k = keysof a\n"
+           "return a[999] + a[1200] + a[1500] + sizeof a + k[1000] + "
+           "sizeof keysof b + b[5] + b[1000000] + sizeof b", {
+    assert(result->ToNumber()->Value() == 999 + 1 + 1501 + 1500 + 4 + 3 +
+                                          4 + 1000001);
+  })
+
+  // Integer elements become raw doubles, and anything else when other
+  // values are stored
+  FUN_TEST("a = [ 1, 2, 3 ]\na[3] = 4.5\na[5] = 0.25\nk = keysof a\n"
+           "return a[0] + a[3] + a[5] + (a[4] == nil) + sizeof a + "
+           "sizeof k", {
+    assert(result->ToNumber()->Value() == 17.75);
+  })
+
+  FUN_TEST("a = []\ni = 0\nwhile (i < 100) { a[i] = i + 0.5\ni++ }\n"
+           "__$gc()\nf = (x, y) { return x + y }\nb = [ 1.5, 2.25 ]\n"
+           "s = f(b...)\na[1] = { x: 2 }\na[2] = 'x'\n__$gc()\n"
+           "return s + a[0] + a[1].x + a[99] + (a[2] == 'x')", {
+    assert(result->ToNumber()->Value() == 106.75);
+  })
+
   FUN_TEST("a = [ 1, 2, 3, 4 ]\nreturn typeof a", {
     String* str = result->As<String>();
     assert(str->Length() == 5);
@@ -272,10 +368,36 @@ TEST_START(functional)
     assert(result->As<Number>()->Value() == 2);
   })
 
+  FUN_TEST("a = 1\nb = 2\nr = 0\n"
+           "if (a < b) r = r + 1\nif (a > b) r = r + 10\n"
+           "if (a <= 1) r = r + 100\nif (b >= 3) r = r + 1000\n"
+           "if (a == 1) r = r + 10000\nif (a != b) r = r + 100000\n"
+           "if (-1 < a) r = r + 1000000\nif (1.5 < b) r = r + 10000000\n"
+           "if ('1' == a) r = r + 100000000\nif (nil < b) r = r + 1\n"
+           "return r", {
+    assert(result->As<Number>()->Value() == 111110101);
+  })
+
   // While
   FUN_TEST("i = 10\nj = 0\n"
            "while (i--) { j = j + 1\n}\n"
            "return j", {
     assert(result->As<Number>()->Value() == 10);
   })
+
+  FUN_TEST("i = 0\nj = 0\n"
+           "while (i < 10) { j = j + i\ni = i + 1\n}\n"
+           "while (j != 45.5) { j = j + 0.5\n}\n"
+           "return j", {
+    assert(result->As<Number>()->Value() == 45.5);
+  })
+
+  // Hot loop of script is replaced on stack, calls from it shouldn't
+  // break script's frame
+  FUN_TEST("g = (x, y, z) { return x + y + z }\n"
+           "i = 0\ns = 0\n"
+           "while (i < 5000) {\n  s = s + g(i, 1, 2)\n  i++\n}\n"
+           "return s", {
+    assert(result->As<Number>()->Value() == 12512500);
+  })
 TEST_END(functional)
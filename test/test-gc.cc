@@ -48,4 +48,179 @@ TEST_START(gc)
            "return a.x.y", {
     assert(result->Is<Object>());
   })
+
+  // Incremental marking: value detached from old object while marking
+  FUN_TEST("holder = { v: { deep: { z: 7 } } }\n"
+           "a = nil\ny = 120\n"
+           "while (--y) {\n"
+           "  x = 3000\n"
+           "  while (--x) {\n"
+           "    t = holder.v\n"
+           "    holder.v = nil\n"
+           "    a = { x: { y: a } }\n"
+           "    holder.v = t\n"
+           "  }\n"
+           "}\n"
+           "return holder.v.deep.z", {
+    assert(result->As<Number>()->Value() == 7);
+  })
+
+  // Old space holes: every other tenured object dies
+  FUN_TEST("keep = []\ny = 40\n"
+           "while (--y) {\n"
+           "  x = 2000\n"
+           "  while (--x) { keep[x] = { v: x } }\n"
+           "  x = 2000\n"
+           "  while (--x) { if (x % 2 == 0) keep[x] = nil }\n"
+           "}\n"
+           "s = 0\nx = 2000\n"
+           "while (--x) { if (keep[x] != nil) s = s + keep[x].v }\n"
+           "return s", {
+    assert(result->As<Number>()->Value() == 1000000);
+  })
+
+  // Remembered set: new space values stored into tenured objects
+  FUN_TEST("old = { a: nil, b: [] }\n"
+           "__$gc()\n__$gc()\n__$gc()\n"
+           "__$gc()\n__$gc()\n__$gc()\n"
+           "old.a = { v: 3 }\n"
+           "old.b[0] = { v: 4 }\n"
+           "k = \"k\" + 1\n"
+           "old[k] = { v: 5 }\n"
+           "__$gc()\n__$gc()\n__$gc()\n"
+           "return old.a.v + old.b[0].v + old.k1.v", {
+    assert(result->As<Number>()->Value() == 12);
+  })
+
+  // Parallel marking: wide tenured graph is marked by several threads
+  {
+    Isolate i;
+    i.SetGCThreads(4);
+    const char* code = "a = []\nx = 300\n"
+                       "while (--x) {\n"
+                       "  row = []\n"
+                       "  y = 100\n"
+                       "  while (--y) { row[y] = { v: 1 } }\n"
+                       "  a[x] = row\n"
+                       "}\n"
+                       "y = 10\n"
+                       "while (--y) {\n"
+                       "  b = 0\n"
+                       "  x = 100000\n"
+                       "  while (--x) { b = { x: { y: b } } }\n"
+                       "}\n"
+                       "s = 0\nx = 300\n"
+                       "while (--x) {\n"
+                       "  y = 100\n"
+                       "  while (--y) { s = s + a[x][y].v }\n"
+                       "}\n"
+                       "return s";
+
+    Function* f = Function::New("gc", code, strlen(code));
+    Value* argv[0];
+    Value* result = f->Call(0, argv);
+    assert(result->As<Number>()->Value() == 29601);
+  }
+
+  // Huge pages and small page pool
+  {
+    Isolate i;
+    i.SetHugePages(true);
+    i.SetMaxRetainedPages(1);
+    const char* code = "y = 4\n"
+                       "while (--y) {\n"
+                       "  a = 0\n"
+                       "  x = 200000\n"
+                       "  while (--x) { a = { x: a, v: x } }\n"
+                       "}\n"
+                       "return a.v + a.x.v";
+
+    Function* f = Function::New("gc", code, strlen(code));
+    Value* argv[0];
+    Value* result = f->Call(0, argv);
+    assert(result->As<Number>()->Value() == 3);
+  }
+
+  // Large space: big map references new space values
+  FUN_TEST("a = []\nx = 20000\n"
+           "while (--x) { a[x] = { v: 1 } }\n"
+           "y = 5\n"
+           "while (--y) {\n"
+           "  x = 20000\n"
+           "  while (--x) { a[x] = { v: a[x].v + 1 } }\n"
+           "  b = 0\n"
+           "  x = 100000\n"
+           "  while (--x) { b = { x: b } }\n"
+           "}\n"
+           "s = 0\nx = 20000\n"
+           "while (--x) { s = s + a[x].v }\n"
+           "return s", {
+    assert(result->As<Number>()->Value() == 99995);
+  })
+
+  // Heap options: small adaptive new space, early tenuring, limited heap
+  {
+    HeapOptions options;
+    options.new_space_size = 512 * 1024;
+    options.max_new_space_size = 4 * 1024 * 1024;
+    options.tenure_age = 1;
+    options.old_space_growth = 150;
+    options.max_heap_size = 256 * 1024 * 1024;
+    Isolate i(&options);
+    const char* code = "keep = []\ny = 20\n"
+                       "while (--y) {\n"
+                       "  a = 0\n"
+                       "  x = 50000\n"
+                       "  while (--x) { a = { x: a, v: x } }\n"
+                       "  keep[y] = a\n"
+                       "}\n"
+                       "return keep[1].v + keep[19].x.v";
+
+    Function* f = Function::New("gc", code, strlen(code));
+    Value* argv[0];
+    Value* result = f->Call(0, argv);
+    assert(result->As<Number>()->Value() == 3);
+  }
+
+  // Pretenuring: surviving literals are allocated in old space and
+  // reference new space numbers
+  FUN_TEST("a = nil\nx = 30000\n"
+           "while (--x) { a = { next: a, v: x + 0.5 } }\n"
+           "y = 10\n"
+           "while (--y) {\n"
+           "  b = 0\n"
+           "  x = 100000\n"
+           "  while (--x) { b = { x: b } }\n"
+           "}\n"
+           "s = 0\n"
+           "while (a) {\n"
+           "  s = s + a.v\n"
+           "  a = a.next\n"
+           "}\n"
+           "return s", {
+    assert(result->As<Number>()->Value() == 449999999.5);
+  })
+
+  // Comparisons and coercions are returning canonical values, loop below
+  // shouldn't allocate anything (besides the frame of the call)
+  {
+    Isolate i;
+    const char* code = "a = 1.5\nb = 2.5\ns = 'abc'\nt = 'abd'\nn = 0\n"
+                       "x = 100000\n"
+                       "while (--x) {\n"
+                       "  if (a < b && s < t && s != t && !(a == b)) n++\n"
+                       "  if (s && !nil && (nil == nil) && x) n++\n"
+                       "  if (typeof (s === t) == 'boolean') n++\n"
+                       "}\n"
+                       "return n";
+
+    Function* f = Function::New("gc", code, strlen(code));
+    Heap* heap = Heap::Current();
+    uint32_t used = heap->new_space()->Used();
+
+    Value* argv[0];
+    Value* result = f->Call(0, argv);
+    assert(result->As<Number>()->Value() == 3 * 99999);
+    assert(heap->new_space()->Used() - used < 1024);
+  }
 TEST_END(gc)
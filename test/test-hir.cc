@@ -0,0 +1,203 @@
+#include "test.h"
+#include <parser.h>
+#include <scope.h>
+#include <ast.h>
+#include <hir.h>
+
+TEST_START(hir)
+  // Constants are folded
+  HIR_TEST("a = 1\nb = 2\nreturn a + b", "[B0: i0 = Integer[3]; Return(i0)]")
+  HIR_TEST("a = 1\nb = a + 2\nreturn b * 3",
+           "[B0: i0 = Integer[9]; Return(i0)]")
+  HIR_TEST("return !true", "[B0: i0 = False; Return(i0)]")
+  HIR_TEST("a = 1\nreturn a == 1", "[B0: i0 = True; Return(i0)]")
+
+  // Integers that may not fit into unboxed value are left for runtime
+  HIR_TEST("a = 4611686018427387903 + 1\nreturn a",
+           "[B0: i0 = Integer[4611686018427387903]; i1 = Integer[1]; "
+           "i2 = BinOp[kAdd](i0, i1); Return(i2)]")
+
+  // Same values are computed once, unused ones are removed
+  HIR_TEST("a = x + y\nb = x + y\nreturn a * b",
+           "[B0: i0 = Nil; i1 = BinOp[kAdd](i0, i0); "
+           "i2 = BinOp[kMul](i1, i1); Return(i2)]")
+  HIR_TEST("a = x + 1\nb = 2 * 3\nreturn x", "[B0: i0 = Nil; Return(i0)]")
+  HIR_TEST("i = 0\nreturn i++", "[B0: i0 = Integer[0]; Return(i0)]")
+
+  // Control flow
+  HIR_TEST("if (x) { a = 1 } else { a = 2 }\nreturn a",
+           "[B0: i0 = Nil; Branch(i0, B1, B2)] "
+           "[B1: i2 = Integer[1]; Goto(B3)] "
+           "[B2: i4 = Integer[2]; Goto(B3)] "
+           "[B3: i6 = Phi(i2, i4); Return(i6)]")
+  HIR_TEST("a = 1\nwhile (a < 10) { a++ }\nreturn a",
+           "[B0: i0 = Integer[1]; Goto(B1)] "
+           "[B1: i2 = Phi(i0, i6); i3 = Integer[10]; "
+           "i4 = BinOp[kLt](i2, i3); Branch(i4, B2, B3)] "
+           "[B2: i6 = BinOp[kAdd](i2, i0); Goto(B1)] "
+           "[B3: Goto(B4)] [B4: Return(i2)]")
+  HIR_TEST("a = 0\ni = 0\n"
+           "while (i < 10) {\n"
+           "  i++\n"
+           "  if (i % 2) continue\n"
+           "  a = a + i\n"
+           "  if (a > 10) break\n"
+           "}\n"
+           "return a",
+           "[B0: i0 = Integer[0]; Goto(B1)] "
+           "[B1: i2 = Phi(i0, i2, i14); i3 = Phi(i0, i8, i8); "
+           "i4 = Integer[10]; i5 = BinOp[kLt](i3, i4); Branch(i5, B2, B9)] "
+           "[B2: i7 = Integer[1]; i8 = BinOp[kAdd](i3, i7); "
+           "i9 = Integer[2]; i10 = BinOp[kMod](i8, i9); "
+           "Branch(i10, B3, B4)] "
+           "[B3: Goto(B1)] [B4: Goto(B5)] "
+           "[B5: i14 = BinOp[kAdd](i2, i8); i15 = BinOp[kGt](i14, i4); "
+           "Branch(i15, B6, B7)] "
+           "[B6: Goto(B10)] [B7: Goto(B8)] [B8: Goto(B1)] [B9: Goto(B10)] "
+           "[B10: i21 = Phi(i14, i2); Return(i21)]")
+
+  // Objects and calls
+  HIR_TEST("o = { a: 1 }\no.b = o.a\nreturn [o]",
+           "[B0: i0 = NewObject[1]; i1 = Integer[1]; i2 = String['a']; "
+           "StoreProperty(i0, i2, i1); i4 = LoadProperty(i0, i2); "
+           "i5 = String['b']; StoreProperty(i0, i5, i4); "
+           "i7 = NewArray[2]; i8 = Integer[0]; StoreProperty(i7, i8, i0); "
+           "Return(i7)]")
+  HIR_TEST("return global.print(1)",
+           "[B0: i0 = LoadContext[-1:0]; i1 = String['print']; "
+           "i2 = LoadProperty(i0, i1); i3 = Integer[1]; "
+           "i4 = Call(i2, i3); Return(i4)]")
+
+  // Loops are compiled on their own (on-stack replacement), changed
+  // variables are stored back
+  HIR_LOOP_TEST("a = 1\nb = 2\nwhile (a < 10) { a++ }\nreturn a",
+                "[B0: i0 = LoadStack[0]; Goto(B1)] "
+                "[B1: i2 = Phi(i0, i7); i3 = Integer[10]; "
+                "i4 = BinOp[kLt](i2, i3); Branch(i4, B2, B3)] "
+                "[B2: i6 = Integer[1]; i7 = BinOp[kAdd](i2, i6); Goto(B1)] "
+                "[B3: Goto(B4)] [B4: StoreStack[0](i2); Exit]")
+  HIR_LOOP_TEST("a = 1\nf = () { return a }\n"
+                "while (a < 10) { a = a + 1 }",
+                "[B0: Goto(B1)] [B1: i1 = LoadContext[0:0]; "
+                "i2 = Integer[10]; i3 = BinOp[kLt](i1, i2); "
+                "Branch(i3, B2, B3)] "
+                "[B2: i5 = LoadContext[0:0]; i6 = Integer[1]; "
+                "i7 = BinOp[kAdd](i5, i6); StoreContext[0:0](i7); Goto(B1)] "
+                "[B3: Goto(B4)] [B4: Exit]")
+
+  // Functions with closures are left for fullgen
+  HIR_BAILOUT_TEST("a = () {}")
+  HIR_BAILOUT_TEST("a = 1\nreturn () { return a }")
+
+  // Optimized code
+  OPT_TEST("sum = (n) {\n"
+           "  s = 0\n"
+           "  i = 0\n"
+           "  while (i < n) {\n"
+           "    s = s + i * 2\n"
+           "    i++\n"
+           "  }\n"
+           "  return s\n"
+           "}\n"
+           "sum(10)\n"
+           "return sum(100)", {
+    assert(result->As<Number>()->Value() == 9900);
+  })
+
+  OPT_TEST("fib = (n) {\n"
+           "  if (n < 2) return n\n"
+           "  return fib(n - 1) + fib(n - 2)\n"
+           "}\n"
+           "return fib(20)", {
+    assert(result->As<Number>()->Value() == 6765);
+  })
+
+  // Slow cases are handled by stubs
+  OPT_TEST("add = (a, b) {\n"
+           "  return a + b\n"
+           "}\n"
+           "add(1, 2)\n"
+           "return [add(1.5, 2), add('a', 'b'), add(4611686018427387903, 1),"
+           " add(nil)]", {
+    Array* arr = result->As<Array>();
+    assert(arr->Get(0)->As<Number>()->Value() == 3.5);
+    String* str = arr->Get(1)->As<String>();
+    assert(str->Length() == 2);
+    assert(strncmp(str->Value(), "ab", str->Length()) == 0);
+    assert(arr->Get(2)->As<Number>()->Value() == 4611686018427387904.0);
+    assert(arr->Get(3)->As<Number>()->Value() == 0);
+  })
+
+  // Values are living across calls and allocations
+  OPT_TEST("make = (n) {\n"
+           "  a = 1\n"
+           "  b = 2\n"
+           "  c = 3\n"
+           "  d = 4\n"
+           "  e = 5\n"
+           "  f = 6\n"
+           "  g = 7\n"
+           "  h = 8\n"
+           "  k = 9\n"
+           "  list = nil\n"
+           "  i = 0\n"
+           "  while (i < n) {\n"
+           "    list = { v: i, next: list, s: 'x' + i }\n"
+           "    i++\n"
+           "  }\n"
+           "  return [list, a + b + c + d + e + f + g + h + k]\n"
+           "}\n"
+           "make(1)\n"
+           "r = make(100000)\n"
+           "s = 0\n"
+           "l = r[0]\n"
+           "while (l) {\n"
+           "  s = s + l.v\n"
+           "  l = l.next\n"
+           "}\n"
+           "return s + r[1]", {
+    assert(result->As<Number>()->Value() == 4999950000.0 + 45);
+  })
+
+  // Loops of script and of functions with closures are switching to
+  // optimized code in the middle
+  OPT_TEST("a = 0\n"
+           "i = 0\n"
+           "while (i < 1000) {\n"
+           "  a = a + i\n"
+           "  i++\n"
+           "}\n"
+           "return a + i", {
+    assert(result->As<Number>()->Value() == 499500 + 1000);
+  })
+
+  OPT_TEST("c = 0\n"
+           "get = () { return c }\n"
+           "x = 0\n"
+           "while (x < 10) {\n"
+           "  y = 0\n"
+           "  while (true) {\n"
+           "    if (++y > x) break\n"
+           "    c = c + y\n"
+           "  }\n"
+           "  x++\n"
+           "}\n"
+           "return get()", {
+    assert(result->As<Number>()->Value() == 165);
+  })
+
+  OPT_TEST("find = (n) {\n"
+           "  k = 0\n"
+           "  inc = () { k = k + 1 }\n"
+           "  while (true) {\n"
+           "    if (k * k >= n) return [k, 'found']\n"
+           "    inc()\n"
+           "  }\n"
+           "}\n"
+           "return find(1000)", {
+    Array* arr = result->As<Array>();
+    assert(arr->Get(0)->As<Number>()->Value() == 32);
+    String* str = arr->Get(1)->As<String>();
+    assert(strncmp(str->Value(), "found", str->Length()) == 0);
+  })
+TEST_END(hir)
@@ -3,9 +3,11 @@
 
 #define TESTS_ENUM(V)\
     V(api)\
+    V(bench)\
     V(binary)\
     V(functional)\
     V(gc)\
+    V(hir)\
     V(numbers)\
     V(parser)\
     V(scope)
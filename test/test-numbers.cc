@@ -94,6 +94,47 @@ TEST_START(numbers)
     assert(result->As<Number>()->Value() == 5.5);
   })
 
+  FUN_TEST("a = [ 1, 2, 3, 4 ]\ni = 0\nr = 0\n"
+           "while (i < 4) { r = r + a[i] * 0.5 / 2\ni++ }\n"
+           "return r + 9 / 3 + (7 > 6.5) + ('1' + 2 == '12')", {
+    assert(result->ToNumber()->Value() == 2.5 + 3 + 2);
+  })
+
+  // Doubles in and out of flonum range (when built with flonums)
+  FUN_TEST("a = 1.5\nb = 1.5\ni = 0\n"
+           "while (i < 30) { a = a * 1024\nb = b / 1024\ni++ }\n"
+           "c = a\nd = b\n"
+           "while (i > 0) { c = c / 1024\nd = d * 1024\ni-- }\n"
+           "return (a > 1000000000000000000000000000000.0) + (b < 0.001) + "
+           "(b > 0.0) + (c === 1.5) + (d == 1.5) + (0.5 - 0.5 == 0) + "
+           "(0.0 - 2.5 < 0 - 2) + (typeof 2.5 == 'number') + (1 < 1.5)", {
+    assert(result->ToNumber()->Value() == 9);
+  })
+
+  // Conversion to and from string
+  FUN_TEST("return '' + (0.1 + 0.2) + ' ' + 1.5 + ' ' + (0 - 42) + ' ' + "
+           "(1.0 * 1000000) + ' ' + (1 / 3)", {
+    String* str = result->As<String>();
+    const char* expected = "0.30000000000000004 1.5 -42 1000000 "
+                           "0.3333333333333333";
+    assert(str->Length() == strlen(expected));
+    assert(strncmp(str->Value(), expected, str->Length()) == 0);
+  })
+
+  FUN_TEST("return '' + (0 / (0 - 3)) + ' ' + (0.0 * (0 - 1.5)) + ' ' + "
+           "(0.0 - 0.0)", {
+    String* str = result->As<String>();
+    const char* expected = "-0 -0 0";
+    assert(str->Length() == strlen(expected));
+    assert(strncmp(str->Value(), expected, str->Length()) == 0);
+  })
+
+  FUN_TEST("return ('0.1' * 3 == 0.1 * 3) + ('-2.5' * 2 == 0 - 5) + "
+           "('12345678901234567890' * 1 == 12345678901234567890.0) + "
+           "('007' * 1 == 7)", {
+    assert(result->ToNumber()->Value() == 4);
+  })
+
   // Conversion on overflow
   FUN_TEST("return 2305843009213693952 * 1000000", {
     assert(result->As<Number>()->Value() == 2305843009213693952000000.0);
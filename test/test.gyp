@@ -32,9 +32,11 @@
       'test.h',
       'test.cc',
       'test-api.cc',
+      'test-bench.cc',
       'test-binary.cc',
       'test-functional.cc',
       'test-gc.cc',
+      'test-hir.cc',
       'test-numbers.cc',
       'test-parser.cc',
       'test-scope.cc'
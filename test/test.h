@@ -56,6 +56,48 @@ using namespace internal;
       ast = NULL;\
     }
 
+#define HIR_TEST(code, expected)\
+    {\
+      Zone z;\
+      char out[1024];\
+      Parser p(code, strlen(code));\
+      AstNode* ast = p.Execute();\
+      assert(!p.has_error());\
+      Scope::Analyze(ast);\
+      HIRGen g(FunctionLiteral::Cast(ast), NULL);\
+      assert(g.Build());\
+      g.Print(out, 1000);\
+      assert(strcmp(expected, out) == 0);\
+    }
+
+// Same as HIR_TEST, but only the first top-level loop is compiled (OSR)
+#define HIR_LOOP_TEST(code, expected)\
+    {\
+      Zone z;\
+      char out[1024];\
+      Parser p(code, strlen(code));\
+      AstNode* ast = p.Execute();\
+      assert(!p.has_error());\
+      Scope::Analyze(ast);\
+      AstList::Item* loop = ast->children()->head();\
+      while (!loop->value()->is(AstNode::kWhile)) loop = loop->next();\
+      HIRGen g(FunctionLiteral::Cast(ast), loop->value());\
+      assert(g.Build());\
+      g.Print(out, 1000);\
+      assert(strcmp(expected, out) == 0);\
+    }
+
+#define HIR_BAILOUT_TEST(code)\
+    {\
+      Zone z;\
+      Parser p(code, strlen(code));\
+      AstNode* ast = p.Execute();\
+      assert(!p.has_error());\
+      Scope::Analyze(ast);\
+      HIRGen g(FunctionLiteral::Cast(ast), NULL);\
+      assert(!g.Build());\
+    }
+
 #define FUN_TEST(code, block)\
     {\
       Isolate i;\
@@ -69,6 +111,21 @@ using namespace internal;
       block\
     }
 
+// Same as FUN_TEST, but functions are recompiled after their first call
+#define OPT_TEST(code, block)\
+    {\
+      Isolate i;\
+      i.SetOptimizationThreshold(1);\
+      Function* f = Function::New("test", code, strlen(code));\
+      if (i.HasError()) {\
+        i.PrintError();\
+        abort();\
+      }\
+      Value* argv[0];\
+      Value* result = f->Call(0, argv);\
+      block\
+    }
+
 #define BENCH_START(name, num)\
     timeval __bench_##name##_start;\
     gettimeofday(&__bench_##name##_start, NULL);